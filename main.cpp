@@ -8,6 +8,7 @@ PURPOSE: Example echo server using event loop callbacks.
 Demonstrates:
 - Non-blocking accept() with accept_callback
 - Non-blocking read() with read_callback
+- close() on end of stream (graceful FIN in the background)
 - Single-threaded event loop (0% CPU when idle)
 )";
 }
@@ -41,6 +42,13 @@ int main(int argc, char* argv[]) {
                         if (ret < 0) {
                                 if (errno == EAGAIN) return;  // No data ready yet
                                 std::cout << "Read failed: " << errno << std::endl;
+                                uStack::close(cfd);
+                                return;
+                        }
+                        if (size == 0) {
+                                // Peer closed: send our FIN and free the fd
+                                std::cout << "Connection closed: " << cfd << std::endl;
+                                uStack::close(cfd);
                                 return;
                         }
 
@@ -11,6 +11,8 @@
 #include "tcb_manager.hpp"
 #include "tcp.hpp"
 #include "tuntap.hpp"
+#include "packet_ring.hpp"
+#include "af_xdp.hpp"
 #include "event_loop.hpp"
 
 namespace uStack {
@@ -18,7 +20,8 @@ namespace uStack {
 namespace docs {
 static const char* api_doc = R"(
 FILE: api.hpp
-PURPOSE: Public API. Functions: init_logger(), init_stack(), socket(), listen(), accept(), read(), write().
+PURPOSE: Public API. Functions: init_logger(), init_stack(), socket(), listen(), accept(), connect(), socket_error(), read(), readv(), read_zerocopy(), release_zerocopy(), write(), writev(), write_zerocopy(), sendfile(), shutdown(), close(), set_keepalive(), set_user_timeout(), set_send_buffer(),
+         epoll_create(), epoll_ctl(), epoll_wait().
 )";
 }
 
@@ -34,26 +37,39 @@ int init_logger(int argc, char* argv[]) {
         return 0;
 }
 
-void init_stack(int argc, char* argv[]) {
-        init_logger(argc, argv);
-
-        LOG_INIT("Starting userspace TCP/IP stack initialization");
-
-        // Initialize TUN/TAP device
-        auto& tuntap_dev = tuntap<1500>::instance();
-        tuntap_dev.set_ipv4_addr(std::string("192.168.1.1"));
-        LOG_INIT("Device initialized: tap0 (IP: 192.168.1.1)");
+// The TAP device, an AF_XDP socket on XDP_IFACE or an AF_PACKET ring on PACKET_IFACE
+template <typename DEV>
+void init_device(DEV& dev) {
+        dev.set_ipv4_addr(std::string("192.168.1.1"));
 
         // Layer 2: Ethernet
         auto& ethernetv2 = ethernetv2::instance();
-        tuntap_dev.register_upper_protocol(ethernetv2);
+        dev.register_upper_protocol(ethernetv2);
         LOG_INIT("Layer 2 (Ethernet) registered");
 
         // Layer 3: ARP
         auto& arpv4 = arp::instance();
         ethernetv2.register_upper_protocol(arpv4);
-        arpv4.register_dev(tuntap_dev);
+        arpv4.register_dev(dev);
         LOG_INIT("Layer 3 (ARP) registered");
+}
+
+void init_stack(int argc, char* argv[]) {
+        init_logger(argc, argv);
+
+        LOG_INIT("Starting userspace TCP/IP stack initialization");
+
+        if (const char* iface = af_xdp<1500>::configured_iface()) {
+                init_device(af_xdp<1500>::instance());
+                LOG_INIT("Device initialized: " << iface << " (AF_XDP, IP: 192.168.1.1)");
+        } else if (const char* iface = packet_ring<1500>::configured_iface()) {
+                init_device(packet_ring<1500>::instance());
+                LOG_INIT("Device initialized: " << iface << " (AF_PACKET ring, IP: 192.168.1.1)");
+        } else {
+                init_device(tuntap<1500>::instance());
+                LOG_INIT("Device initialized: tap0 (IP: 192.168.1.1)");
+        }
+        auto& ethernetv2 = ethernetv2::instance();
 
         // Layer 3: IPv4
         auto& ipv4 = ipv4::instance();
@@ -75,13 +91,31 @@ void init_stack(int argc, char* argv[]) {
         tcp.register_upper_protocol(tcb_manager);
         LOG_INIT("Socket Manager registered");
 
+        // Path MTU discovery: ICMP Fragmentation Needed lowers the MSS of TCP connections
+        icmp.register_frag_needed_handler(
+                [&tcb_manager](two_ends_t two_end, uint32_t seq_no, uint16_t mtu) {
+                        tcb_manager.on_frag_needed(two_end, seq_no, mtu);
+                });
+        LOG_INIT("Path MTU discovery registered");
+
+        // Closed connections are released a few at a time, once per event loop iteration
+        uint32_t reap_budget = connection_limits::get_limit("REAP_BUDGET", connection_limits::DEFAULT_REAP_BUDGET);
+        event_loop::instance().register_iteration_hook(
+                [&tcb_manager, reap_budget]() { tcb_manager.reap_closed_connections(reap_budget); });
+        LOG_INIT("Connection reaper registered");
+
         LOG_INIT("TCP/IP stack initialization complete");
 }
 
 void start_event_loop() {
-        auto& tuntap_dev = tuntap<1500>::instance();
         LOG_INIT("Starting event loop...");
-        tuntap_dev.run();
+        if (af_xdp<1500>::configured_iface()) {
+                af_xdp<1500>::instance().run();
+        } else if (packet_ring<1500>::configured_iface()) {
+                packet_ring<1500>::instance().run();
+        } else {
+                tuntap<1500>::instance().run();
+        }
 }
 
 // Get event loop instance for registering callbacks
@@ -101,14 +135,102 @@ int accept(int fd) {
         auto& socket_manager = socket_manager::instance();
         return socket_manager.accept(fd);
 }
+// Non-blocking: returns -1/EINPROGRESS, completion via event_loop::register_connect_callback.
+// Use port 0 in socket() for an ephemeral local port.
+int connect(int fd, ipv4_addr_t ipv4_addr, port_addr_t port_addr) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.connect(fd, {.ipv4_addr = ipv4_addr, .port_addr = port_addr});
+}
+int socket_error(int fd) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.get_socket_error(fd);
+}
 int read(int fd, char* buf, int& len) {
         auto& socket_manager = socket_manager::instance();
         return socket_manager.read(fd, buf, len);
 }
 
+// Scatter / gather variants: len is set to the bytes moved, as for read() / write()
+int readv(int fd, const iovec* iov, int iovcnt, int& len) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.readv(fd, iov, iovcnt, len);
+}
+int writev(int fd, const iovec* iov, int iovcnt, int& len) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.writev(fd, iov, iovcnt, len);
+}
+
+// Zero-copy read: views into received segments, count is in/out. Views stay valid and
+// count against the receive window until passed to release_zerocopy()
+int read_zerocopy(int fd, recv_view_t* views, int& count) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.read_zerocopy(fd, views, count);
+}
+int release_zerocopy(int fd, const recv_view_t* views, int count) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.release_zerocopy(fd, views, count);
+}
+
+// len is updated to the bytes accepted; -1/EAGAIN when the send buffer is full
+// (event_loop::register_write_callback fires when it drains)
 int write(int fd, char* buf, int& len) {
         auto& socket_manager = socket_manager::instance();
         return socket_manager.write(fd, buf, len);
 }
+// Borrow buf instead of copying it; keep it untouched until id reaches the callback
+// registered with event_loop::register_zerocopy_callback, or until close() returns
+int write_zerocopy(int fd, const char* buf, int& len, uint32_t& id) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.write_zerocopy(fd, buf, len, id);
+}
+// Queue len bytes of file_fd from offset without copying them (mmap); len and offset
+// are updated to what was queued, 0 bytes at end of file
+int sendfile(int fd, int file_fd, off_t& offset, int& len) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.sendfile(fd, file_fd, offset, len);
+}
+int set_send_buffer(int fd, uint32_t limit, uint32_t low_watermark = 0) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.set_send_buffer(fd, limit, low_watermark);
+}
+
+// Dead peer detection: probes after idle_s of silence, every interval_s, count of them
+// (0 keeps the current value). Dead peers surface as ETIMEDOUT from read().
+int set_keepalive(int fd, bool enable, uint32_t idle_s = 0, uint32_t interval_s = 0, uint32_t count = 0) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.set_keepalive(fd, enable, idle_s, interval_s, count);
+}
+int set_user_timeout(int fd, uint32_t timeout_ms) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.set_user_timeout(fd, timeout_ms);
+}
+
+// epoll for stack sockets (EPOLLIN/OUT/RDHUP/ERR/HUP, EPOLLET, EPOLLONESHOT).
+// epoll_wait() never blocks: register a read callback on the epoll fd, it fires
+// while sockets are ready.
+int epoll_create() {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.epoll_create();
+}
+int epoll_ctl(int epfd, int op, int fd, epoll_event* event) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.epoll_ctl(epfd, op, fd, event);
+}
+int epoll_wait(int epfd, epoll_event* events, int max_events) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.epoll_wait(epfd, events, max_events);
+}
+
+// how: SHUT_RD, SHUT_WR or SHUT_RDWR
+int shutdown(int fd, int how) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.shutdown(fd, how);
+}
+// The fd is free on return; the connection closes in the background.
+// abortive = true resets the connection instead (SO_LINGER with a zero timeout).
+int close(int fd, bool abortive = false) {
+        auto& socket_manager = socket_manager::instance();
+        return socket_manager.close(fd, abortive);
+}
 
 }  // namespace uStack
\ No newline at end of file
@@ -0,0 +1,322 @@
+#pragma once
+#if __cplusplus < 202002L
+#error "coro.hpp needs C++20 coroutines (-std=c++20)"
+#endif
+#include <coroutine>
+#include <exception>
+#include <unordered_map>
+#include <utility>
+
+#include "api.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* coro_doc = R"(
+FILE: coro.hpp
+PURPOSE: C++20 coroutine socket API. Types: task<T>, coro_scheduler. Awaitables: async_accept(),
+         async_read(), async_write(), async_connect(). Functions: spawn(), close_socket().
+
+- Each awaitable first tries the non-blocking call; only on EAGAIN/EINPROGRESS does
+  the coroutine suspend
+- Suspended operations are parked on the socket in coro_scheduler, which owns one
+  edge-triggered stack epoll instance; its event loop read callback retries the
+  parked operation and resumes the coroutine only once it completed, in the event
+  loop thread (no spurious wakeups, no std::function per wait)
+- task<T> is lazy and resumes its awaiter by symmetric transfer; spawn() starts a
+  detached task<void> that frees itself when it finishes
+- One reader and one writer may wait on a socket at a time
+
+  task<void> echo(int fd) {
+          char buf[2000];
+          int  n;
+          while ((n = co_await async_read(fd, buf, sizeof(buf))) > 0) {
+                  co_await async_write(fd, buf, n);
+          }
+          close_socket(fd);
+  }
+  task<void> server(int listen_fd) {
+          for (;;) {
+                  int fd = co_await async_accept(listen_fd);
+                  if (fd >= 0) spawn(echo(fd));
+          }
+  }
+  spawn(server(fd)); start_event_loop();
+)";
+}
+
+template <typename T = void>
+class task;
+
+namespace detail {
+        struct promise_base {
+                std::coroutine_handle<> continuation;
+                std::exception_ptr      exception;
+                bool                    detached = false;
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+
+                struct final_awaiter {
+                        bool await_ready() noexcept { return false; }
+                        template <typename Promise>
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                                promise_base& promise = handle.promise();
+                                if (promise.continuation) return promise.continuation;
+                                if (promise.detached) {
+                                        if (promise.exception) std::terminate();  // Nobody to rethrow to
+                                        handle.destroy();
+                                }
+                                return std::noop_coroutine();
+                        }
+                        void await_resume() noexcept {}
+                };
+                final_awaiter final_suspend() noexcept { return {}; }
+
+                void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct promise : promise_base {
+                T value{};
+
+                task<T> get_return_object();
+                void    return_value(T result) { value = std::move(result); }
+        };
+
+        template <>
+        struct promise<void> : promise_base {
+                task<void> get_return_object();
+                void       return_void() {}
+        };
+}  // namespace detail
+
+// Lazily started coroutine; co_await runs it and yields its co_return value
+template <typename T>
+class task {
+public:
+        using promise_type = detail::promise<T>;
+        using handle_type  = std::coroutine_handle<promise_type>;
+
+        explicit task(handle_type handle) : handle(handle) {}
+        task(task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+        task(const task&)            = delete;
+        task& operator=(const task&) = delete;
+        ~task() {
+                if (handle) handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+        }
+        T await_resume() {
+                if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+                if constexpr (!std::is_void_v<T>) return std::move(handle.promise().value);
+        }
+
+        // Hand the coroutine over to itself: it runs now and destroys itself when done
+        void start_detached() {
+                handle_type started       = std::exchange(handle, nullptr);
+                started.promise().detached = true;
+                started.resume();
+        }
+
+private:
+        handle_type handle;
+};
+
+namespace detail {
+        template <typename T>
+        task<T> promise<T>::get_return_object() {
+                return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+        }
+        inline task<void> promise<void>::get_return_object() {
+                return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+        }
+}  // namespace detail
+
+// A parked socket operation; attempt() retries it and returns true once it completed
+struct io_wait_t {
+        int                     fd;
+        std::coroutine_handle<> handle;
+        int                     result = -1;
+        int                     error  = 0;
+
+        explicit io_wait_t(int fd) : fd(fd) {}
+        virtual ~io_wait_t() = default;
+        virtual bool attempt() = 0;
+};
+
+class coro_scheduler {
+private:
+        struct waiters_t {
+                io_wait_t* reader = nullptr;
+                io_wait_t* writer = nullptr;
+        };
+
+        static constexpr int MAX_EVENTS = 64;
+
+        int                                epfd = -1;
+        std::unordered_map<int, waiters_t> waiters;
+
+        coro_scheduler()  = default;
+        ~coro_scheduler() = default;
+
+        void ensure_epoll() {
+                if (epfd >= 0) return;
+                epfd = uStack::epoll_create();
+                event_loop::instance().register_read_callback(epfd, [this]() { dispatch(); });
+        }
+
+        // Runs from the event loop while the epoll fd has ready sockets
+        void dispatch() {
+                epoll_event events[MAX_EVENTS];
+                int         count = uStack::epoll_wait(epfd, events, MAX_EVENTS);
+                for (int i = 0; i < count; i++) {
+                        // Looked up per event: a coroutine resumed earlier may have closed the fd
+                        auto it = waiters.find(events[i].data.fd);
+                        if (it == waiters.end()) continue;
+                        uint32_t mask = events[i].events;
+                        io_wait_t* reader = it->second.reader;
+                        io_wait_t* writer = it->second.writer;
+                        if (reader && (mask & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) && reader->attempt()) {
+                                it->second.reader = nullptr;
+                                reader->handle.resume();
+                                it = waiters.find(events[i].data.fd);
+                                if (it == waiters.end()) continue;
+                        }
+                        if (writer && it->second.writer == writer &&
+                            (mask & (EPOLLOUT | EPOLLERR | EPOLLHUP)) && writer->attempt()) {
+                                it->second.writer = nullptr;
+                                writer->handle.resume();
+                        }
+                }
+        }
+
+public:
+        coro_scheduler(const coro_scheduler&)            = delete;
+        coro_scheduler(coro_scheduler&&)                 = delete;
+        coro_scheduler& operator=(const coro_scheduler&) = delete;
+        coro_scheduler& operator=(coro_scheduler&&)      = delete;
+
+        static coro_scheduler& instance() {
+                static coro_scheduler instance;
+                return instance;
+        }
+
+        // Park op until its socket is ready and op->attempt() succeeds
+        void wait(io_wait_t* op, bool for_write) {
+                ensure_epoll();
+                waiters_t& slot = waiters[op->fd];
+                (for_write ? slot.writer : slot.reader) = op;
+
+                // EEXIST when the socket is already registered; the add itself reports
+                // readiness that arrived before the coroutine suspended
+                epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data = {.fd = op->fd}};
+                uStack::epoll_ctl(epfd, EPOLL_CTL_ADD, op->fd, &event);
+        }
+
+        // Drop parked state for a socket that is being closed
+        void forget(int fd) { waiters.erase(fd); }
+
+        size_t waiting() const { return waiters.size(); }
+};
+
+// Base for the awaitables below: try first, park on EAGAIN
+template <bool ForWrite>
+struct io_awaiter : io_wait_t {
+        using io_wait_t::io_wait_t;
+
+        bool await_ready() { return attempt(); }
+        void await_suspend(std::coroutine_handle<> awaiting) {
+                handle = awaiting;
+                coro_scheduler::instance().wait(this, ForWrite);
+        }
+        int await_resume() {
+                if (result < 0) errno = error;
+                return result;
+        }
+
+protected:
+        // Completed with result, or parked again (false) on EAGAIN
+        bool complete(int ret, int value) {
+                if (ret < 0 && errno == EAGAIN) return false;
+                result = ret < 0 ? -1 : value;
+                error  = ret < 0 ? errno : 0;
+                return true;
+        }
+};
+
+// co_await: new connection fd, or -1 with errno
+struct accept_awaiter : io_awaiter<false> {
+        using io_awaiter::io_awaiter;
+        bool attempt() override {
+                int new_fd = uStack::accept(fd);
+                return complete(new_fd, new_fd);
+        }
+};
+
+// co_await: bytes read, 0 at end of stream, or -1 with errno
+struct read_awaiter : io_awaiter<false> {
+        char* buf;
+        int   len;
+        read_awaiter(int fd, char* buf, int len) : io_awaiter(fd), buf(buf), len(len) {}
+        bool attempt() override {
+                int size = len;
+                int ret  = uStack::read(fd, buf, size);
+                return complete(ret, size);
+        }
+};
+
+// co_await: len once all of it is queued (partial writes are continued), or -1 with errno
+struct write_awaiter : io_awaiter<true> {
+        char* buf;
+        int   len;
+        int   done = 0;
+        write_awaiter(int fd, char* buf, int len) : io_awaiter(fd), buf(buf), len(len) {}
+        bool attempt() override {
+                while (done < len) {
+                        int size = len - done;
+                        if (uStack::write(fd, buf + done, size) < 0) return complete(-1, 0);
+                        done += size;
+                }
+                return complete(0, done);
+        }
+};
+
+// co_await: 0 once established, or -1 with errno (ECONNREFUSED, ETIMEDOUT, ...)
+struct connect_awaiter : io_awaiter<true> {
+        ipv4_addr_t ipv4_addr;
+        port_addr_t port_addr;
+        connect_awaiter(int fd, ipv4_addr_t ipv4_addr, port_addr_t port_addr)
+            : io_awaiter(fd), ipv4_addr(ipv4_addr), port_addr(port_addr) {}
+        bool attempt() override {
+                if (int pending = uStack::socket_error(fd)) {
+                        errno = pending;
+                        return complete(-1, 0);
+                }
+                if (uStack::connect(fd, ipv4_addr, port_addr) == 0 || errno == EISCONN) {
+                        return complete(0, 0);
+                }
+                if (errno == EINPROGRESS || errno == EALREADY) errno = EAGAIN;
+                return complete(-1, 0);
+        }
+};
+
+inline accept_awaiter async_accept(int fd) { return accept_awaiter(fd); }
+inline read_awaiter async_read(int fd, char* buf, int len) { return read_awaiter(fd, buf, len); }
+inline write_awaiter async_write(int fd, char* buf, int len) { return write_awaiter(fd, buf, len); }
+inline connect_awaiter async_connect(int fd, ipv4_addr_t ipv4_addr, port_addr_t port_addr) {
+        return connect_awaiter(fd, ipv4_addr, port_addr);
+}
+
+// Start a detached coroutine; it runs until its first suspension right away
+inline void spawn(task<void> coroutine) { coroutine.start_detached(); }
+
+// close() for sockets used with the awaitables
+inline int close_socket(int fd, bool abortive = false) {
+        coro_scheduler::instance().forget(fd);
+        return uStack::close(fd, abortive);
+}
+}  // namespace uStack
@@ -0,0 +1,187 @@
+#pragma once
+#include <sys/epoll.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+namespace uStack {
+
+namespace docs {
+static const char* epoll_doc = R"(
+FILE: epoll.hpp
+PURPOSE: epoll-style readiness for stack sockets. Methods: add(), modify(), remove(), notify(), wait().
+
+- Interest list: fd -> epoll_item_t, touched only by epoll_ctl()
+- Ready list: intrusive doubly linked list through the epoll_item_t embedded in
+  each socket_t; notify() and wait() are O(1) per ready socket, idle sockets
+  cost nothing per iteration
+- EPOLLIN / EPOLLOUT / EPOLLRDHUP / EPOLLERR / EPOLLHUP, EPOLLET and EPOLLONESHOT
+  with Linux semantics (constants from <sys/epoll.h>)
+- Edge-triggered: reports the events notified since the last report
+- Level-triggered: re-polls the socket when reporting and keeps it on the
+  ready list while it is still ready
+- A socket belongs to at most one epoll instance (EEXIST otherwise)
+)";
+}
+
+class epoll_t;
+
+// Interest list entry, embedded in socket_t
+struct epoll_item_t {
+        epoll_t*      owner   = nullptr;
+        int           fd      = -1;
+        uint32_t      events  = 0;  // Interest mask including EPOLLET / EPOLLONESHOT, MODE_FLAGS only when disarmed
+        epoll_data_t  data    = {};
+        uint32_t      revents = 0;  // Notified since the last report (edge-triggered)
+        bool          ready   = false;
+        epoll_item_t* prev    = nullptr;
+        epoll_item_t* next    = nullptr;
+};
+
+class epoll_t {
+public:
+        // Reported whether or not they are in the interest mask
+        static constexpr uint32_t ALWAYS_REPORTED = EPOLLERR | EPOLLHUP;
+        static constexpr uint32_t MODE_FLAGS      = EPOLLET | EPOLLONESHOT;
+
+private:
+        std::unordered_map<int, epoll_item_t*> interest;
+        epoll_item_t*                          head = nullptr;
+        epoll_item_t*                          tail = nullptr;
+        size_t                                 ready_count = 0;
+        std::function<void()>                  on_ready;  // Ready list became non-empty
+
+        // ALWAYS_REPORTED is folded in by add()/modify(), so a disarmed one-shot item wants nothing
+        static uint32_t wanted(const epoll_item_t& item) { return item.events & ~MODE_FLAGS; }
+
+        void link(epoll_item_t& item) {
+                bool was_empty = head == nullptr;
+                item.ready     = true;
+                item.prev      = tail;
+                item.next      = nullptr;
+                if (tail) {
+                        tail->next = &item;
+                } else {
+                        head = &item;
+                }
+                tail = &item;
+                ready_count++;
+                if (was_empty && on_ready) on_ready();
+        }
+
+        void unlink(epoll_item_t& item) {
+                if (!item.ready) return;
+                if (item.prev) {
+                        item.prev->next = item.next;
+                } else {
+                        head = item.next;
+                }
+                if (item.next) {
+                        item.next->prev = item.prev;
+                } else {
+                        tail = item.prev;
+                }
+                item.prev  = nullptr;
+                item.next  = nullptr;
+                item.ready = false;
+                ready_count--;
+        }
+
+public:
+        explicit epoll_t(std::function<void()> on_ready) : on_ready(std::move(on_ready)) {}
+
+        ~epoll_t() {
+                for (auto& [fd, item] : interest) {
+                        item->owner = nullptr;
+                        item->ready = false;
+                        item->prev  = nullptr;
+                        item->next  = nullptr;
+                }
+        }
+
+        epoll_t(const epoll_t&)            = delete;
+        epoll_t& operator=(const epoll_t&) = delete;
+
+        // current: the socket's readiness right now, so already-ready sockets are reported
+        int add(epoll_item_t& item, int fd, const epoll_event& event, uint32_t current) {
+                if (item.owner) {
+                        errno = EEXIST;
+                        return -1;
+                }
+                item.owner   = this;
+                item.fd      = fd;
+                item.events  = event.events | ALWAYS_REPORTED;
+                item.data    = event.data;
+                item.revents = 0;
+                interest[fd] = &item;
+                notify(item, current);
+                return 0;
+        }
+
+        int modify(epoll_item_t& item, const epoll_event& event, uint32_t current) {
+                if (item.owner != this) {
+                        errno = ENOENT;
+                        return -1;
+                }
+                item.events  = event.events | ALWAYS_REPORTED;
+                item.data    = event.data;
+                item.revents = 0;
+                unlink(item);
+                notify(item, current);
+                return 0;
+        }
+
+        int remove(epoll_item_t& item) {
+                if (item.owner != this) {
+                        errno = ENOENT;
+                        return -1;
+                }
+                unlink(item);
+                interest.erase(item.fd);
+                item.owner = nullptr;
+                return 0;
+        }
+
+        // Called from the readiness path (socket_manager) when events happen on a socket
+        void notify(epoll_item_t& item, uint32_t events) {
+                events &= wanted(item);
+                if (events == 0) return;
+                item.revents |= events;
+                if (!item.ready) link(item);
+        }
+
+        // Non-blocking. poll(item) returns the socket's current readiness (level-triggered).
+        template <typename Poll>
+        int wait(epoll_event* events, int max_events, Poll poll) {
+                int    count  = 0;
+                size_t budget = ready_count;  // Items re-queued below are not revisited
+                while (head && budget-- > 0 && count < max_events) {
+                        epoll_item_t& item = *head;
+                        unlink(item);
+
+                        bool     edge = item.events & EPOLLET;
+                        uint32_t mask = (edge ? item.revents : poll(item) | (item.revents & EPOLLHUP)) & wanted(item);
+                        item.revents  = 0;
+                        if (mask == 0) continue;
+
+                        events[count].events = mask;
+                        events[count].data   = item.data;
+                        count++;
+
+                        if (item.events & EPOLLONESHOT) {
+                                item.events &= MODE_FLAGS;  // Disarmed until EPOLL_CTL_MOD
+                        } else if (!edge && (poll(item) & wanted(item))) {
+                                link(item);
+                        }
+                }
+                // Still ready (level-triggered leftovers, more than max_events): stay readable
+                if (head && on_ready) on_ready();
+                return count;
+        }
+
+        size_t size() const { return interest.size(); }
+        size_t ready() const { return ready_count; }
+};
+}  // namespace uStack
@@ -0,0 +1,417 @@
+#pragma once
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.hpp"
+#include "socket_manager.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* io_ring_doc = R"(
+FILE: io_ring.hpp
+PURPOSE: io_uring-style submission / completion rings over stack sockets. Methods: get_sqe(), submit(), peek_cqe(), cqe_seen(), copy_cqes(), process().
+
+- Application: get_sqe() fills entries, submit() publishes the batch; completions are
+  harvested in bulk with peek_cqe() / copy_cqes() and released with cqe_seen()
+- Stack: process() consumes every published entry in one pass; operations that
+  would block are parked per socket (FIFO per direction) and retried when the
+  ring's stack epoll instance reports the socket ready, from the event loop
+- SQ and CQ are single-producer / single-consumer rings (power of two entries,
+  acquire / release indices), so the two sides may run on different threads
+- A full CQ spills into an overflow list, moved into the CQ by the next process()
+  (a bound ring's wait_cqe() rings the stack before sleeping, so it gets flushed)
+- Close sockets through RING_OP_CLOSE: it cancels the operations parked on them
+  (-ECANCELED) before closing
+- Bound to a stack thread (stack_thread::attach), submit() only publishes and rings
+  the stack's doorbell; the stack rings the ring's own doorbell after posting
+  completions. wait_cqe() busy-polls the CQ for an adaptive number of spins
+  (doubled when a completion arrives while spinning, halved when it had to
+  sleep) before sleeping on the eventfd. Doorbells only cost a write() when the
+  other side is asleep
+
+  ring_sqe_t* sqe = ring.get_sqe();
+  *sqe = {.opcode = RING_OP_RECV, .fd = fd, .buf = buf, .len = sizeof(buf), .user_data = 1};
+  ring.submit();
+  ...
+  while (ring_cqe_t* cqe = ring.peek_cqe()) { handle(cqe->user_data, cqe->res); ring.cqe_seen(1); }
+)";
+}
+
+// eventfd plus a sleeping flag: ring() makes the syscall only when the owner sleeps.
+// Owner: prepare_sleep(), re-check for work, then poll() the fd; cancel_sleep() after.
+// Publisher: publish (release), then ring()
+class doorbell_t {
+private:
+        int               fd;
+        std::atomic<bool> sleeping{false};
+
+public:
+        doorbell_t() : fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+        ~doorbell_t() {
+                if (fd >= 0) ::close(fd);
+        }
+
+        doorbell_t(const doorbell_t&)            = delete;
+        doorbell_t& operator=(const doorbell_t&) = delete;
+
+        // The fences order the publisher's index store before its flag load, and the
+        // owner's flag store before its index re-check: one of them sees the other
+        void ring() {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (sleeping.load(std::memory_order_relaxed)) {
+                        uint64_t one = 1;
+                        ssize_t  ret = ::write(fd, &one, sizeof(one));
+                        (void)ret;  // EAGAIN: the counter is already non-zero
+                }
+        }
+
+        void prepare_sleep() {
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        void cancel_sleep() { sleeping.store(false, std::memory_order_relaxed); }
+
+        void drain() {
+                uint64_t value;
+                ssize_t  ret = ::read(fd, &value, sizeof(value));
+                (void)ret;
+        }
+
+        int get_fd() const { return fd; }
+};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+}
+
+enum ring_opcode_t : uint8_t {
+        RING_OP_NOP,
+        RING_OP_ACCEPT,   // res: new fd
+        RING_OP_RECV,     // res: bytes read, 0 at end of stream
+        RING_OP_SEND,     // res: bytes queued, may be short when the send buffer fills
+        RING_OP_CLOSE,    // res: 0
+};
+
+struct ring_sqe_t {
+        uint8_t  opcode;
+        int      fd;
+        char*    buf;
+        uint32_t len;
+        uint64_t user_data;
+};
+
+struct ring_cqe_t {
+        uint64_t user_data;
+        int32_t  res;  // >= 0 on success, -errno on failure
+};
+
+class io_ring_t {
+private:
+        struct parked_t {
+                std::deque<ring_sqe_t> in;   // ACCEPT / RECV, waiting for EPOLLIN
+                std::deque<ring_sqe_t> out;  // SEND, waiting for EPOLLOUT
+        };
+
+        static constexpr int      MAX_EVENTS = 64;
+        static constexpr uint32_t SPIN_MIN   = 64;
+        static constexpr uint32_t SPIN_MAX   = 1 << 16;
+
+        const uint32_t          mask;
+        std::vector<ring_sqe_t> sq;
+        std::vector<ring_cqe_t> cq;
+        std::atomic<uint32_t>   sq_head{0};  // Stack: next entry to consume
+        std::atomic<uint32_t>   sq_tail{0};  // Application: published entries
+        std::atomic<uint32_t>   cq_head{0};  // Application: next completion to read
+        std::atomic<uint32_t>   cq_tail{0};  // Stack: published completions
+        uint32_t                sq_local_tail = 0;  // Filled by get_sqe(), not yet submitted
+
+        std::deque<ring_cqe_t>                overflow;
+        std::unordered_map<int, parked_t>     parked;
+        int                                   epfd = -1;
+
+        doorbell_t*                 submit_bell = nullptr;  // Stack thread's, see bind()
+        std::unique_ptr<doorbell_t> completion_bell;
+        uint32_t                    spin_budget = SPIN_MIN;  // Application side, wait_cqe()
+
+        static uint32_t round_up(uint32_t entries) {
+                uint32_t size = 1;
+                while (size < entries) size <<= 1;
+                return size;
+        }
+
+        void complete(uint64_t user_data, int32_t res) {
+                uint32_t tail = cq_tail.load(std::memory_order_relaxed);
+                if (!overflow.empty() || tail - cq_head.load(std::memory_order_acquire) > mask) {
+                        overflow.push_back({.user_data = user_data, .res = res});
+                        return;
+                }
+                cq[tail & mask] = {.user_data = user_data, .res = res};
+                cq_tail.store(tail + 1, std::memory_order_release);
+        }
+
+        void flush_overflow() {
+                uint32_t tail = cq_tail.load(std::memory_order_relaxed);
+                uint32_t head = cq_head.load(std::memory_order_acquire);
+                while (!overflow.empty() && tail - head <= mask) {
+                        cq[tail++ & mask] = overflow.front();
+                        overflow.pop_front();
+                }
+                cq_tail.store(tail, std::memory_order_release);
+        }
+
+        // One non-blocking attempt; false when the operation would block
+        bool attempt(socket_manager& sockets, ring_sqe_t& sqe) {
+                int ret = 0;
+                int len = sqe.len;
+                switch (sqe.opcode) {
+                        case RING_OP_ACCEPT:
+                                ret = sockets.accept(sqe.fd);
+                                len = ret;
+                                break;
+                        case RING_OP_RECV:
+                                ret = sockets.read(sqe.fd, sqe.buf, len);
+                                break;
+                        case RING_OP_SEND:
+                                ret = sockets.write(sqe.fd, sqe.buf, len);
+                                break;
+                        default:
+                                break;
+                }
+                if (ret < 0 && errno == EAGAIN) return false;
+                complete(sqe.user_data, ret < 0 ? -errno : len);
+                return true;
+        }
+
+        void park(std::deque<ring_sqe_t>& queue, const ring_sqe_t& sqe) {
+                queue.push_back(sqe);
+                if (epfd < 0) {
+                        epfd = socket_manager::instance().epoll_create();
+                        event_loop::instance().register_read_callback(epfd, [this]() { on_ready(); });
+                }
+                // EEXIST once registered; the add reports readiness that is already there
+                epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data = {.fd = sqe.fd}};
+                socket_manager::instance().epoll_ctl(epfd, EPOLL_CTL_ADD, sqe.fd, &event);
+        }
+
+        // Retry parked operations in order until one would block again
+        void retry(socket_manager& sockets, std::deque<ring_sqe_t>& queue) {
+                while (!queue.empty() && attempt(sockets, queue.front())) {
+                        queue.pop_front();
+                }
+        }
+
+        void dispatch(socket_manager& sockets, ring_sqe_t& sqe) {
+                if (sqe.opcode == RING_OP_NOP) {
+                        complete(sqe.user_data, 0);
+                        return;
+                }
+                if (sqe.opcode == RING_OP_CLOSE) {
+                        auto it = parked.find(sqe.fd);
+                        if (it != parked.end()) {
+                                for (auto* queue : {&it->second.in, &it->second.out}) {
+                                        for (auto& pending : *queue) complete(pending.user_data, -ECANCELED);
+                                }
+                                parked.erase(it);
+                        }
+                        int ret = sockets.close(sqe.fd);
+                        complete(sqe.user_data, ret < 0 ? -errno : 0);
+                        return;
+                }
+                if (sqe.opcode > RING_OP_CLOSE) {
+                        complete(sqe.user_data, -EINVAL);
+                        return;
+                }
+
+                // Operations queue behind parked ones in the same direction
+                auto                    it    = parked.find(sqe.fd);
+                bool                    out   = sqe.opcode == RING_OP_SEND;
+                std::deque<ring_sqe_t>* queue = nullptr;
+                if (it != parked.end()) {
+                        queue = out ? &it->second.out : &it->second.in;
+                        if (!queue->empty()) {
+                                queue->push_back(sqe);
+                                return;
+                        }
+                }
+                if (attempt(sockets, sqe)) return;
+                if (!queue) {
+                        parked_t& entry = parked[sqe.fd];
+                        queue           = out ? &entry.out : &entry.in;
+                }
+                park(*queue, sqe);
+        }
+
+        // Event loop read callback of the ring's epoll fd
+        void on_ready() {
+                socket_manager& sockets = socket_manager::instance();
+                if (!overflow.empty()) flush_overflow();
+                epoll_event     events[MAX_EVENTS];
+                int             count = sockets.epoll_wait(epfd, events, MAX_EVENTS);
+                for (int i = 0; i < count; i++) {
+                        auto it = parked.find(events[i].data.fd);
+                        if (it == parked.end()) continue;
+                        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                                retry(sockets, it->second.in);
+                        }
+                        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                                retry(sockets, it->second.out);
+                        }
+                }
+                notify();
+        }
+
+        void notify() {
+                if (completion_bell) completion_bell->ring();
+        }
+
+public:
+        explicit io_ring_t(uint32_t entries)
+            : mask(round_up(entries) - 1), sq(mask + 1), cq(mask + 1) {}
+
+        ~io_ring_t() {
+                if (epfd >= 0) socket_manager::instance().close(epfd);
+        }
+
+        io_ring_t(const io_ring_t&)            = delete;
+        io_ring_t& operator=(const io_ring_t&) = delete;
+
+        // Application side
+
+        // Next free submission entry, nullptr when the SQ is full
+        ring_sqe_t* get_sqe() {
+                if (sq_local_tail - sq_head.load(std::memory_order_acquire) > mask) return nullptr;
+                return &sq[sq_local_tail++ & mask];
+        }
+
+        // Publish the entries filled since the last submit and process them (event loop
+        // thread); bound to a stack thread, returns how many were published instead
+        uint32_t submit() {
+                uint32_t published = sq_local_tail - sq_tail.load(std::memory_order_relaxed);
+                sq_tail.store(sq_local_tail, std::memory_order_release);
+                if (submit_bell) {
+                        submit_bell->ring();
+                        return published;
+                }
+                return process();
+        }
+
+        // Next completion, spinning and then sleeping up to timeout_ms (-1: forever);
+        // nullptr on timeout. Without a stack thread there is nothing to wait for
+        ring_cqe_t* wait_cqe(int timeout_ms = -1) {
+                if (ring_cqe_t* cqe = peek_cqe()) return cqe;
+                if (!completion_bell) return nullptr;
+                for (uint32_t spin = 0; spin < spin_budget; spin++) {
+                        cpu_relax();
+                        if (ring_cqe_t* cqe = peek_cqe()) {
+                                spin_budget = std::min(spin_budget * 2, SPIN_MAX);
+                                return cqe;
+                        }
+                }
+                spin_budget = std::max(spin_budget / 2, SPIN_MIN);
+
+                // The stack may sleep on completions that overflowed while the CQ was full
+                submit_bell->ring();
+                completion_bell->prepare_sleep();
+                ring_cqe_t* cqe = peek_cqe();
+                if (!cqe) {
+                        pollfd pfd = {.fd = completion_bell->get_fd(), .events = POLLIN, .revents = 0};
+                        ::poll(&pfd, 1, timeout_ms);
+                        cqe = peek_cqe();
+                }
+                completion_bell->cancel_sleep();
+                completion_bell->drain();
+                return cqe ? cqe : peek_cqe();
+        }
+
+        ring_cqe_t* peek_cqe() {
+                uint32_t head = cq_head.load(std::memory_order_relaxed);
+                if (head == cq_tail.load(std::memory_order_acquire)) return nullptr;
+                return &cq[head & mask];
+        }
+
+        // Copy up to max completions and mark them seen
+        uint32_t copy_cqes(ring_cqe_t* out, uint32_t max) {
+                uint32_t head  = cq_head.load(std::memory_order_relaxed);
+                uint32_t count = std::min(cq_tail.load(std::memory_order_acquire) - head, max);
+                for (uint32_t i = 0; i < count; i++) {
+                        out[i] = cq[(head + i) & mask];
+                }
+                cqe_seen(count);
+                return count;
+        }
+
+        void cqe_seen(uint32_t count) {
+                cq_head.store(cq_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Stack side: consume every published submission, returns how many
+        uint32_t process() {
+                socket_manager& sockets = socket_manager::instance();
+                bool            flushed = !overflow.empty();
+                if (flushed) flush_overflow();
+                uint32_t        head    = sq_head.load(std::memory_order_relaxed);
+                uint32_t        tail    = sq_tail.load(std::memory_order_acquire);
+                for (uint32_t i = head; i != tail; i++) {
+                        ring_sqe_t sqe = sq[i & mask];
+                        dispatch(sockets, sqe);
+                }
+                sq_head.store(tail, std::memory_order_release);
+                if (tail != head || flushed) notify();
+                return tail - head;
+        }
+
+        // Stack side: submissions to consume, or overflow that now fits the CQ
+        bool has_work() const {
+                if (sq_head.load(std::memory_order_relaxed) != sq_tail.load(std::memory_order_acquire)) {
+                        return true;
+                }
+                return !overflow.empty() &&
+                       cq_tail.load(std::memory_order_relaxed) - cq_head.load(std::memory_order_acquire) <= mask;
+        }
+
+        // Hand the ring to a stack thread: submit() rings stack_bell instead of processing
+        void bind(doorbell_t& stack_bell) {
+                completion_bell = std::make_unique<doorbell_t>();
+                submit_bell     = &stack_bell;
+        }
+
+        // Stack side, before the ring is dropped: cancel parked operations, close the epoll fd
+        void shutdown() {
+                for (auto& [fd, entry] : parked) {
+                        for (auto* queue : {&entry.in, &entry.out}) {
+                                for (auto& pending : *queue) complete(pending.user_data, -ECANCELED);
+                        }
+                }
+                parked.clear();
+                if (epfd >= 0) {
+                        socket_manager::instance().close(epfd);
+                        epfd = -1;
+                }
+                notify();
+        }
+
+        uint32_t entries() const { return mask + 1; }
+        size_t   parked_count() const {
+                size_t count = 0;
+                for (auto& [fd, entry] : parked) count += entry.in.size() + entry.out.size();
+                return count;
+        }
+        size_t overflow_count() const { return overflow.size(); }
+};
+}  // namespace uStack
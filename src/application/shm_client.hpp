@@ -0,0 +1,333 @@
+#pragma once
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ipv4_addr.hpp"
+#include "shm_transport.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* shm_client_doc = R"(
+FILE: shm_client.hpp
+PURPOSE: Client side of the shared memory transport: the socket API of api.hpp against a stack daemon (ustackd). Functions (namespace remote): attach(), detach(), socket(), listen(), accept(), connect(), socket_error(), read(), write(), shutdown(), close(), poll().
+
+- attach() connects to the daemon's unix socket (USTACK_SOCKET, default
+  /tmp/ustack.sock) and maps the segment it hands over; no stack code is linked in
+- socket() / listen() / accept() / connect() / shutdown() / close() go through the
+  command ring and wait for the daemon's response
+- read() / write() only touch the socket's rx / tx ring: non-blocking, EAGAIN when
+  the ring is empty / full, 0 bytes at end of stream, as in api.hpp
+- poll() waits for POLLIN / POLLOUT: spins for an adaptive budget, then sleeps on
+  the client's eventfd
+- One thread per attachment: the rings are single-producer / single-consumer
+
+  remote::attach();
+  int fd = remote::socket(0x06, ipv4_addr_t("192.168.1.1"), 30000);
+  remote::listen(fd);
+  remote::poll(fd, POLLIN, -1);
+  int cfd = remote::accept(fd);
+)";
+}
+
+class shm_client {
+private:
+        static constexpr uint32_t SPIN_MIN = 64;
+        static constexpr uint32_t SPIN_MAX = 1 << 16;
+
+        shm::segment_t* seg         = nullptr;
+        int             sock        = -1;
+        int             daemon_bell = -1;
+        int             bell        = -1;
+        uint32_t        next_seq    = 0;
+        uint32_t        spin_budget = SPIN_MIN;
+        bool            open_slots[shm::MAX_SOCKETS] = {};
+
+        shm_client()  = default;
+        ~shm_client() { detach(); }
+
+        static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                asm volatile("yield");
+#endif
+        }
+
+public:
+        shm_client(const shm_client&)            = delete;
+        shm_client(shm_client&&)                 = delete;
+        shm_client& operator=(const shm_client&) = delete;
+        shm_client& operator=(shm_client&&)      = delete;
+
+        static shm_client& instance() {
+                static shm_client instance;
+                return instance;
+        }
+
+        // 0 or -1 with errno set; path nullptr: USTACK_SOCKET or the default
+        int attach(const char* path = nullptr) {
+                if (seg) return 0;
+                if (!path) path = std::getenv("USTACK_SOCKET");
+                if (!path) path = shm::DEFAULT_PATH;
+                sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = {}};
+                if (std::strlen(path) >= sizeof(addr.sun_path)) {
+                        errno = ENAMETOOLONG;
+                        return -1;
+                }
+                std::strcpy(addr.sun_path, path);
+
+                sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                if (sock < 0) return -1;
+                shm::hello_t hello;
+                int          fds[shm::HELLO_FDS];
+                if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+                    !shm::recv_hello(sock, hello, fds)) {
+                        int error = errno ? errno : EPROTO;
+                        ::close(sock);
+                        sock  = -1;
+                        errno = error;
+                        return -1;
+                }
+                void* mem = MAP_FAILED;
+                if (hello.size == sizeof(shm::segment_t)) {
+                        mem = ::mmap(nullptr, sizeof(shm::segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+                }
+                ::close(fds[0]);
+                if (mem == MAP_FAILED) {
+                        ::close(fds[1]);
+                        ::close(fds[2]);
+                        ::close(sock);
+                        sock  = -1;
+                        errno = EPROTO;
+                        return -1;
+                }
+                seg         = static_cast<shm::segment_t*>(mem);
+                daemon_bell = fds[1];
+                bell        = fds[2];
+                return 0;
+        }
+
+        // The daemon closes every socket of this client
+        void detach() {
+                if (!seg) return;
+                ::munmap(seg, sizeof(shm::segment_t));
+                ::close(daemon_bell);
+                ::close(bell);
+                ::close(sock);
+                seg = nullptr;
+                sock = daemon_bell = bell = -1;
+                std::memset(open_slots, 0, sizeof(open_slots));
+        }
+
+        void wake_daemon() { shm::wake(seg->daemon_sleeping, daemon_bell); }
+
+        // Spin, then sleep on the eventfd until ready() or timeout_ms (-1: forever); gives
+        // up when the daemon closes the unix socket. Activity on the extra (kernel) fds
+        // also wakes the sleep, ready() is expected to look at them
+        template <typename Ready>
+        bool wait_until(Ready ready, int timeout_ms, const pollfd* extra = nullptr, nfds_t extra_count = 0) {
+                if (ready()) return true;
+                for (uint32_t spin = 0; spin < spin_budget; spin++) {
+                        cpu_relax();
+                        if (ready()) {
+                                spin_budget = std::min(spin_budget * 2, SPIN_MAX);
+                                return true;
+                        }
+                }
+                spin_budget = std::max(spin_budget / 2, SPIN_MIN);
+
+                // ready() may consume (a response): call it once per wakeup
+                bool ok       = false;
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+                for (;;) {
+                        shm::prepare_sleep(seg->client_sleeping);
+                        if ((ok = ready())) break;
+                        int wait_ms = -1;
+                        if (timeout_ms >= 0) {
+                                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        deadline - std::chrono::steady_clock::now());
+                                if (left.count() <= 0) break;
+                                wait_ms = left.count();
+                        }
+                        std::vector<pollfd> pfds = {{.fd = bell, .events = POLLIN, .revents = 0},
+                                                    {.fd = sock, .events = POLLIN, .revents = 0}};
+                        pfds.insert(pfds.end(), extra, extra + extra_count);
+                        ::poll(pfds.data(), pfds.size(), wait_ms);
+                        shm::drain(bell);
+                        if (pfds[1].revents) break;
+                }
+                seg->client_sleeping.store(0, std::memory_order_relaxed);
+                return ok;
+        }
+
+        // One command, waits for its response; returns res (-errno on failure)
+        int32_t call(shm::command_t cmd) {
+                if (!seg) return -ENOTCONN;
+                cmd.seq = next_seq++;
+                while (!seg->commands.push(cmd)) {
+                        wake_daemon();
+                        wait_until([this]() { return !seg->commands.full(); }, 1);
+                }
+                wake_daemon();
+                shm::response_t response;
+                if (!wait_until([this, &response]() { return seg->responses.pop(response); }, -1)) {
+                        return -ECONNRESET;
+                }
+                return response.res;
+        }
+
+        shm::socket_slot_t* slot(int fd) {
+                if (!seg || fd < 0 || fd >= shm::MAX_SOCKETS || !open_slots[fd]) {
+                        errno = EBADF;
+                        return nullptr;
+                }
+                return &seg->slots[fd];
+        }
+
+        void set_open(int fd, bool open) { open_slots[fd] = open; }
+};
+
+namespace remote {
+
+namespace detail {
+inline int result(int32_t res) {
+        if (res < 0) {
+                errno = -res;
+                return -1;
+        }
+        return res;
+}
+
+inline int call(shm::command_op_t op, int fd, uint32_t ipv4 = 0, uint16_t port = 0, int32_t arg = 0) {
+        return result(shm_client::instance().call(
+                {.op = op, .slot = fd, .ipv4 = ipv4, .port = port, .arg = arg, .seq = 0}));
+}
+
+// Slot events that make the socket readable
+constexpr uint32_t READABLE = shm::SLOT_ACCEPTABLE | shm::SLOT_EOF | shm::SLOT_ERROR;
+}  // namespace detail
+
+inline int attach(const char* path = nullptr) { return shm_client::instance().attach(path); }
+inline void detach() { shm_client::instance().detach(); }
+
+inline int socket(int proto, ipv4_addr_t ipv4_addr, uint16_t port_addr) {
+        int fd = detail::call(shm::CMD_SOCKET, -1, ipv4_addr.get_raw_ipv4(), port_addr, proto);
+        if (fd >= 0) shm_client::instance().set_open(fd, true);
+        return fd;
+}
+inline int listen(int fd) {
+        if (!shm_client::instance().slot(fd)) return -1;
+        return detail::call(shm::CMD_LISTEN, fd);
+}
+// Non-blocking: EAGAIN without a pending connection, wait with poll(fd, POLLIN)
+inline int accept(int fd) {
+        if (!shm_client::instance().slot(fd)) return -1;
+        int cfd = detail::call(shm::CMD_ACCEPT, fd);
+        if (cfd >= 0) shm_client::instance().set_open(cfd, true);
+        return cfd;
+}
+// Non-blocking: -1/EINPROGRESS, wait with poll(fd, POLLOUT), then check socket_error()
+inline int connect(int fd, ipv4_addr_t ipv4_addr, uint16_t port_addr) {
+        if (!shm_client::instance().slot(fd)) return -1;
+        return detail::call(shm::CMD_CONNECT, fd, ipv4_addr.get_raw_ipv4(), port_addr);
+}
+inline int socket_error(int fd) {
+        shm::socket_slot_t* slot = shm_client::instance().slot(fd);
+        if (!slot) return EBADF;
+        return slot->error.load(std::memory_order_acquire);
+}
+
+inline int read(int fd, char* buf, int& len) {
+        shm::socket_slot_t* slot = shm_client::instance().slot(fd);
+        if (!slot) {
+                len = 0;
+                return -1;
+        }
+        uint32_t n = slot->rx.pop(reinterpret_cast<uint8_t*>(buf), std::max(len, 0));
+        if (n == 0) {
+                // The daemon queues all data before flagging the end: look again after the flag
+                uint32_t events = slot->events.load(std::memory_order_acquire);
+                if (events & (shm::SLOT_EOF | shm::SLOT_ERROR)) {
+                        n = slot->rx.pop(reinterpret_cast<uint8_t*>(buf), std::max(len, 0));
+                }
+                if (n == 0) {
+                        len = 0;
+                        if (events & shm::SLOT_ERROR) {
+                                errno = slot->error.load(std::memory_order_relaxed);
+                                return -1;
+                        }
+                        if (events & shm::SLOT_EOF) return 0;
+                        errno = EAGAIN;
+                        return -1;
+                }
+        }
+        len = n;
+        shm_client::instance().wake_daemon();  // Room in rx
+        return 0;
+}
+
+inline int write(int fd, char* buf, int& len) {
+        shm::socket_slot_t* slot = shm_client::instance().slot(fd);
+        if (!slot) return -1;
+        if (slot->events.load(std::memory_order_acquire) & shm::SLOT_ERROR) {
+                len   = 0;
+                errno = slot->error.load(std::memory_order_relaxed);
+                return -1;
+        }
+        uint32_t n = slot->tx.push(reinterpret_cast<const uint8_t*>(buf), std::max(len, 0));
+        if (n == 0 && len > 0) {
+                errno = EAGAIN;
+                return -1;
+        }
+        len = n;
+        shm_client::instance().wake_daemon();
+        return 0;
+}
+
+// how: SHUT_RD, SHUT_WR or SHUT_RDWR
+inline int shutdown(int fd, int how) {
+        if (!shm_client::instance().slot(fd)) return -1;
+        return detail::call(shm::CMD_SHUTDOWN, fd, 0, 0, how);
+}
+// The fd is free on return; data still in the tx ring is sent before the FIN
+inline int close(int fd, bool abortive = false) {
+        if (!shm_client::instance().slot(fd)) return -1;
+        shm_client::instance().set_open(fd, false);
+        return detail::call(shm::CMD_CLOSE, fd, 0, 0, abortive);
+}
+
+// Current POLLIN / POLLOUT / POLLRDHUP / POLLERR / POLLHUP state of an open socket
+inline short readiness(const shm::socket_slot_t* slot) {
+        uint32_t flags   = slot->events.load(std::memory_order_acquire);
+        short    revents = 0;
+        if (slot->rx.readable() > 0 || (flags & detail::READABLE)) revents |= POLLIN;
+        if ((flags & shm::SLOT_CONNECTED) && slot->tx.writable() > 0) revents |= POLLOUT;
+        if (flags & shm::SLOT_EOF) revents |= POLLRDHUP;
+        if (flags & shm::SLOT_ERROR) revents |= POLLOUT | POLLERR | POLLHUP;
+        return revents;
+}
+
+// Ready events among POLLIN / POLLOUT, 0 on timeout (-1: wait forever), -1 with EBADF
+inline int poll(int fd, short events, int timeout_ms) {
+        shm::socket_slot_t* slot = shm_client::instance().slot(fd);
+        if (!slot) return -1;
+        short revents = 0;
+        auto  ready   = [slot, events, &revents]() {
+                revents = readiness(slot) & (events | POLLERR | POLLHUP);
+                return revents != 0;
+        };
+        shm_client::instance().wait_until(ready, timeout_ms);
+        return revents;
+}
+}  // namespace remote
+}  // namespace uStack
@@ -0,0 +1,372 @@
+#pragma once
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+#include "event_loop.hpp"
+#include "shm_transport.hpp"
+#include "socket_manager.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* shm_server_doc = R"(
+FILE: shm_server.hpp
+PURPOSE: Daemon side of the shared memory transport (ustackd). Methods: start(), session_count().
+
+SINGLETON PATTERN:
+shm_server& server = shm_server::instance();
+
+- start() listens on a unix socket; each client gets its own memfd segment
+- Once per event loop iteration: execute the clients' commands against
+  socket_manager, move tx ring bytes into the sockets and socket data into the rx
+  rings, then ring each client whose rings or responses changed
+- A full rx ring stops reading from the socket, so the TCP receive window closes
+  until the client catches up; a full send buffer parks the tx ring until the
+  socket's write callback
+- close() is deferred until the tx ring is sent; the slot is reused after that
+- A client that disconnects (or dies) has its sockets closed
+)";
+}
+
+class shm_server {
+private:
+        // Daemon-private state of a socket slot
+        struct slot_state_t {
+                int  fd           = -1;  // Stack socket, -1 when the slot is free
+                bool active       = false;  // Accepted or connecting: data is pumped
+                bool send_blocked = false;
+                bool rx_blocked   = false;
+                bool eof          = false;
+                bool failed       = false;
+                bool closing      = false;
+        };
+
+        struct session_t {
+                int              sock        = -1;  // Unix socket, the session ends when it closes
+                int              client_bell = -1;
+                shm::segment_t*  seg         = nullptr;
+                slot_state_t     slots[shm::MAX_SOCKETS];
+                bool             notify      = false;
+        };
+
+        int                                                  listen_sock = -1;
+        int                                                  bell        = -1;
+        std::string                                          path;
+        std::unordered_map<int, std::unique_ptr<session_t>> sessions;  // By unix socket
+
+        shm_server()  = default;
+        ~shm_server() = default;
+
+        void accept_clients() {
+                int sock;
+                while ((sock = ::accept4(listen_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        open_session(sock);
+                }
+        }
+
+        void open_session(int sock) {
+                int memfd       = ::memfd_create("ustack-client", MFD_CLOEXEC);
+                int client_bell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                void* mem       = MAP_FAILED;
+                if (memfd >= 0 && client_bell >= 0 && ::ftruncate(memfd, sizeof(shm::segment_t)) == 0) {
+                        mem = ::mmap(nullptr, sizeof(shm::segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+                }
+                if (mem == MAP_FAILED) {
+                        LOG(ERROR) << "[SHM] cannot create segment: " << strerror(errno);
+                        if (memfd >= 0) ::close(memfd);
+                        if (client_bell >= 0) ::close(client_bell);
+                        ::close(sock);
+                        return;
+                }
+
+                // memfd pages are zero: every ring and flag starts empty
+                auto* seg    = new (mem) shm::segment_t;
+                seg->magic   = shm::MAGIC;
+                seg->version = shm::VERSION;
+
+                shm::hello_t hello   = {.magic = shm::MAGIC, .version = shm::VERSION, .size = sizeof(shm::segment_t)};
+                int          fds[shm::HELLO_FDS] = {memfd, bell, client_bell};
+                bool         sent    = shm::send_hello(sock, hello, fds);
+                ::close(memfd);  // The mapping stays
+                if (!sent) {
+                        LOG(ERROR) << "[SHM] handshake failed: " << strerror(errno);
+                        ::munmap(mem, sizeof(shm::segment_t));
+                        ::close(client_bell);
+                        ::close(sock);
+                        return;
+                }
+
+                auto session         = std::make_unique<session_t>();
+                session->sock        = sock;
+                session->client_bell = client_bell;
+                session->seg         = seg;
+                sessions[sock]       = std::move(session);
+                // Clients never send after the handshake: readable means gone
+                event_loop::instance().register_wakeup_fd(sock, [this, sock]() { close_session(sock); });
+                DLOG(INFO) << "[SHM] client attached: " << sock;
+        }
+
+        void close_session(int sock) {
+                auto it = sessions.find(sock);
+                if (it == sessions.end()) return;
+                session_t& session = *it->second;
+                for (auto& state : session.slots) {
+                        if (state.fd >= 0) release_slot(state, false);
+                }
+                ::munmap(session.seg, sizeof(shm::segment_t));
+                ::close(session.client_bell);
+                ::close(sock);
+                event_loop::instance().unregister_wakeup_fd(sock);
+                sessions.erase(it);
+                DLOG(INFO) << "[SHM] client detached: " << sock;
+        }
+
+        // A free slot for fd with empty rings, -1 when all are taken
+        int assign_slot(session_t& session, int fd) {
+                for (int i = 0; i < shm::MAX_SOCKETS; i++) {
+                        slot_state_t& state = session.slots[i];
+                        if (state.fd >= 0) continue;
+                        state                    = slot_state_t();
+                        state.fd                 = fd;
+                        shm::socket_slot_t& slot = session.seg->slots[i];
+                        slot.events.store(0, std::memory_order_relaxed);
+                        slot.error.store(0, std::memory_order_relaxed);
+                        slot.rx.reset();
+                        slot.tx.reset();
+
+                        auto& evloop = event_loop::instance();
+                        evloop.register_write_callback(fd, [&state]() { state.send_blocked = false; });
+                        evloop.register_connect_callback(fd, [&session, &slot](int error) {
+                                if (error) {
+                                        slot.error.store(error, std::memory_order_relaxed);
+                                        slot.events.fetch_or(shm::SLOT_ERROR, std::memory_order_release);
+                                } else {
+                                        slot.events.fetch_or(shm::SLOT_CONNECTED, std::memory_order_release);
+                                }
+                                session.notify = true;
+                        });
+                        return i;
+                }
+                return -1;
+        }
+
+        void release_slot(slot_state_t& state, bool abortive) {
+                socket_manager::instance().close(state.fd, abortive);  // Unregisters the callbacks
+                state = slot_state_t();
+        }
+
+        void fail_slot(session_t& session, int index, int error) {
+                shm::socket_slot_t& slot = session.seg->slots[index];
+                session.slots[index].failed = true;
+                slot.error.store(error, std::memory_order_relaxed);
+                slot.events.fetch_or(shm::SLOT_ERROR, std::memory_order_release);
+                session.notify = true;
+        }
+
+        int32_t execute(session_t& session, const shm::command_t& cmd) {
+                socket_manager& sockets = socket_manager::instance();
+                if (cmd.op == shm::CMD_SOCKET) {
+                        int fd = sockets.register_socket(cmd.arg, ipv4_addr_t(cmd.ipv4), cmd.port);
+                        if (fd < 0) return -EMFILE;
+                        int index = assign_slot(session, fd);
+                        if (index < 0) {
+                                sockets.close(fd);
+                                return -EMFILE;
+                        }
+                        return index;
+                }
+
+                if (cmd.slot < 0 || cmd.slot >= shm::MAX_SOCKETS) return -EBADF;
+                slot_state_t&       state = session.slots[cmd.slot];
+                shm::socket_slot_t& slot  = session.seg->slots[cmd.slot];
+                if (state.fd < 0 || state.closing) return -EBADF;
+
+                switch (cmd.op) {
+                        case shm::CMD_LISTEN: {
+                                if (sockets.listen(state.fd) < 0) return -errno;
+                                event_loop::instance().register_accept_callback(state.fd, [&session, &slot]() {
+                                        slot.events.fetch_or(shm::SLOT_ACCEPTABLE, std::memory_order_release);
+                                        session.notify = true;
+                                });
+                                return 0;
+                        }
+                        case shm::CMD_ACCEPT: {
+                                int fd = sockets.accept(state.fd);
+                                if (fd < 0) {
+                                        // Set again by the accept callback on the next connection
+                                        if (errno == EAGAIN) slot.events.fetch_and(~uint32_t(shm::SLOT_ACCEPTABLE));
+                                        return -errno;
+                                }
+                                int index = assign_slot(session, fd);
+                                if (index < 0) {
+                                        sockets.close(fd, true);
+                                        return -EMFILE;
+                                }
+                                session.slots[index].active = true;
+                                session.seg->slots[index].events.store(shm::SLOT_CONNECTED, std::memory_order_release);
+                                return index;
+                        }
+                        case shm::CMD_CONNECT:
+                                sockets.connect(state.fd, {.ipv4_addr = ipv4_addr_t(cmd.ipv4), .port_addr = cmd.port});
+                                state.active |= errno == EINPROGRESS;
+                                return -errno;
+                        case shm::CMD_SHUTDOWN:
+                                return sockets.shutdown(state.fd, cmd.arg) < 0 ? -errno : 0;
+                        case shm::CMD_CLOSE:
+                                if (cmd.arg || !state.active || state.failed) {
+                                        release_slot(state, cmd.arg);
+                                } else {
+                                        state.closing = true;  // After the tx ring is sent, see pump()
+                                        pump(session, cmd.slot);
+                                }
+                                return 0;
+                        default:
+                                return -EINVAL;
+                }
+        }
+
+        // Move bytes between the slot's rings and its socket
+        void pump(session_t& session, int index) {
+                slot_state_t&       state   = session.slots[index];
+                shm::socket_slot_t& slot    = session.seg->slots[index];
+                socket_manager&     sockets = socket_manager::instance();
+                if (!state.active || state.failed) return;
+
+                while (!state.send_blocked) {
+                        auto [data, avail] = slot.tx.read_span();
+                        if (avail == 0) break;
+                        int len = avail;
+                        if (sockets.write(state.fd, reinterpret_cast<char*>(const_cast<uint8_t*>(data)), len) < 0) {
+                                if (errno == EAGAIN) {
+                                        state.send_blocked = true;
+                                } else {
+                                        fail_slot(session, index, errno);
+                                }
+                                break;
+                        }
+                        slot.tx.consume(len);
+                        session.notify = true;  // Room for the client's next write
+                        if (len < static_cast<int>(avail)) state.send_blocked = true;
+                }
+                if (state.closing) {
+                        if (slot.tx.readable() == 0 || state.failed) release_slot(state, state.failed);
+                        return;
+                }
+
+                while (!state.eof && !state.failed) {
+                        auto [data, room] = slot.rx.write_span();
+                        state.rx_blocked  = room == 0;
+                        if (room == 0) break;
+                        int len = room;
+                        if (sockets.read(state.fd, reinterpret_cast<char*>(data), len) < 0) {
+                                if (errno != EAGAIN) fail_slot(session, index, errno);
+                                break;
+                        }
+                        if (len == 0) {
+                                state.eof = true;
+                                slot.events.fetch_or(shm::SLOT_EOF, std::memory_order_release);
+                        } else {
+                                slot.rx.produce(len);
+                        }
+                        session.notify = true;
+                }
+        }
+
+        // Iteration hook
+        void service() {
+                for (auto& [sock, session] : sessions) {
+                        shm::segment_t* seg = session->seg;
+                        seg->daemon_sleeping.store(0, std::memory_order_relaxed);
+
+                        // Clients wait for each response, the response ring cannot fill up
+                        shm::command_t cmd;
+                        while (!seg->responses.full() && seg->commands.pop(cmd)) {
+                                seg->responses.push({.seq = cmd.seq, .res = execute(*session, cmd)});
+                                session->notify = true;
+                        }
+                        for (int i = 0; i < shm::MAX_SOCKETS; i++) {
+                                if (session->slots[i].fd >= 0) pump(*session, i);
+                        }
+                        if (session->notify) {
+                                session->notify = false;
+                                shm::wake(seg->client_sleeping, session->client_bell);
+                        }
+                }
+        }
+
+        bool has_work(session_t& session) const {
+                // Set by event loop callbacks, which run after service()
+                if (session.notify || !session.seg->commands.empty()) return true;
+                for (int i = 0; i < shm::MAX_SOCKETS; i++) {
+                        const slot_state_t&       state = session.slots[i];
+                        const shm::socket_slot_t& slot  = session.seg->slots[i];
+                        if (state.fd < 0 || !state.active || state.failed) continue;
+                        if (!state.send_blocked && slot.tx.readable() > 0) return true;
+                        if (state.rx_blocked && slot.rx.writable() > 0) return true;
+                }
+                return false;
+        }
+
+        // Idle check: announce sleep to every client, then look for work they published
+        bool keep_polling() {
+                for (auto& [sock, session] : sessions) {
+                        shm::prepare_sleep(session->seg->daemon_sleeping);
+                }
+                for (auto& [sock, session] : sessions) {
+                        if (has_work(*session)) return true;
+                }
+                return false;
+        }
+
+public:
+        shm_server(const shm_server&)            = delete;
+        shm_server(shm_server&&)                 = delete;
+        shm_server& operator=(const shm_server&) = delete;
+        shm_server& operator=(shm_server&&)      = delete;
+
+        static shm_server& instance() {
+                static shm_server instance;
+                return instance;
+        }
+
+        // After init_stack(), before start_event_loop(); 0 or -1 with errno set
+        int start(const char* socket_path) {
+                sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = {}};
+                if (std::strlen(socket_path) >= sizeof(addr.sun_path)) {
+                        errno = ENAMETOOLONG;
+                        return -1;
+                }
+                std::strcpy(addr.sun_path, socket_path);
+
+                listen_sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                bell        = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (listen_sock < 0 || bell < 0) return -1;
+                ::unlink(socket_path);  // Left behind by a previous daemon
+                if (::bind(listen_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+                    ::listen(listen_sock, SOMAXCONN) < 0) {
+                        return -1;
+                }
+                path = socket_path;
+
+                auto& evloop = event_loop::instance();
+                evloop.register_wakeup_fd(listen_sock, [this]() { accept_clients(); });
+                evloop.register_wakeup_fd(bell, [this]() { shm::drain(bell); });
+                evloop.register_iteration_hook([this]() { service(); });
+                evloop.register_idle_check([this]() { return keep_polling(); });
+                LOG_INIT("Shared memory transport listening on " << path);
+                return 0;
+        }
+
+        size_t session_count() const { return sessions.size(); }
+};
+}  // namespace uStack
@@ -0,0 +1,257 @@
+#pragma once
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace uStack {
+
+namespace docs {
+static const char* shm_transport_doc = R"(
+FILE: shm_transport.hpp
+PURPOSE: Shared memory layout between the stack daemon (ustackd) and out-of-process clients. Types: shm::segment_t, shm::byte_ring_t, shm::control_ring_t.
+
+- One memfd segment per client, mapped by both processes: a command ring (client to
+  daemon), a response ring (daemon to client) and MAX_SOCKETS socket slots, each with
+  an rx and a tx byte ring
+- Every ring is single-producer / single-consumer with acquire / release indices;
+  lock-free std::atomic is address-free, so it works across processes
+- Wakeups: the daemon's eventfd (shared by all clients) and one eventfd per client,
+  written only when the sleeping flag in the segment says the other side is asleep
+- The daemon moves data between the byte rings and the stack sockets in place
+  (read_span() / write_span()): payload never crosses a kernel socket
+- Handshake over a SOCK_SEQPACKET unix socket (USTACK_SOCKET, default DEFAULT_PATH):
+  the daemon sends one hello_t with the memfd, its eventfd and the client's eventfd
+  (SCM_RIGHTS); closing the unix socket detaches the client and closes its sockets
+)";
+}
+
+namespace shm {
+
+constexpr uint32_t    MAGIC           = 0x75535450;  // "uSTP"
+constexpr uint32_t    VERSION         = 1;
+constexpr int         MAX_SOCKETS     = 64;
+constexpr uint32_t    DATA_RING_SIZE  = 64 * 1024;   // Power of two
+constexpr uint32_t    CONTROL_ENTRIES = 64;          // Power of two
+constexpr const char* DEFAULT_PATH    = "/tmp/ustack.sock";
+constexpr int         HELLO_FDS       = 3;           // memfd, daemon eventfd, client eventfd
+
+static_assert((DATA_RING_SIZE & (DATA_RING_SIZE - 1)) == 0, "ring indices wrap by masking");
+static_assert((CONTROL_ENTRIES & (CONTROL_ENTRIES - 1)) == 0, "ring indices wrap by masking");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be address-free");
+
+// Bytes in flight between a client and one stack socket
+struct byte_ring_t {
+        std::atomic<uint32_t> head;  // Consumer
+        std::atomic<uint32_t> tail;  // Producer
+        uint8_t               data[DATA_RING_SIZE];
+
+        void reset() {
+                head.store(0, std::memory_order_relaxed);
+                tail.store(0, std::memory_order_relaxed);
+        }
+
+        uint32_t readable() const {
+                return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+        }
+
+        uint32_t writable() const {
+                return DATA_RING_SIZE - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+        }
+
+        // Consumer: contiguous readable bytes, then consume() what was used
+        std::pair<const uint8_t*, uint32_t> read_span() const {
+                uint32_t h   = head.load(std::memory_order_relaxed);
+                uint32_t off = h & (DATA_RING_SIZE - 1);
+                return {data + off, std::min(readable(), DATA_RING_SIZE - off)};
+        }
+
+        void consume(uint32_t len) {
+                head.store(head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+        }
+
+        // Producer: contiguous free bytes, then produce() what was filled
+        std::pair<uint8_t*, uint32_t> write_span() {
+                uint32_t t   = tail.load(std::memory_order_relaxed);
+                uint32_t off = t & (DATA_RING_SIZE - 1);
+                return {data + off, std::min(writable(), DATA_RING_SIZE - off)};
+        }
+
+        void produce(uint32_t len) {
+                tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+        }
+
+        uint32_t push(const uint8_t* src, uint32_t len) {
+                uint32_t done = 0;
+                while (done < len) {
+                        auto [dst, room] = write_span();
+                        uint32_t n       = std::min(room, len - done);
+                        if (n == 0) break;
+                        std::memcpy(dst, src + done, n);
+                        produce(n);
+                        done += n;
+                }
+                return done;
+        }
+
+        uint32_t pop(uint8_t* dst, uint32_t len) {
+                uint32_t done = 0;
+                while (done < len) {
+                        auto [src, avail] = read_span();
+                        uint32_t n        = std::min(avail, len - done);
+                        if (n == 0) break;
+                        std::memcpy(dst + done, src, n);
+                        consume(n);
+                        done += n;
+                }
+                return done;
+        }
+};
+
+template <typename T>
+struct control_ring_t {
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+        T                     entries[CONTROL_ENTRIES];
+
+        bool empty() const {
+                return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+        }
+
+        bool full() const {
+                return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) >= CONTROL_ENTRIES;
+        }
+
+        bool push(const T& entry) {
+                uint32_t t = tail.load(std::memory_order_relaxed);
+                if (t - head.load(std::memory_order_acquire) >= CONTROL_ENTRIES) return false;
+                entries[t & (CONTROL_ENTRIES - 1)] = entry;
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+        }
+
+        bool pop(T& entry) {
+                uint32_t h = head.load(std::memory_order_relaxed);
+                if (h == tail.load(std::memory_order_acquire)) return false;
+                entry = entries[h & (CONTROL_ENTRIES - 1)];
+                head.store(h + 1, std::memory_order_release);
+                return true;
+        }
+};
+
+enum command_op_t : uint32_t {
+        CMD_SOCKET,    // ipv4, port, arg: proto. res: slot
+        CMD_LISTEN,
+        CMD_ACCEPT,    // res: slot of the new connection
+        CMD_CONNECT,   // ipv4, port. res: -EINPROGRESS, then SLOT_CONNECTED or SLOT_ERROR
+        CMD_SHUTDOWN,  // arg: how
+        CMD_CLOSE,     // arg: abortive
+};
+
+struct command_t {
+        uint32_t op;
+        int32_t  slot;
+        uint32_t ipv4;
+        uint16_t port;
+        int32_t  arg;
+        uint32_t seq;
+};
+
+struct response_t {
+        uint32_t seq;
+        int32_t  res;  // >= 0 on success, -errno on failure
+};
+
+// socket_slot_t::events, set by the daemon
+enum slot_event_t : uint32_t {
+        SLOT_ACCEPTABLE = 1 << 0,
+        SLOT_CONNECTED  = 1 << 1,  // Accepted, or connect() completed
+        SLOT_EOF        = 1 << 2,
+        SLOT_ERROR      = 1 << 3,  // error holds the errno
+};
+
+struct socket_slot_t {
+        std::atomic<uint32_t> events;
+        std::atomic<int32_t>  error;
+        byte_ring_t           rx;  // Daemon to client
+        byte_ring_t           tx;  // Client to daemon
+};
+
+struct segment_t {
+        uint32_t              magic;
+        uint32_t              version;
+        std::atomic<uint32_t> daemon_sleeping;
+        std::atomic<uint32_t> client_sleeping;
+        control_ring_t<command_t>  commands;
+        control_ring_t<response_t> responses;
+        socket_slot_t              slots[MAX_SOCKETS];
+};
+
+struct hello_t {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t size;  // Of the segment
+};
+
+// Publish first; the fence orders it before the flag load (the sleeper sets the
+// flag, fences, then re-checks for work)
+inline void wake(std::atomic<uint32_t>& sleeping, int eventfd) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+                uint64_t one = 1;
+                ssize_t  ret = ::write(eventfd, &one, sizeof(one));
+                (void)ret;
+        }
+}
+
+inline void prepare_sleep(std::atomic<uint32_t>& sleeping) {
+        sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void drain(int eventfd) {
+        uint64_t value;
+        ssize_t  ret = ::read(eventfd, &value, sizeof(value));
+        (void)ret;
+}
+
+// hello_t plus fds over the unix socket; false on failure
+inline bool send_hello(int sock, const hello_t& hello, const int (&fds)[HELLO_FDS]) {
+        iovec  iov = {.iov_base = const_cast<hello_t*>(&hello), .iov_len = sizeof(hello)};
+        char   control[CMSG_SPACE(sizeof(fds))] = {};
+        msghdr msg = {};
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg      = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level   = SOL_SOCKET;
+        cmsg->cmsg_type    = SCM_RIGHTS;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        return ::sendmsg(sock, &msg, MSG_NOSIGNAL) == sizeof(hello);
+}
+
+inline bool recv_hello(int sock, hello_t& hello, int (&fds)[HELLO_FDS]) {
+        iovec  iov = {.iov_base = &hello, .iov_len = sizeof(hello)};
+        char   control[CMSG_SPACE(sizeof(fds))] = {};
+        msghdr msg = {};
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(hello)) return false;
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+                return false;
+        }
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        return hello.magic == MAGIC && hello.version == VERSION;
+}
+}  // namespace shm
+}  // namespace uStack
@@ -1,9 +1,12 @@
 #pragma once
 #include <cstdint>
+#include <deque>
 #include <optional>
 
 #include "circle_buffer.hpp"
 #include "defination.hpp"
+#include "epoll.hpp"
+#include "event_loop.hpp"
 #include "packets.hpp"
 #include "tcb.hpp"
 
@@ -12,7 +15,7 @@ namespace uStack {
 namespace docs {
 static const char* socket_doc = R"(
 FILE: socket.hpp
-PURPOSE: Socket structures - socket_t (active) and listener_t (passive).
+PURPOSE: Socket structures - socket_t (active) and listener_t (passive), recv_view_t (zero-copy read), zerocopy_token_t (zero-copy send).
 )";
 }
 
@@ -25,6 +28,21 @@ struct backlog_stats_t {
         uint32_t total_rejected = 0;// Total connections rejected due to backlog full
 };
 
+// Read-only view of received payload lent by read_zerocopy(); valid until it is passed
+// to release_zerocopy() or the socket is closed
+struct recv_view_t {
+        const uint8_t* data;
+        int            len;
+        uint64_t       id;
+};
+
+// Received segment buffer held by the application
+struct lent_buffer_t {
+        uint64_t                     id;
+        uint32_t                     truesize;  // Receive memory charged, released with the view
+        std::unique_ptr<base_packet> buffer;  // nullptr once released out of order
+};
+
 struct socket_t {
         int                                   fd;
         int                                   state = SOCKET_UNCONNECTED;
@@ -33,6 +51,25 @@ struct socket_t {
         std::optional<ipv4_port_t>            remote_info;
         std::optional<std::shared_ptr<tcb_t>> tcb;
         bool                                  readable = false;  // Data in receive_queue
+        int                                   error    = 0;      // Pending error (SO_ERROR), e.g. failed connect
+        liveness_config_t                     liveness;          // Keepalive / user timeout, copied to the TCB on connect
+        epoll_item_t                          epoll;             // Interest / ready list link, see epoll.hpp
+        std::deque<lent_buffer_t>             lent;              // Lent by read_zerocopy(), oldest first
+        uint64_t                              next_lend_id = 1;
+        uint32_t                              next_zerocopy_id = 0;  // write_zerocopy() completion ids
+};
+
+// Pin of a write_zerocopy() buffer, shared by the send queue entry and the retransmission
+// entries cut from it; the last one to go posts the completion
+struct zerocopy_token_t {
+        std::weak_ptr<socket_t> socket;
+        int                     fd;
+        uint32_t                id;
+
+        zerocopy_token_t(std::weak_ptr<socket_t> socket, int fd, uint32_t id) : socket(std::move(socket)), fd(fd), id(id) {}
+        ~zerocopy_token_t() {
+                if (!socket.expired()) event_loop::instance().post_zerocopy_completion(fd, id);
+        }
 };
 
 struct listener_t {
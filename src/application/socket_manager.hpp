@@ -1,6 +1,18 @@
+#pragma once
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
 #include <unordered_map>
 
 #include "defination.hpp"
+#include "epoll.hpp"
+#include "file_mapping.hpp"
 #include "socket.hpp"
 #include "tcb_manager.hpp"
 #include "event_loop.hpp"
@@ -10,7 +22,30 @@ namespace uStack {
 namespace docs {
 static const char* socket_manager_doc = R"(
 FILE: socket_manager.hpp
-PURPOSE: Socket API manager. Methods: register_socket(), listen(), accept(), read(), write().
+PURPOSE: Socket API manager. Methods: register_socket(), listen(), accept(), connect(), read(), readv(), read_zerocopy(), release_zerocopy(), write(), writev(), write_zerocopy(), sendfile(), shutdown(), close(), get_socket_error(), set_keepalive(), set_user_timeout(), set_send_buffer(),
+         epoll_create(), epoll_ctl(), epoll_wait().
+
+- Accepted sockets and their TCB point at each other (socket_t::tcb, tcb_t::socket_fd),
+  so per-connection notifications are O(1)
+- A reaped TCB that was reset is detached from its socket; read() then fails
+  with ECONNRESET and write() with EPIPE until the application closes the fd.
+  After a graceful close (LAST-ACK) it stays: read() drains the data, then returns 0
+- read() returns 0 with len 0 at end of stream (peer FIN or SHUT_RD)
+- read() copies queued payload straight out of the received frames; read_zerocopy()
+  lends those frames out instead, and they keep counting against the receive
+  window until release_zerocopy() hands them back to the packet pool. Segments
+  are charged their buffer memory (truesize), not just their payload
+- close() frees the fd slot and its callbacks immediately; the TCB is handed to
+  tcb_manager::close() and finishes the FIN exchange without a socket
+- write_zerocopy() queues a view of the caller's buffer; the event loop posts its
+  completion id once no segment refers to it (zerocopy_token_t)
+- sendfile() queues views of an mmapped file range; the mapping is shared by the
+  send queue and retransmission entries and released once the data is ACKed
+- write() is bounded by the TCB's send buffer (unsent + unacknowledged bytes): partial
+  writes / EAGAIN when full, write callback and EPOLLOUT at the low watermark
+- Every readiness change (data, accept, connect, FIN, reset) is pushed to the socket's
+  epoll instance, if any; epoll fds share the socket fd space and are readable
+  through event_loop while their ready list is non-empty
 )";
 }
 
@@ -21,6 +56,44 @@ private:
         std::unordered_map<uint16_t, std::shared_ptr<socket_t>>   sockets;
         std::unordered_map<uint16_t, std::shared_ptr<listener_t>> listeners;
 
+        std::unordered_map<int, std::unique_ptr<epoll_t>>        epolls;
+
+        bool fd_in_use(int fd) const { return sockets.count(fd) != 0 || epolls.count(fd) != 0; }
+
+        void notify(const std::shared_ptr<socket_t>& socket, uint32_t events) {
+                if (socket->epoll.owner) {
+                        socket->epoll.owner->notify(socket->epoll, events);
+                }
+        }
+
+        // Current readiness of a socket (level-triggered epoll, EPOLL_CTL_ADD/MOD)
+        uint32_t poll_events(const std::shared_ptr<socket_t>& socket) const {
+                auto listener = listeners.find(socket->fd);
+                if (listener != listeners.end()) {
+                        return listener->second->acceptors->empty() ? 0 : EPOLLIN;
+                }
+                uint32_t mask = socket->error ? EPOLLERR : 0;
+                if (!socket->tcb) {
+                        // Reset or closed after being connected
+                        if (socket->remote_info) mask |= EPOLLIN | EPOLLRDHUP | EPOLLHUP;
+                        return mask;
+                }
+                const std::shared_ptr<tcb_t>& tcb = socket->tcb.value();
+                if (!tcb->receive_queue.empty() || tcb->fin_received || tcb->read_shutdown) mask |= EPOLLIN;
+                if (tcb->fin_received) mask |= EPOLLRDHUP;
+                if (tcb->state == TCP_CLOSED) mask |= EPOLLHUP;
+                if (socket->state == SOCKET_CONNECTED && !tcb->fin_pending && tcb->send_writable()) {
+                        mask |= EPOLLOUT;
+                }
+                return mask;
+        }
+
+        void apply_liveness(std::shared_ptr<socket_t> socket) {
+                if (socket->tcb) {
+                        tcb_manager::instance().set_liveness(socket->tcb.value(), socket->liveness);
+                }
+        }
+
 public:
         socket_manager(const socket_manager&) = delete;
         socket_manager(socket_manager&&)      = delete;
@@ -34,13 +107,15 @@ public:
 
         int register_socket(int proto, ipv4_addr_t ipv4_addr, port_addr_t port_addr) {
                 for (int i = 1; i < 65535; i++) {
-                        if (sockets.find(i) == sockets.end()) {
+                        if (!fd_in_use(i)) {
                                 ipv4_port_t local_info = {.ipv4_addr = ipv4_addr,
                                                           .port_addr = port_addr};
 
                                 std::shared_ptr<socket_t> socket = std::make_shared<socket_t>();
                                 socket->proto                    = proto;
                                 socket->local_info               = local_info;
+                                socket->fd                       = i;
+                                socket->liveness                 = tcb_manager::instance().get_default_liveness();
                                 sockets[i]                       = socket;
                                 return i;
                         }
@@ -50,6 +125,7 @@ public:
 
         int listen(int fd) {
                 if (sockets.find(fd) == sockets.end()) {
+                        errno = EBADF;
                         return -1;
                 }
                 std::shared_ptr<listener_t> listener = std::make_shared<listener_t>();
@@ -60,6 +136,7 @@ public:
                 listeners[fd]                        = listener;
                 auto& tcb_manager                    = tcb_manager::instance();
                 tcb_manager.listen_port(listener->local_info.value(), listener);
+                return 0;
         };
 
         int accept(int fd) {
@@ -78,7 +155,7 @@ public:
 
                 // Connection available - create socket
                 for (int i = 1; i < 65535; i++) {
-                        if (sockets.find(i) == sockets.end()) {
+                        if (!fd_in_use(i)) {
                                 auto tcb = listener->acceptors->pop_front();
                                 auto socket = std::make_shared<socket_t>();
                                 socket->local_info               = tcb.value()->local_info;
@@ -87,7 +164,9 @@ public:
                                 socket->state                    = SOCKET_CONNECTED;
                                 socket->tcb                      = tcb;
                                 socket->fd                       = i;
+                                socket->liveness                 = tcb.value()->liveness;
                                 sockets[i]                       = socket;
+                                tcb.value()->socket_fd           = i;
 
                                 // NEW: Track backlog dequeue when connection is accepted
                                 auto& mgr = tcb_manager::instance();
@@ -105,60 +184,607 @@ public:
                 return -1;
         }
 
-        int read(int fd, char* buf, int& len) {
+        // Non-blocking active open: returns -1 with errno EINPROGRESS once the SYN is queued.
+        // The result arrives through event_loop's connect callback (and get_socket_error()).
+        int connect(int fd, ipv4_port_t remote_info) {
                 if (sockets.find(fd) == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                auto socket = sockets[fd];
+                if (socket->tcb || listeners.find(fd) != listeners.end()) {
+                        errno = socket->state == SOCKET_CONNECTING ? EALREADY : EISCONN;
+                        return -1;
+                }
+
+                auto tcb = tcb_manager::instance().connect(socket->local_info.value(), remote_info, fd);
+                if (!tcb) {
+                        return -1;
+                }
+                tcb_manager::instance().set_liveness(tcb.value(), socket->liveness);
+                socket->tcb         = tcb;
+                socket->local_info  = tcb.value()->local_info;
+                socket->remote_info = remote_info;
+                socket->state       = SOCKET_CONNECTING;
+                socket->error       = 0;
+                errno               = EINPROGRESS;
+                return -1;
+        }
+
+        // SO_ERROR: return and clear the pending error
+        int get_socket_error(int fd) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        return EBADF;
+                }
+                int error         = it->second->error;
+                it->second->error = 0;
+                return error;
+        }
+
+        // SO_KEEPALIVE with TCP_KEEPIDLE / TCP_KEEPINTVL / TCP_KEEPCNT; 0 keeps the current value
+        int set_keepalive(int fd, bool enable, uint32_t idle_s, uint32_t interval_s, uint32_t count) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                liveness_config_t& config = it->second->liveness;
+                config.keepalive          = enable;
+                if (idle_s) config.keepalive_idle_ms = idle_s * 1000;
+                if (interval_s) config.keepalive_intvl_ms = interval_s * 1000;
+                if (count) config.keepalive_count = std::min<uint32_t>(count, UINT8_MAX);
+                apply_liveness(it->second);
+                return 0;
+        }
+
+        // TCP_USER_TIMEOUT (RFC 5482): abort when sent data stays unacknowledged this long, 0 = off
+        int set_user_timeout(int fd, uint32_t timeout_ms) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                it->second->liveness.user_timeout_ms = timeout_ms;
+                apply_liveness(it->second);
+                return 0;
+        }
+
+        int read(int fd, char* buf, int& len) {
+                iovec iov = {.iov_base = buf, .iov_len = static_cast<size_t>(std::max(len, 0))};
+                return readv(fd, &iov, 1, len);
+        }
+
+        // Scatter read: fills the iovecs in order straight from the queued segments; len is
+        // set to the bytes copied. Same EAGAIN / end of stream / error behaviour as read().
+        int readv(int fd, const iovec* iov, int iovcnt, int& len) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
                         len = 0;
                         errno = EBADF;
                         return -1;
                 }
+                if (iovcnt < 0 || iovcnt > IOV_MAX) {
+                        len   = 0;
+                        errno = EINVAL;
+                        return -1;
+                }
 
-                auto socket = sockets[fd];
+                auto socket = it->second;
+                if (!socket->tcb) {
+                        len   = 0;
+                        errno = socket->error ? socket->error : ECONNRESET;
+                        return -1;
+                }
 
-                // Non-blocking: return EAGAIN if no data
+                // Non-blocking: return EAGAIN if no data, 0 at end of stream
                 if (socket->tcb.value()->receive_queue.empty()) {
                         len = 0;
+                        if (socket->tcb.value()->fin_received || socket->tcb.value()->read_shutdown) {
+                                socket->readable = false;
+                                return 0;
+                        }
                         errno = EAGAIN;
                         return -1;
                 }
 
-                // Data available
-                raw_packet r_packet = std::move(socket->tcb.value()->receive_queue.pop_front().value());
-                r_packet.buffer->export_data(reinterpret_cast<uint8_t*>(buf), len);
+                // Data available: copy across queued segments, a partly read one stays queued
+                std::shared_ptr<tcb_t> tcb      = socket->tcb.value();
+                size_t                 copied   = 0;
+                uint32_t               released = 0;  // truesize of the segments fully read
+                for (int i = 0; i < iovcnt && !tcb->receive_queue.empty(); i++) {
+                        uint8_t* dest = static_cast<uint8_t*>(iov[i].iov_base);
+                        size_t   done = 0;
+                        while (done < iov[i].iov_len && !tcb->receive_queue.empty()) {
+                                base_packet& front = *tcb->receive_queue.front().buffer;
+                                size_t chunk = std::min<size_t>(front.get_remaining_len(), iov[i].iov_len - done);
+                                std::memcpy(dest + done, front.get_pointer(), chunk);
+                                front.add_offset(chunk);
+                                done += chunk;
+                                if (front.get_remaining_len() == 0) {
+                                        released += front.truesize();
+                                        tcb->receive_queue.pop_front();
+                                }
+                        }
+                        copied += done;
+                }
+                len = copied;
+                tcb->receive_release(released);
 
                 // Clear readable if queue now empty
-                if (socket->tcb.value()->receive_queue.empty()) {
+                if (tcb->receive_queue.empty()) {
                         socket->readable = false;
                 }
 
                 return 0;
         }
 
+        // Zero-copy read: lend up to count queued segments as views into the received
+        // frames; count is set to the views filled. Same EAGAIN / end of stream (count 0,
+        // returns 0) / error behaviour as read().
+        int read_zerocopy(int fd, recv_view_t* views, int& count) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        count = 0;
+                        errno = EBADF;
+                        return -1;
+                }
+
+                std::shared_ptr<socket_t> socket = it->second;
+                if (!socket->tcb) {
+                        count = 0;
+                        errno = socket->error ? socket->error : ECONNRESET;
+                        return -1;
+                }
+
+                std::shared_ptr<tcb_t> tcb = socket->tcb.value();
+                if (tcb->receive_queue.empty()) {
+                        count = 0;
+                        if (tcb->fin_received || tcb->read_shutdown) {
+                                socket->readable = false;
+                                return 0;
+                        }
+                        errno = EAGAIN;
+                        return -1;
+                }
+
+                int filled = 0;
+                while (filled < count && !tcb->receive_queue.empty()) {
+                        std::unique_ptr<base_packet> buffer = std::move(tcb->receive_queue.pop_front()->buffer);
+                        recv_view_t&                 view   = views[filled++];
+                        view.data = buffer->get_pointer();
+                        view.len  = buffer->get_remaining_len();
+                        view.id   = socket->next_lend_id++;
+                        socket->lent.push_back({.id = view.id, .truesize = uint32_t(buffer->truesize()), .buffer = std::move(buffer)});
+                }
+                count = filled;
+
+                if (tcb->receive_queue.empty()) {
+                        socket->readable = false;
+                }
+                return 0;
+        }
+
+        // Return lent views: their buffers go back to the packet pool and the receive window
+        // reopens. Views may be released in any order; EINVAL for one not lent by this socket
+        // (the views before it are released).
+        int release_zerocopy(int fd, const recv_view_t* views, int count) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+
+                std::shared_ptr<socket_t>  socket   = it->second;
+                std::deque<lent_buffer_t>& lent     = socket->lent;
+                uint32_t                   released = 0;
+                int                        result   = 0;
+                uint64_t                   first    = lent.empty() ? 0 : lent.front().id;
+                for (int i = 0; i < count; i++) {
+                        // Ids are handed out in order and entries leave only from the front,
+                        // so the id gives the entry's position
+                        uint64_t id = views[i].id;
+                        if (lent.empty() || id < first || id - first >= lent.size() || !lent[id - first].buffer) {
+                                errno  = EINVAL;
+                                result = -1;
+                                break;
+                        }
+                        released += lent[id - first].truesize;
+                        lent[id - first].buffer.reset();
+                }
+                while (!lent.empty() && !lent.front().buffer) {
+                        lent.pop_front();
+                }
+
+                if (socket->tcb && released > 0) {
+                        socket->tcb.value()->receive_release(released);
+                }
+                return result;
+        }
+
+        // Shared by the write paths: the TCB to queue len bytes on, with len cut to the free
+        // send buffer space; nullptr with errno EPIPE (no connection, or after SHUT_WR) or
+        // EAGAIN (buffer full, len 0). A cut-short write asks for a write callback.
+        std::shared_ptr<tcb_t> reserve_send_space(const std::shared_ptr<socket_t>& socket, int& len) {
+                if (!socket->tcb || socket->tcb.value()->fin_pending) {
+                        errno = EPIPE;
+                        return nullptr;
+                }
+                std::shared_ptr<tcb_t> tcb   = socket->tcb.value();
+                uint32_t               space = tcb->send_space();
+                if (len > 0 && space == 0) {
+                        tcb->write_blocked = true;
+                        len                = 0;
+                        errno              = EAGAIN;
+                        return nullptr;
+                }
+                if (static_cast<uint32_t>(len) > space) {
+                        tcb->write_blocked = true;
+                        len                = space;
+                }
+                return tcb;
+        }
+
+        // Non-blocking: len is set to the bytes accepted, which may be fewer than asked when
+        // the send buffer fills; EAGAIN if it is full. The write callback (or EPOLLOUT)
+        // fires once ACKs drain it to the low watermark.
         int write(int fd, char* buf, int& len) {
-                if (sockets.find(fd) == sockets.end()) {
+                iovec iov = {.iov_base = buf, .iov_len = static_cast<size_t>(std::max(len, 0))};
+                return writev(fd, &iov, 1, len);
+        }
+
+        // Gather write: the iovecs are copied in order into one send buffer entry, so a
+        // header and body leave in the same MSS-sized segments (tcb_t::make_packet() cuts
+        // segments across entries). len is set to the bytes accepted, as for write().
+        int writev(int fd, const iovec* iov, int iovcnt, int& len) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
                         return -1;
                 }
-                std::shared_ptr<socket_t>    socket = sockets[fd];
-                std::unique_ptr<base_packet> out_buffer =
-                        std::make_unique<base_packet>(reinterpret_cast<uint8_t*>(buf), len);
+                if (iovcnt < 0 || iovcnt > IOV_MAX) {
+                        len   = 0;
+                        errno = EINVAL;
+                        return -1;
+                }
+                std::shared_ptr<socket_t> socket = it->second;
+                size_t                    total  = 0;
+                for (int i = 0; i < iovcnt; i++) {
+                        total += iov[i].iov_len;
+                }
+                if (total > INT_MAX) {
+                        len   = 0;
+                        errno = EINVAL;
+                        return -1;
+                }
+                len = total;
+                std::shared_ptr<tcb_t> tcb = reserve_send_space(socket, len);
+                if (!tcb) {
+                        return -1;
+                }
+                if (len == 0) {
+                        return 0;
+                }
+                std::unique_ptr<base_packet> out_buffer = std::make_unique<base_packet>(len);
+                uint8_t*                     dest       = out_buffer->get_pointer();
+                size_t                       copied     = 0;
+                for (int i = 0; i < iovcnt && copied < static_cast<size_t>(len); i++) {
+                        size_t chunk = std::min<size_t>(iov[i].iov_len, len - copied);
+                        std::memcpy(dest + copied, iov[i].iov_base, chunk);
+                        copied += chunk;
+                }
                 raw_packet r_packet = {.buffer = std::move(out_buffer)};
-                socket->tcb.value()->send_queue.push_back(std::move(r_packet));
+                // Segmented into MSS-sized packets by tcb_t::make_packet()
+                tcb->enqueue_send(std::move(r_packet));
+                return 0;
+        }
+
+        // Zero-copy file send: [offset, offset + len) of file_fd is mmapped and queued as a
+        // view, not copied into the send buffer. Segments are cut from the mapping and their
+        // retransmission entries reference it, so the pages stay mapped until ACKed. len is
+        // set to the bytes queued (bounded by the send buffer and end of file, 0 at EOF) and
+        // offset advanced past them; EAGAIN when the send buffer is full.
+        int sendfile(int fd, int file_fd, off_t& offset, int& len) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (len < 0 || offset < 0) {
+                        errno = EINVAL;
+                        return -1;
+                }
+                std::shared_ptr<socket_t> socket = it->second;
+                // Mapped pages past the end of the file would fault on access
+                struct stat file_stat;
+                if (::fstat(file_fd, &file_stat) < 0) {
+                        return -1;
+                }
+                if (offset >= file_stat.st_size) {
+                        len = 0;
+                        return 0;
+                }
+                len = std::min<off_t>(len, file_stat.st_size - offset);
+
+                std::shared_ptr<tcb_t> tcb = reserve_send_space(socket, len);
+                if (!tcb) {
+                        return -1;
+                }
+                if (len == 0) {
+                        return 0;
+                }
+
+                std::shared_ptr<file_mapping> mapping = file_mapping::map(file_fd, offset, len);
+                if (!mapping) {
+                        len = 0;
+                        return -1;
+                }
+                raw_packet r_packet = {.buffer = std::make_unique<base_packet>(mapping, mapping->data(), len)};
+                tcb->enqueue_send(std::move(r_packet));
+                offset += len;
+                return 0;
+        }
+
+        // Zero-copy send (MSG_ZEROCOPY): buf is borrowed, not copied; segments are cut from it
+        // and retransmitted from it. len is cut to the send buffer space as for write(); id is
+        // set to this call's completion id (per socket, counting up from 0). The event loop
+        // posts id to the zero-copy callback once no queued or unacknowledged segment refers
+        // to buf any more - every byte ACKed, or the connection reset - and only then may
+        // the application reuse it. close() copies what is still borrowed, so every buffer
+        // is free once close() returns; no completion follows close().
+        int write_zerocopy(int fd, const char* buf, int& len, uint32_t& id) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (len < 0) {
+                        errno = EINVAL;
+                        return -1;
+                }
+                std::shared_ptr<socket_t> socket = it->second;
+                std::shared_ptr<tcb_t>    tcb    = reserve_send_space(socket, len);
+                if (!tcb) {
+                        return -1;
+                }
+                if (len == 0) {
+                        return 0;
+                }
+
+                id       = socket->next_zerocopy_id++;
+                auto pin = std::make_shared<zerocopy_token_t>(socket, fd, id);
+                raw_packet r_packet = {.buffer = std::make_unique<base_packet>(
+                                               std::move(pin), reinterpret_cast<const uint8_t*>(buf), len)};
+                tcb->enqueue_send(std::move(r_packet));
+                return 0;
+        }
+
+        // SO_SNDBUF / SO_SNDLOWAT for a connected socket (low watermark 0: half the buffer)
+        int set_send_buffer(int fd, uint32_t limit, uint32_t low_watermark) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (!it->second->tcb) {
+                        errno = ENOTCONN;
+                        return -1;
+                }
+                std::shared_ptr<tcb_t> tcb = it->second->tcb.value();
+                tcb->send_buffer_limit     = limit;
+                tcb->send_low_watermark    = low_watermark ? std::min(low_watermark, limit) : limit / 2;
+                return 0;
+        }
+
+        // SHUT_RD drops unread and future data, SHUT_WR sends FIN after the queued data
+        int shutdown(int fd, int how) {
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (how != SHUT_RD && how != SHUT_WR && how != SHUT_RDWR) {
+                        errno = EINVAL;
+                        return -1;
+                }
+                auto socket = it->second;
+                if (!socket->tcb || socket->state != SOCKET_CONNECTED) {
+                        errno = ENOTCONN;
+                        return -1;
+                }
+                std::shared_ptr<tcb_t> tcb = socket->tcb.value();
+                if (how != SHUT_WR) {
+                        tcb->read_shutdown = true;
+                        uint32_t released  = 0;  // Give the dropped segments' truesize back to the window
+                        while (!tcb->receive_queue.empty()) {
+                                released += tcb->receive_queue.front().buffer->truesize();
+                                tcb->receive_queue.pop_front();
+                        }
+                        tcb->receive_release(released);
+                }
+                if (how != SHUT_RD) {
+                        tcb_manager::instance().shutdown_send(tcb);
+                }
+                return 0;
+        }
+
+        // Release the fd now. Graceful: FIN after the queued data. Abortive (SO_LINGER
+        // with a zero timeout): RST and the send queue is discarded.
+        int close(int fd, bool abortive = false) {
+                if (epolls.erase(fd)) {
+                        event_loop::instance().unregister_callbacks(fd);
+                        return 0;
+                }
+                auto it = sockets.find(fd);
+                if (it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (it->second->epoll.owner) {
+                        it->second->epoll.owner->remove(it->second->epoll);
+                }
+                auto listener = listeners.find(fd);
+                if (listener != listeners.end()) {
+                        tcb_manager::instance().unlisten(listener->second->local_info.value());
+                        listeners.erase(listener);
+                }
+                std::shared_ptr<tcb_t> tcb = it->second->tcb.value_or(nullptr);
+                if (tcb) {
+                        tcb_manager::instance().close(tcb, abortive);
+                }
+                sockets.erase(it);
+                event_loop::instance().unregister_callbacks(fd);
+                // Borrowed zero-copy data is copied now; with the socket gone the dropped
+                // tokens post no completion for an fd that may be reused
+                if (tcb) {
+                        tcb->own_pinned_payloads();
+                }
+                return 0;
+        }
+
+        int epoll_create() {
+                for (int i = 1; i < 65535; i++) {
+                        if (!fd_in_use(i)) {
+                                epolls[i] = std::make_unique<epoll_t>(
+                                        [i]() { event_loop::instance().mark_readable(i); });
+                                return i;
+                        }
+                }
+                errno = EMFILE;
+                return -1;
+        }
+
+        // EPOLL_CTL_ADD / EPOLL_CTL_MOD / EPOLL_CTL_DEL
+        int epoll_ctl(int epfd, int op, int fd, epoll_event* event) {
+                auto ep = epolls.find(epfd);
+                auto it = sockets.find(fd);
+                if (ep == epolls.end() || it == sockets.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if ((op == EPOLL_CTL_ADD || op == EPOLL_CTL_MOD) && !event) {
+                        errno = EFAULT;
+                        return -1;
+                }
+                std::shared_ptr<socket_t>& socket = it->second;
+                switch (op) {
+                        case EPOLL_CTL_ADD:
+                                return ep->second->add(socket->epoll, fd, *event, poll_events(socket));
+                        case EPOLL_CTL_MOD:
+                                return ep->second->modify(socket->epoll, *event, poll_events(socket));
+                        case EPOLL_CTL_DEL:
+                                return ep->second->remove(socket->epoll);
+                }
+                errno = EINVAL;
+                return -1;
+        }
+
+        // Non-blocking: returns the number of ready sockets written to events (0 if none)
+        int epoll_wait(int epfd, epoll_event* events, int max_events) {
+                auto ep = epolls.find(epfd);
+                if (ep == epolls.end()) {
+                        errno = EBADF;
+                        return -1;
+                }
+                if (max_events <= 0) {
+                        errno = EINVAL;
+                        return -1;
+                }
+                return ep->second->wait(events, max_events, [this](epoll_item_t& item) {
+                        auto it = sockets.find(item.fd);
+                        return it == sockets.end() ? 0u : poll_events(it->second);
+                });
         }
 
         // Called from tcp_transmit when data arrives
         void mark_socket_readable(std::shared_ptr<tcb_t> tcb) {
-                for (auto& [fd, socket] : sockets) {
-                        if (socket->tcb && socket->tcb.value() == tcb) {
-                                socket->readable = true;
-                                event_loop::instance().mark_readable(fd);
-                                return;
+                auto it = sockets.find(tcb->socket_fd);
+                if (it != sockets.end() && it->second->tcb && it->second->tcb.value() == tcb) {
+                        it->second->readable = true;
+                        event_loop::instance().mark_readable(it->first);
+                        notify(it->second, EPOLLIN | (tcb->fin_received ? EPOLLRDHUP : 0));
+                }
+        }
+
+        // Called from tcb_manager when a blocked writer's send buffer drained
+        void mark_socket_writable(std::shared_ptr<tcb_t> tcb) {
+                auto it = sockets.find(tcb->socket_fd);
+                if (it != sockets.end() && it->second->tcb && it->second->tcb.value() == tcb) {
+                        event_loop::instance().mark_writable(it->first);
+                        notify(it->second, EPOLLOUT);
+                }
+        }
+
+        // Called from tcb_manager when an active open completes or fails
+        void on_connect_complete(std::shared_ptr<tcb_t> tcb) {
+                auto it = sockets.find(tcb->socket_fd);
+                if (it == sockets.end() || !it->second->tcb || it->second->tcb.value() != tcb) {
+                        return;
+                }
+                auto socket = it->second;
+                if (tcb->state == TCP_ESTABLISHED) {
+                        socket->state = SOCKET_CONNECTED;
+                } else {
+                        socket->error = tcb->error ? tcb->error : ECONNREFUSED;
+                        socket->state = SOCKET_UNCONNECTED;
+                        socket->tcb.reset();
+                        socket->remote_info.reset();
+                        if (tcb->ephemeral_port) {
+                                socket->local_info->port_addr = 0;  // Pick a fresh port on retry
                         }
+                        tcb->socket_fd = -1;
                 }
+                event_loop::instance().mark_connected(it->first, socket->error);
+                notify(socket, socket->error ? EPOLLOUT | EPOLLERR | EPOLLHUP : EPOLLOUT);
+        }
+
+        // Called from tcb_manager when a closed TCB is reaped: detach a reset one from its
+        // socket and wake the reader so it sees the reset (or the rest of a graceful close)
+        void on_tcb_closed(std::shared_ptr<tcb_t> tcb) {
+                auto it = sockets.find(tcb->socket_fd);
+                if (it == sockets.end() || !it->second->tcb || it->second->tcb.value() != tcb) {
+                        return;
+                }
+                if (tcb->closed_gracefully()) {
+                        // Unread data, then end of stream (fin_received): the TCB stays attached
+                        it->second->readable = true;
+                        event_loop::instance().mark_readable(it->first);
+                        notify(it->second, EPOLLIN | EPOLLRDHUP | EPOLLHUP);
+                        return;
+                }
+                it->second->tcb.reset();
+                it->second->state    = SOCKET_UNCONNECTED;
+                it->second->readable = true;
+                it->second->error    = tcb->error;  // ETIMEDOUT for dead peers, 0 for a plain reset
+                tcb->socket_fd       = -1;
+                event_loop::instance().mark_readable(it->first);
+                notify(it->second, EPOLLIN | EPOLLRDHUP | EPOLLHUP | (tcb->error ? EPOLLERR : 0));
         }
 
         // Called from tcb when connection completes
         void mark_listener_acceptable(std::shared_ptr<listener_t> listener) {
                 listener->acceptable = true;
                 event_loop::instance().mark_acceptable(listener->fd);
+                auto it = sockets.find(listener->fd);
+                if (it != sockets.end()) {
+                        notify(it->second, EPOLLIN);
+                }
         }
 };
-};  // namespace uStack
\ No newline at end of file
+
+inline void socket_events::listener_acceptable(std::shared_ptr<listener_t> listener) {
+        socket_manager::instance().mark_listener_acceptable(std::move(listener));
+}
+inline void socket_events::socket_readable(std::shared_ptr<tcb_t> tcb) {
+        socket_manager::instance().mark_socket_readable(std::move(tcb));
+}
+inline void socket_events::socket_writable(std::shared_ptr<tcb_t> tcb) {
+        socket_manager::instance().mark_socket_writable(std::move(tcb));
+}
+inline void socket_events::connect_complete(std::shared_ptr<tcb_t> tcb) {
+        socket_manager::instance().on_connect_complete(std::move(tcb));
+}
+inline void socket_events::tcb_closed(std::shared_ptr<tcb_t> tcb) {
+        socket_manager::instance().on_tcb_closed(std::move(tcb));
+}
+};  // namespace uStack
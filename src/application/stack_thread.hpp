@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "api.hpp"
+#include "io_ring.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* stack_thread_doc = R"(
+FILE: stack_thread.hpp
+PURPOSE: Runs the stack on its own (optionally pinned) thread; application threads talk to it through io_ring_t. Methods: start(), stop(), call(), attach(), detach(), local_ring().
+
+SINGLETON PATTERN:
+stack_thread& stack = stack_thread::instance();
+
+- start() runs init_stack() and the event loop on a new thread, pinned to the given
+  CPU (or STACK_CPU); callbacks registered with the event loop run on that thread
+- Application threads must not call the socket API directly: each one gets its own
+  ring (local_ring()), whose submissions the stack consumes every iteration
+- Wakeups: submit() rings the stack's eventfd doorbell, the stack rings the ring's
+  doorbell after posting completions; either write() is skipped unless the other
+  side sleeps
+- Before sleeping the stack keeps polling for an adaptive number of idle iterations
+  (doubled when submissions arrive while polling, halved when it goes to sleep)
+- call() runs setup that has no ring opcode (socket(), listen(), options) on the
+  stack thread and waits for it
+- attach() / detach() / call() hand over under a mutex; the data path is lock-free
+
+  stack_thread::instance().start(argc, argv);
+  int listen_fd = -1;
+  stack_thread::instance().call([&]() { listen_fd = socket(0x06, addr, port); listen(listen_fd); });
+  io_ring_t& ring = stack_thread::instance().local_ring();
+  ring_sqe_t* sqe = ring.get_sqe();
+  *sqe = {.opcode = RING_OP_ACCEPT, .fd = listen_fd, .user_data = 1};
+  ring.submit();
+  ring_cqe_t* cqe = ring.wait_cqe();
+)";
+}
+
+class stack_thread {
+public:
+        static constexpr uint32_t DEFAULT_RING_ENTRIES = 256;
+        static constexpr uint32_t IDLE_SPIN_MIN        = 8;     // Event loop iterations
+        static constexpr uint32_t IDLE_SPIN_MAX        = 4096;
+
+private:
+        struct detach_request_t {
+                io_ring_t*         ring;
+                std::promise<void> done;
+        };
+
+        struct call_request_t {
+                std::function<void()> fn;
+                std::promise<void>    done;
+        };
+
+        // Detaches the thread's ring when the thread exits
+        struct local_ring_t {
+                std::unique_ptr<io_ring_t> ring;
+                ~local_ring_t() {
+                        if (ring) stack_thread::instance().detach(*ring);
+                }
+        };
+
+        std::thread       thread;
+        std::thread::id   thread_id;
+        doorbell_t        bell;
+        std::atomic<bool> running{false};
+        std::atomic<bool> stopping{false};
+
+        // Stack thread only
+        std::vector<io_ring_t*> rings;
+        uint32_t                idle_iterations = 0;
+        uint32_t                idle_spin       = IDLE_SPIN_MIN;
+
+        // Handover from application threads
+        std::mutex                    mutex;
+        std::vector<io_ring_t*>       attaching;
+        std::vector<detach_request_t> detaching;
+        std::vector<call_request_t>   calls;
+        std::atomic<bool>             has_changes{false};
+
+        stack_thread()  = default;
+        ~stack_thread() = default;
+
+        void apply_changes() {
+                std::lock_guard<std::mutex> lock(mutex);
+                has_changes.store(false, std::memory_order_relaxed);
+                rings.insert(rings.end(), attaching.begin(), attaching.end());
+                attaching.clear();
+                for (auto& request : detaching) {
+                        rings.erase(std::remove(rings.begin(), rings.end(), request.ring), rings.end());
+                        request.ring->shutdown();
+                        request.done.set_value();
+                }
+                detaching.clear();
+                for (auto& request : calls) {
+                        request.fn();
+                        request.done.set_value();
+                }
+                calls.clear();
+        }
+
+        // Iteration hook: consume every ring's submissions
+        void poll_rings() {
+                bell.cancel_sleep();
+                if (has_changes.load(std::memory_order_acquire)) apply_changes();
+                uint32_t submitted = 0;
+                for (auto* ring : rings) submitted += ring->process();
+                if (submitted > 0) {
+                        if (idle_iterations > 0) idle_spin = std::min(idle_spin * 2, IDLE_SPIN_MAX);
+                        idle_iterations = 0;
+                }
+                if (stopping.load(std::memory_order_relaxed)) event_loop::instance().stop();
+        }
+
+        bool work_pending() const {
+                if (stopping.load(std::memory_order_relaxed) || has_changes.load(std::memory_order_relaxed)) {
+                        return true;
+                }
+                for (auto* ring : rings) {
+                        if (ring->has_work()) return true;
+                }
+                return false;
+        }
+
+        // Idle check: keep polling for idle_spin iterations, then arm the doorbell
+        bool keep_polling() {
+                if (work_pending()) return true;
+                if (idle_iterations < idle_spin) {
+                        idle_iterations++;
+                        return true;
+                }
+                idle_iterations = 0;
+                idle_spin       = std::max(idle_spin / 2, IDLE_SPIN_MIN);
+                bell.prepare_sleep();
+                return work_pending();  // Published before the flag was seen
+        }
+
+public:
+        stack_thread(const stack_thread&)            = delete;
+        stack_thread(stack_thread&&)                 = delete;
+        stack_thread& operator=(const stack_thread&) = delete;
+        stack_thread& operator=(stack_thread&&)      = delete;
+
+        static stack_thread& instance() {
+                static stack_thread instance;
+                return instance;
+        }
+
+        // Returns once the stack is initialized; cpu < 0 reads STACK_CPU (unset: not pinned)
+        void start(int argc, char* argv[], int cpu = -1) {
+                std::promise<void> ready;
+                std::future<void>  initialized = ready.get_future();
+                stopping.store(false);
+                thread = std::thread([this, argc, argv, cpu, &ready]() {
+                        init_stack(argc, argv);
+
+                        // The event loop pins this thread when it starts
+                        auto& evloop = event_loop::instance();
+                        if (cpu >= 0) evloop.set_cpu(cpu);
+                        evloop.register_wakeup_fd(bell.get_fd(), [this]() { bell.drain(); });
+                        evloop.register_iteration_hook([this]() { poll_rings(); });
+                        evloop.register_idle_check([this]() { return keep_polling(); });
+                        thread_id = std::this_thread::get_id();
+                        running.store(true);
+                        ready.set_value();
+
+                        start_event_loop();
+
+                        // Detaches that raced with the shutdown; later ones see !running
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                running.store(false);
+                        }
+                        apply_changes();
+                });
+                initialized.wait();
+        }
+
+        // Stops the event loop and joins the thread; rings still attached stay inert
+        void stop() {
+                if (!thread.joinable()) return;
+                stopping.store(true);
+                bell.ring();
+                thread.join();
+        }
+
+        bool on_stack_thread() const { return running.load() && std::this_thread::get_id() == thread_id; }
+
+        // Runs fn on the stack thread and waits for it (directly when not running)
+        void call(std::function<void()> fn) {
+                if (on_stack_thread()) {
+                        fn();
+                        return;
+                }
+                std::future<void> done;
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!running.load()) {
+                                fn();
+                                return;
+                        }
+                        calls.push_back({.fn = std::move(fn), .done = {}});
+                        done = calls.back().done.get_future();
+                        has_changes.store(true, std::memory_order_release);
+                        bell.ring();
+                }
+                done.wait();
+        }
+
+        // The ring's submissions are consumed by the stack thread from its next iteration
+        void attach(io_ring_t& ring) {
+                ring.bind(bell);
+                std::lock_guard<std::mutex> lock(mutex);
+                attaching.push_back(&ring);
+                has_changes.store(true, std::memory_order_release);
+                bell.ring();
+        }
+
+        // Blocks until the stack let go of the ring; its parked operations are cancelled
+        void detach(io_ring_t& ring) {
+                std::future<void> done;
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        auto it = std::find(attaching.begin(), attaching.end(), &ring);
+                        if (it != attaching.end()) {
+                                attaching.erase(it);
+                                return;
+                        }
+                        if (!running.load()) {
+                                rings.erase(std::remove(rings.begin(), rings.end(), &ring), rings.end());
+                                ring.shutdown();
+                                return;
+                        }
+                        detaching.push_back({.ring = &ring, .done = {}});
+                        done = detaching.back().done.get_future();
+                        has_changes.store(true, std::memory_order_release);
+                        bell.ring();
+                }
+                done.wait();
+        }
+
+        // The calling thread's ring, attached on first use and detached when the thread exits
+        io_ring_t& local_ring(uint32_t entries = DEFAULT_RING_ENTRIES) {
+                static thread_local local_ring_t local;
+                if (!local.ring) {
+                        local.ring = std::make_unique<io_ring_t>(entries);
+                        attach(*local.ring);
+                }
+                return *local.ring;
+        }
+};
+}  // namespace uStack
@@ -3,20 +3,27 @@
 #include <optional>
 
 #include "logger.hpp"
+#include "packet_pool.hpp"
 
 namespace uStack {
 
 namespace docs {
 static const char* base_packet_doc = R"(
 FILE: base_packet.hpp
-PURPOSE: Packet buffer with header stacking. Methods: reflush_packet(), get_pointer(), add_offset(), get_remaining_len(), get_total_len(), export_data().
+PURPOSE: Packet buffer with header stacking. Methods: reflush_packet(), get_pointer(), add_offset(), get_offset(), is_contiguous(), get_remaining_len(), truesize(), get_total_len(), set_len(), pin(), export_data().
+
+- A view packet (base_packet(pin, data, len)) reads memory it does not own, e.g. a
+  sendfile() mapping; pin keeps that memory alive as long as the packet does
 )";
 }
 
 class base_packet {
 private:
-        std::vector<std::pair<int, std::unique_ptr<uint8_t[]>>> _data_stack;
-        std::unique_ptr<uint8_t[]>                              _raw_data;
+        std::vector<std::pair<int, pool_buffer>> _data_stack;
+        pool_buffer                              _raw_data;
+        packet_pool*                             _pool = nullptr;  // _raw_data goes back here
+        std::shared_ptr<const void>              _pin;             // Owner of _view
+        uint8_t*                                 _view = nullptr;  // Read-only data not in _raw_data
 
 public:
         int _data_stack_len;
@@ -35,24 +42,53 @@ public:
               _len(len),
               _data_stack_len(0) {}
 
-        ~base_packet()             = default;
+        // Frame buffer from the pool, len <= packet_pool::BUFFER_SIZE
+        base_packet(int len, packet_pool& pool)
+            : _raw_data(pool.acquire()), _pool(&pool), _head(0), _len(len), _data_stack_len(0) {}
+
+        // len bytes already received into buffer, e.g. an arena frame from packet_pool::wrap_frame()
+        base_packet(pool_buffer buffer, int len, packet_pool& pool)
+            : _raw_data(std::move(buffer)), _pool(&pool), _head(0), _len(len), _data_stack_len(0) {}
+
+        // Read-only view of len bytes at data, kept valid by pin
+        base_packet(std::shared_ptr<const void> pin, const uint8_t* data, int len)
+            : _pin(std::move(pin)), _view(const_cast<uint8_t*>(data)), _head(0), _len(len), _data_stack_len(0) {}
+
+        ~base_packet() {
+                if (_pool) _pool->recycle(std::move(_raw_data));
+        }
         base_packet(base_packet&)  = delete;
         base_packet(base_packet&&) = delete;
         base_packet& operator=(base_packet&) = delete;
         base_packet& operator=(base_packet&&) = delete;
 
 public:
-        uint8_t* get_pointer() { return _raw_data.get() + _head; }
+        uint8_t* get_pointer() { return (_view ? _view : _raw_data.get()) + _head; }
+
+        // Set for view packets: whoever copies from get_pointer() may hold on to this instead
+        const std::shared_ptr<const void>& pin() const { return _pin; }
 
         int get_remaining_len() { return _len - _head; }
 
+        // Memory this packet holds: a whole pool frame, the heap allocation, nothing for a view
+        int truesize() { return _view ? 0 : _pool ? packet_pool::BUFFER_SIZE : _len; }
+
         int get_total_len() { return _data_stack_len; }
 
         void add_offset(int offset) { _head += offset; }
 
+        int get_offset() { return _head; }
+
+        // Shrink to the bytes actually received into the buffer
+        void set_len(int len) { _len = len; }
+
+        // True while no header layer has been stacked: the whole frame is _raw_data
+        bool is_contiguous() { return _data_stack.empty(); }
+
         void reflush_packet(int len) {
                 _data_stack_len += _len;
                 _data_stack.push_back({_len, std::move(_raw_data)});
+                _pool = nullptr;  // Pooled storage now lives on the stack and is freed with it
 
                 _head     = 0;
                 _len      = len;
@@ -9,7 +9,7 @@ namespace uStack {
 namespace docs {
 static const char* base_protocol_doc = R"(
 FILE: base_protocol.hpp
-PURPOSE: Base template for protocol layers. Methods: receive(), gather_packet(), dispatch(), register_upper_protocol(), enter_send_queue().
+PURPOSE: Base template for protocol layers. Methods: receive(), gather_packet(), dispatch(), register_upper_protocol(), enter_send_queue(), queued_packets(), has_upper_protocol().
 )";
 }
 
@@ -55,6 +55,12 @@ PURPOSE: Base template for protocol layers. Methods: receive(), gather_packet(),
                     packet_queue.push_back(std::move(in_packet));
             }
 
+            int queued_packets() { return packet_queue.size(); }
+
+            bool has_upper_protocol(int proto) {
+                    return _protocols.find(proto) != _protocols.end();
+            }
+
             void dispatch(std::optional<UpperPacketType> in_packet) {
                     if (!in_packet) return;
 
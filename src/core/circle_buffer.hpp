@@ -9,7 +9,7 @@ namespace uStack {
 namespace docs {
 static const char* circle_buffer_doc = R"(
 FILE: circle_buffer.hpp
-PURPOSE: FIFO queue wrapper. Methods: push_back(), pop_front(), empty(), size().
+PURPOSE: FIFO queue wrapper. Methods: push_back(), pop_front(), front(), empty(), size(), clear().
 )";
 }
 
@@ -32,6 +32,10 @@ PURPOSE: FIFO queue wrapper. Methods: push_back(), pop_front(), empty(), size().
             size(){
                     return packets.size();
             }
+            PacketType&
+            front() {
+                    return packets.front();
+            }
             std::optional<PacketType>
             pop_front() {
                     if (empty()) {
@@ -41,5 +45,9 @@ PURPOSE: FIFO queue wrapper. Methods: push_back(), pop_front(), empty(), size().
                     packets.pop();
                     return std::move(packet);
             }
+            void
+            clear() {
+                    std::queue<PacketType>().swap(packets);
+            }
     };
 };  // namespace uStack
\ No newline at end of file
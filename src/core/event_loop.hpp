@@ -1,11 +1,18 @@
 #pragma once
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "defination.hpp"
+#include "timer_wheel.hpp"
 
 namespace uStack {
 
@@ -14,13 +21,40 @@ static const char* event_loop_doc = R"(
 FILE: event_loop.hpp
 PURPOSE: Unified event loop using poll() for I/O multiplexing.
 - Polls TUN/TAP device (real OS FD) for network events
+- The device's write handler flushes TX before every poll and reports whether the
+  device pushed back; POLLOUT is requested only then, so an idle loop sleeps
 - Invokes application callbacks when sockets become ready
-- Single-threaded, no busy-waits
-- Readiness flags populated by protocol stack during packet processing
+- Single-threaded, no busy-waits unless busy polling is enabled
+- Advances timer_wheel once per iteration (poll timeout bounds timer latency),
+  then runs the registered iteration hooks
+- Readiness flags populated by protocol stack during packet processing, consumed
+  by process_socket_events(); marks made by callbacks carry over to the next iteration
+- epoll fds (socket_manager::epoll_create) are readable while they have ready sockets
+- write_zerocopy() completions are queued in order and delivered to the socket's
+  zero-copy callback
+- Wakeup fds (e.g. an eventfd rung by application threads) are polled next to
+  TUN/TAP and may come and go while running; idle checks run before poll() may
+  sleep and keep it from sleeping while work is pending that poll() cannot see
+- A device may take over the wait (register_poll_func, e.g. tuntap's io_uring mode):
+  it gets the same pollfd set and timeout as poll() and reports revents the same way
+- Busy polling (set_busy_poll / BUSY_POLL_US): for that long after the last event the
+  loop polls without sleeping (device and wakeup fds checked, timers advanced every
+  iteration), then falls back to the blocking poll(); get_poll_stats() counts both modes
+- set_cpu / STACK_CPU pins the thread that calls run()
 )";
 }
 
 class event_loop {
+public:
+    struct poll_stats_t {
+        uint64_t spin_polls = 0;       // Non-blocking polls within the busy-poll budget
+        uint64_t spin_hits = 0;        // ... that found an event
+        uint64_t sleeps = 0;           // Blocking polls
+        uint64_t sleep_wakeups = 0;    // ... ended by an event rather than the timeout
+        uint64_t wakeup_ns_total = 0;  // Time from entering those polls to their return
+        uint64_t wakeup_ns_max = 0;
+    };
+
 private:
     // Poll state - ONLY TUN/TAP device (real OS FD)
     pollfd tuntap_pollfd;
@@ -28,18 +62,43 @@ private:
 
     // Network event handlers
     std::function<void()> tuntap_read_handler;
-    std::function<void()> tuntap_write_handler;
+    std::function<bool()> tuntap_write_handler;  // Flush TX; true while frames wait for POLLOUT
+    bool tx_blocked = false;
+
+    // Run once per iteration after timers (e.g. TCB reaping)
+    std::vector<std::function<void()>> iteration_hooks;
+
+    // Extra OS fds polled next to TUN/TAP, handler called on POLLIN / POLLHUP / POLLERR
+    std::unordered_map<int, std::function<void()>> wakeup_handlers;
+    bool wakeup_fds_changed = false;
+
+    // Asked before poll() sleeps: true when there is work poll() cannot see
+    std::vector<std::function<bool()>> idle_checks;
+
+    // Called instead of poll() when set
+    std::function<int(pollfd*, nfds_t, int)> poll_func;
 
     // Application callbacks (logical FDs)
     std::unordered_map<int, std::function<void()>> accept_callbacks;
     std::unordered_map<int, std::function<void()>> read_callbacks;
+    std::unordered_map<int, std::function<void()>> write_callbacks;
+    std::unordered_map<int, std::function<void(int)>> connect_callbacks;  // Argument: 0 or errno
+    std::unordered_map<int, std::function<void(uint32_t)>> zerocopy_callbacks;  // Argument: completion id
 
     // Readiness tracking (populated during network processing)
     std::unordered_set<int> readable_sockets;
+    std::unordered_set<int> writable_sockets;
     std::unordered_set<int> acceptable_listeners;
+    std::unordered_map<int, int> connected_sockets;  // fd -> connect result
+    std::vector<std::pair<int, uint32_t>> zerocopy_completions;  // fd, id in completion order
 
     bool running = false;
 
+    // -1: read from the environment when run() starts
+    int cpu = -1;
+    int busy_poll_us = -1;
+    poll_stats_t poll_stats;
+
     // Singleton
     event_loop() = default;
     ~event_loop() = default;
@@ -55,14 +114,65 @@ public:
         return instance;
     }
 
+    // write_cb sends what the stack has queued and returns true when it stopped early
+    // (device full or batch limit), false once the stack had nothing more to send
     void register_tuntap(int fd,
                         std::function<void()> read_cb,
-                        std::function<void()> write_cb) {
+                        std::function<bool()> write_cb) {
         tuntap_fd = fd;
         tuntap_read_handler = read_cb;
         tuntap_write_handler = write_cb;
     }
 
+    void register_iteration_hook(std::function<void()> hook) {
+        iteration_hooks.push_back(std::move(hook));
+    }
+
+    void register_wakeup_fd(int fd, std::function<void()> handler) {
+        wakeup_handlers[fd] = std::move(handler);
+        wakeup_fds_changed = true;
+    }
+
+    void unregister_wakeup_fd(int fd) {
+        wakeup_fds_changed |= wakeup_handlers.erase(fd) > 0;
+    }
+
+    void register_idle_check(std::function<bool()> check) {
+        idle_checks.push_back(std::move(check));
+    }
+
+    // pollfds[0] is the device entry (fd -1 when the device is not pollable)
+    void register_poll_func(std::function<int(pollfd*, nfds_t, int)> func) {
+        poll_func = std::move(func);
+    }
+
+    // Spin for usec after the last event before sleeping in poll(), 0: always sleep
+    void set_busy_poll(uint32_t usec) {
+        busy_poll_us = usec;
+    }
+
+    void set_cpu(int cpu) {
+        this->cpu = cpu;
+    }
+
+    const poll_stats_t& get_poll_stats() const {
+        return poll_stats;
+    }
+
+    // Pins the calling thread, false on failure
+    static bool pin_to_cpu(int cpu) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            LOG(ERROR) << "[EVENT LOOP] cannot pin to CPU " << cpu << ": " << err;
+            return false;
+        }
+        LOG_INIT("Event loop pinned to CPU " << cpu);
+        return true;
+    }
+
     void register_accept_callback(int listener_fd, std::function<void()> cb) {
         accept_callbacks[listener_fd] = cb;
     }
@@ -71,40 +181,137 @@ public:
         read_callbacks[socket_fd] = cb;
     }
 
+    // Called when a write() that was cut short (send buffer full) may continue
+    void register_write_callback(int socket_fd, std::function<void()> cb) {
+        write_callbacks[socket_fd] = cb;
+    }
+
+    void register_connect_callback(int socket_fd, std::function<void(int)> cb) {
+        connect_callbacks[socket_fd] = cb;
+    }
+
+    // Called with the id of each write_zerocopy() whose buffer the stack let go of
+    void register_zerocopy_callback(int socket_fd, std::function<void(uint32_t)> cb) {
+        zerocopy_callbacks[socket_fd] = cb;
+    }
+
     void unregister_callbacks(int fd) {
         accept_callbacks.erase(fd);
         read_callbacks.erase(fd);
+        write_callbacks.erase(fd);
+        connect_callbacks.erase(fd);
+        zerocopy_callbacks.erase(fd);
     }
 
     void mark_readable(int socket_fd) {
         readable_sockets.insert(socket_fd);
     }
 
+    void mark_writable(int socket_fd) {
+        writable_sockets.insert(socket_fd);
+    }
+
     void mark_acceptable(int listener_fd) {
         acceptable_listeners.insert(listener_fd);
     }
 
+    void mark_connected(int socket_fd, int error) {
+        connected_sockets[socket_fd] = error;
+    }
+
+    void post_zerocopy_completion(int socket_fd, uint32_t id) {
+        zerocopy_completions.emplace_back(socket_fd, id);
+    }
+
     void run() {
         running = true;
         tuntap_pollfd.fd = tuntap_fd;
-        tuntap_pollfd.events = POLLIN | POLLOUT;
+        tuntap_pollfd.events = POLLIN;
+
+        std::vector<pollfd> pollfds;
+        wakeup_fds_changed = true;
+
+        if (cpu < 0) {
+            const char* env_cpu = std::getenv("STACK_CPU");
+            if (env_cpu) cpu = std::atoi(env_cpu);
+        }
+        if (cpu >= 0) pin_to_cpu(cpu);
+        if (busy_poll_us < 0) {
+            const char* env_usec = std::getenv("BUSY_POLL_US");
+            busy_poll_us = env_usec ? std::max(std::atoi(env_usec), 0) : 0;
+        }
+        using clock = std::chrono::steady_clock;
+        const auto busy_poll = std::chrono::microseconds(busy_poll_us);
+        auto last_event = clock::now();
 
         LOG_INIT("Event loop started");
 
         while (running) {
-            readable_sockets.clear();
-            acceptable_listeners.clear();
+            if (wakeup_fds_changed) {
+                pollfds = {tuntap_pollfd};
+                for (auto& [fd, handler] : wakeup_handlers) {
+                    pollfds.push_back({.fd = fd, .events = POLLIN, .revents = 0});
+                }
+                wakeup_fds_changed = false;
+            }
+
+            // Send what the last round produced; wait for POLLOUT only if the device pushed back
+            if (tuntap_write_handler) tx_blocked = tuntap_write_handler();
+            pollfds[0].events = tx_blocked ? POLLIN | POLLOUT : POLLIN;
+
+            // Poll TUN/TAP and the wakeup fds (100ms timeout for graceful shutdown);
+            // don't sleep while readiness marked by the last round of callbacks is pending
+            bool pending = !readable_sockets.empty() || !writable_sockets.empty() ||
+                           !acceptable_listeners.empty() || !connected_sockets.empty() ||
+                           !zerocopy_completions.empty();
+            for (size_t i = 0; i < idle_checks.size() && !pending; i++) {
+                pending = idle_checks[i]();
+            }
+            int timeout = pending ? 0 : 100;
+
+            // Busy polling: don't sleep within the budget after the last event
+            bool spinning = false;
+            clock::time_point now;
+            if (busy_poll_us > 0 || timeout != 0) now = clock::now();
+            if (busy_poll_us > 0) {
+                if (pending) {
+                    last_event = now;
+                } else if (now - last_event < busy_poll) {
+                    timeout = 0;
+                    spinning = true;
+                }
+            }
+
+            int ret = poll_func ? poll_func(pollfds.data(), pollfds.size(), timeout)
+                                : poll(pollfds.data(), pollfds.size(), timeout);
 
-            // Poll only TUN/TAP (100ms timeout for graceful shutdown)
-            int ret = poll(&tuntap_pollfd, 1, 100);
+            if (spinning) {
+                poll_stats.spin_polls++;
+                poll_stats.spin_hits += ret > 0;
+            } else if (timeout != 0) {
+                poll_stats.sleeps++;
+                if (ret > 0) {
+                    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - now).count();
+                    poll_stats.sleep_wakeups++;
+                    poll_stats.wakeup_ns_total += ns;
+                    poll_stats.wakeup_ns_max = std::max(poll_stats.wakeup_ns_max, ns);
+                }
+            }
+            if (ret > 0 && busy_poll_us > 0) last_event = clock::now();
 
             if (ret > 0) {
+                tuntap_pollfd.revents = pollfds[0].revents;
                 process_network_events();
+                process_wakeup_events(pollfds);
             } else if (ret < 0) {
                 LOG(ERROR) << "Poll error";
                 break;
             }
 
+            timer_wheel::instance().advance();
+            for (auto& hook : iteration_hooks) {
+                hook();
+            }
             process_socket_events();
         }
 
@@ -127,23 +334,81 @@ private:
         // Handle POLLOUT - network transmit
         if (tuntap_pollfd.revents & POLLOUT) {
             if (tuntap_write_handler) {
-                tuntap_write_handler();
+                tx_blocked = tuntap_write_handler();
+            }
+        }
+    }
+
+    // A handler may unregister wakeup fds, the poll set is rebuilt next iteration
+    void process_wakeup_events(const std::vector<pollfd>& pollfds) {
+        for (size_t i = 1; i < pollfds.size(); i++) {
+            if (!(pollfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            auto it = wakeup_handlers.find(pollfds[i].fd);
+            if (it != wakeup_handlers.end()) {
+                auto handler = it->second;
+                handler();
             }
         }
     }
 
+    // Callbacks are copied before the call: a callback may close() its own fd,
+    // which unregisters (destroys) the stored std::function
+    // The readiness sets are taken before dispatch: anything marked by a callback
+    // (e.g. an epoll fd with level-triggered leftovers) runs next iteration.
     void process_socket_events() {
+        std::unordered_map<int, int> connected_sockets;
+        std::unordered_set<int>      acceptable_listeners;
+        std::unordered_set<int>      readable_sockets;
+        std::unordered_set<int>      writable_sockets;
+        std::vector<std::pair<int, uint32_t>> zerocopy_completions;
+        connected_sockets.swap(this->connected_sockets);
+        acceptable_listeners.swap(this->acceptable_listeners);
+        readable_sockets.swap(this->readable_sockets);
+        writable_sockets.swap(this->writable_sockets);
+        zerocopy_completions.swap(this->zerocopy_completions);
+
+        // Invoke connect callbacks for finished active opens
+        for (auto& [socket_fd, error] : connected_sockets) {
+            auto it = connect_callbacks.find(socket_fd);
+            if (it != connect_callbacks.end()) {
+                auto cb = it->second;
+                cb(error);
+            }
+        }
+
         // Invoke accept callbacks for listeners with pending connections
         for (int listener_fd : acceptable_listeners) {
-            if (accept_callbacks.find(listener_fd) != accept_callbacks.end()) {
-                accept_callbacks[listener_fd]();
+            auto it = accept_callbacks.find(listener_fd);
+            if (it != accept_callbacks.end()) {
+                auto cb = it->second;
+                cb();
             }
         }
 
         // Invoke read callbacks for sockets with pending data
         for (int socket_fd : readable_sockets) {
-            if (read_callbacks.find(socket_fd) != read_callbacks.end()) {
-                read_callbacks[socket_fd]();
+            auto it = read_callbacks.find(socket_fd);
+            if (it != read_callbacks.end()) {
+                auto cb = it->second;
+                cb();
+            }
+        }
+
+        // Hand zero-copy send buffers back, before writers queue more from them
+        for (auto& [socket_fd, id] : zerocopy_completions) {
+            auto it = zerocopy_callbacks.find(socket_fd);
+            if (it != zerocopy_callbacks.end()) {
+                auto cb = it->second;
+                cb(id);
+            }
+        }
+
+        // Invoke write callbacks for sockets whose send buffer drained
+        for (int socket_fd : writable_sockets) {
+            auto it = write_callbacks.find(socket_fd);
+            if (it != write_callbacks.end()) {
+                auto cb = it->second;
+                cb();
             }
         }
     }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+
+namespace uStack {
+
+namespace docs {
+static const char* file_mapping_doc = R"(
+FILE: file_mapping.hpp
+PURPOSE: Read-only mmap of a file range, unmapped with its last reference. Methods: map(), data(), size().
+
+USAGE: sendfile() queues slices of the mapping as TCP payload; send queue entries and
+retransmission entries share it, so the pages stay mapped until the data is ACKed.
+Truncating the file underneath an unacknowledged range raises SIGBUS, as with any mapping.
+)";
+}
+
+class file_mapping {
+private:
+        void*    _base;
+        size_t   _mapped_len;
+        uint8_t* _data;
+        size_t   _len;
+
+        file_mapping(void* base, size_t mapped_len, uint8_t* data, size_t len)
+            : _base(base), _mapped_len(mapped_len), _data(data), _len(len) {}
+
+public:
+        ~file_mapping() { ::munmap(_base, _mapped_len); }
+
+        file_mapping(const file_mapping&)            = delete;
+        file_mapping& operator=(const file_mapping&) = delete;
+
+        // len bytes of fd from offset; nullptr with errno set on failure
+        static std::shared_ptr<file_mapping> map(int fd, off_t offset, size_t len) {
+                if (offset < 0 || len == 0) {
+                        errno = EINVAL;
+                        return nullptr;
+                }
+                // mmap offsets must be page aligned; map from the page holding offset
+                off_t  page   = ::sysconf(_SC_PAGESIZE);
+                off_t  start  = offset - offset % page;
+                size_t lead   = offset - start;
+                void*  base   = ::mmap(nullptr, lead + len, PROT_READ, MAP_SHARED, fd, start);
+                if (base == MAP_FAILED) {
+                        return nullptr;
+                }
+                ::madvise(base, lead + len, MADV_SEQUENTIAL);
+                ::madvise(base, lead + len, MADV_WILLNEED);
+                return std::shared_ptr<file_mapping>(
+                        new file_mapping(base, lead + len, static_cast<uint8_t*>(base) + lead, len));
+        }
+
+        const uint8_t* data() const { return _data; }
+        size_t         size() const { return _len; }
+};
+}  // namespace uStack
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace uStack {
+
+namespace docs {
+static const char* packet_pool_doc = R"(
+FILE: packet_pool.hpp
+PURPOSE: Free list of frame-sized receive buffers. Methods: acquire(), recycle(), cached(), allocations(), reuses().
+
+SINGLETON PATTERN:
+packet_pool& pool = packet_pool::instance();
+
+- The device reads frames straight into pooled buffers (base_packet(len, pool))
+- A pooled base_packet hands its buffer back when destroyed: after the TCP
+  payload was copied out by read(), or when a zero-copy view is released
+- At most MAX_CACHED idle buffers are kept, the rest are freed
+- An arena (e.g. an AF_XDP UMEM) can be adopted: its frames are lent out with
+  take_frame() / wrap_frame() and come back through give_frame() or the buffer's
+  deleter, never through delete[]
+)";
+}
+
+class packet_pool;
+
+// delete[] for heap buffers; arena frames go back to their pool
+struct pool_deleter {
+        packet_pool* arena = nullptr;
+
+        pool_deleter() = default;
+        explicit pool_deleter(packet_pool* owner) : arena(owner) {}
+        pool_deleter(std::default_delete<uint8_t[]>) {}
+
+        void operator()(uint8_t* buffer) const;
+};
+using pool_buffer = std::unique_ptr<uint8_t[], pool_deleter>;
+
+class packet_pool {
+public:
+        static constexpr int    BUFFER_SIZE = 2048;  // Ethernet frame plus headroom
+        static constexpr size_t MAX_CACHED  = 1024;
+
+private:
+        std::vector<pool_buffer> free_buffers;
+        uint64_t                 allocation_count = 0;
+        uint64_t                 reuse_count      = 0;
+
+        uint8_t*              arena_base       = nullptr;
+        size_t                arena_frame_size = 0;
+        size_t                arena_len        = 0;
+        std::vector<uint8_t*> arena_free;
+
+        packet_pool()  = default;
+        ~packet_pool() = default;
+
+public:
+        packet_pool(const packet_pool&)            = delete;
+        packet_pool(packet_pool&&)                 = delete;
+        packet_pool& operator=(const packet_pool&) = delete;
+        packet_pool& operator=(packet_pool&&)      = delete;
+
+        static packet_pool& instance() {
+                static packet_pool instance;
+                return instance;
+        }
+
+        pool_buffer acquire() {
+                if (free_buffers.empty()) {
+                        allocation_count++;
+                        return std::make_unique<uint8_t[]>(BUFFER_SIZE);
+                }
+                reuse_count++;
+                pool_buffer buffer = std::move(free_buffers.back());
+                free_buffers.pop_back();
+                return buffer;
+        }
+
+        // buffer must have come from acquire() or wrap_frame()
+        void recycle(pool_buffer buffer) {
+                if (buffer && !buffer.get_deleter().arena && free_buffers.size() < MAX_CACHED) {
+                        free_buffers.push_back(std::move(buffer));
+                }
+        }
+
+        // frames of frame_size bytes at base, all free; the caller keeps the memory alive
+        void adopt_arena(uint8_t* base, size_t frames, size_t frame_size) {
+                arena_base       = base;
+                arena_frame_size = frame_size;
+                arena_len        = frames * frame_size;
+                arena_free.clear();
+                for (size_t i = frames; i > 0; i--) arena_free.push_back(base + (i - 1) * frame_size);
+        }
+
+        bool in_arena(const uint8_t* buffer) const {
+                return arena_base && buffer >= arena_base && buffer < arena_base + arena_len;
+        }
+
+        // Start of a free arena frame, nullptr when all are lent out
+        uint8_t* take_frame() {
+                if (arena_free.empty()) return nullptr;
+                uint8_t* frame = arena_free.back();
+                arena_free.pop_back();
+                return frame;
+        }
+
+        // Any address inside a lent frame
+        void give_frame(uint8_t* buffer) {
+                size_t index = (buffer - arena_base) / arena_frame_size;
+                arena_free.push_back(arena_base + index * arena_frame_size);
+        }
+
+        // Owning handle for data inside a lent frame: the frame comes back when it is destroyed
+        pool_buffer wrap_frame(uint8_t* data) { return pool_buffer(data, pool_deleter(this)); }
+
+        size_t free_frames() const { return arena_free.size(); }
+
+        size_t   cached() const { return free_buffers.size(); }
+        uint64_t allocations() const { return allocation_count; }
+        uint64_t reuses() const { return reuse_count; }
+};
+
+inline void pool_deleter::operator()(uint8_t* buffer) const {
+        if (arena) {
+                arena->give_frame(buffer);
+        } else {
+                delete[] buffer;
+        }
+}
+}  // namespace uStack
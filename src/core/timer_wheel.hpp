@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace uStack {
+
+namespace docs {
+static const char* timer_wheel_doc = R"(
+FILE: timer_wheel.hpp
+PURPOSE: Hierarchical timing wheel for protocol timers. Methods: schedule(), cancel(), advance(), pending(), now_tick().
+
+SINGLETON PATTERN:
+timer_wheel& wheel = timer_wheel::instance();
+
+- TICK_MS granularity; LEVELS wheels of SLOTS buckets, each level's bucket spanning
+  one whole rotation of the level below (0.64 s, 41 s, 44 min, 46.6 h)
+- A timer is filed in the lowest level that reaches its expiry; when a level's
+  bucket comes round its timers cascade down, so each timer moves at most
+  LEVELS - 1 times before it fires (a 2 h keepalive: 3 moves, not one visit
+  per rotation). Timers beyond SPAN wait in the top level and are re-filed
+- schedule()/cancel() are O(1); advance() is O(ticks elapsed + timers fired +
+  timers cascaded), with no work per pending timer per rotation
+- Callbacks run from advance() (event_loop, once per iteration) and may
+  schedule or cancel other timers
+)";
+}
+
+class timer_wheel {
+public:
+        using clock    = std::chrono::steady_clock;
+        using timer_id = uint64_t;
+
+        static constexpr uint32_t TICK_MS   = 10;
+        static constexpr uint32_t SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS     = 1 << SLOT_BITS;  // Per level
+        static constexpr uint32_t LEVELS    = 4;
+        static constexpr uint64_t SPAN      = uint64_t(1) << (SLOT_BITS * LEVELS);  // Ticks the levels cover
+
+private:
+        struct timer_t {
+                timer_id              id;
+                uint64_t              expiry_tick;
+                std::function<void()> callback;
+        };
+        using slot_t = std::list<timer_t>;
+
+        std::array<std::array<slot_t, SLOTS>, LEVELS>                     levels;
+        std::unordered_map<timer_id, std::pair<slot_t*, slot_t::iterator>> index;
+        clock::time_point                                                 start;
+        uint64_t                                                          current_tick = 0;
+        timer_id                                                          next_id      = 1;
+        uint64_t                                                          cascades     = 0;
+
+        uint64_t tick_of(clock::time_point now) const {
+                if (now < start) return 0;
+                return std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() / TICK_MS;
+        }
+
+        // Lowest level whose range (seen from current_tick) reaches expiry
+        slot_t& slot_for(uint64_t expiry) {
+                uint64_t delta = expiry > current_tick ? expiry - current_tick : 0;
+                if (delta >= SPAN) {
+                        // Parked in the top level, re-filed when its bucket cascades
+                        delta  = SPAN - 1;
+                        expiry = current_tick + delta;
+                }
+                uint32_t level = 0;
+                while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+                        level++;
+                }
+                return levels[level][(expiry >> (SLOT_BITS * level)) & (SLOTS - 1)];
+        }
+
+        // Re-file the timers of a higher level bucket that has come round
+        void cascade(slot_t& slot) {
+                while (!slot.empty()) {
+                        auto    it     = slot.begin();
+                        slot_t& target = slot_for(it->expiry_tick);
+                        target.splice(target.end(), slot, it);
+                        index[it->id].first = &target;
+                        cascades++;
+                }
+        }
+
+        // Tick current_tick: cascade the buckets starting here, then move due level 0 timers into fired
+        void run_tick(std::vector<std::function<void()>>& fired) {
+                for (uint32_t level = 1; level < LEVELS; level++) {
+                        if (current_tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) break;
+                        cascade(levels[level][(current_tick >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+                }
+                slot_t& slot = levels[0][current_tick & (SLOTS - 1)];
+                for (auto it = slot.begin(); it != slot.end();) {
+                        if (it->expiry_tick <= current_tick) {
+                                fired.push_back(std::move(it->callback));
+                                index.erase(it->id);
+                                it = slot.erase(it);
+                        } else {
+                                ++it;
+                        }
+                }
+        }
+
+public:
+        timer_wheel() : start(clock::now()) {}
+
+        static timer_wheel& instance() {
+                static timer_wheel instance;
+                return instance;
+        }
+
+        timer_wheel(const timer_wheel&)            = delete;
+        timer_wheel(timer_wheel&&)                 = delete;
+        timer_wheel& operator=(const timer_wheel&) = delete;
+        timer_wheel& operator=(timer_wheel&&)      = delete;
+
+        timer_id schedule(std::chrono::milliseconds delay, std::function<void()> callback,
+                          clock::time_point now = clock::now()) {
+                uint64_t ticks  = (delay.count() + TICK_MS - 1) / TICK_MS;
+                uint64_t expiry = std::max(tick_of(now), current_tick) + std::max<uint64_t>(ticks, 1);
+                slot_t&  slot   = slot_for(expiry);
+
+                timer_id id = next_id++;
+                slot.push_back({id, expiry, std::move(callback)});
+                index[id] = {&slot, std::prev(slot.end())};
+                return id;
+        }
+
+        bool cancel(timer_id id) {
+                auto it = index.find(id);
+                if (it == index.end()) return false;
+                it->second.first->erase(it->second.second);
+                index.erase(it);
+                return true;
+        }
+
+        // Fire every timer due by now. Returns the number fired.
+        size_t advance(clock::time_point now = clock::now()) {
+                uint64_t target = tick_of(now);
+                if (target <= current_tick) return 0;
+
+                std::vector<std::function<void()>> fired;
+                while (current_tick < target) {
+                        if (index.empty()) {
+                                current_tick = target;
+                                break;
+                        }
+                        current_tick++;
+                        run_tick(fired);
+                }
+
+                for (auto& callback : fired) callback();
+                return fired.size();
+        }
+
+        size_t pending() const { return index.size(); }
+
+        // Timer moves between levels so far (each timer at most LEVELS - 1 times per SPAN)
+        uint64_t cascaded() const { return cascades; }
+
+        // Coarse clock (TICK_MS resolution, updated by advance()) for per-segment timestamps
+        uint64_t now_tick() const { return current_tick; }
+};
+}  // namespace uStack
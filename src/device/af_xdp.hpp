@@ -0,0 +1,500 @@
+#pragma once
+
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+
+#include "file_desc.hpp"
+#include "ipv4.hpp"
+#include "ipv4_addr.hpp"
+#include "mac_addr.hpp"
+#include "packets.hpp"
+#include "utils.hpp"
+#include "event_loop.hpp"
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+namespace uStack {
+
+namespace docs {
+static const char* af_xdp_doc = R"(
+FILE: af_xdp.hpp
+PURPOSE: AF_XDP device on an existing interface (XDP_IFACE, e.g. one end of a veth pair).
+Same contract as tuntap: register_upper_protocol(), run(), get_mac_addr(), get_ipv4_addr().
+- XDP_MODE=skb (generic, default) or native (driver XDP, zero-copy when the driver
+  supports it, copy mode otherwise); XDP_QUEUE selects the queue (default 0)
+- A built-in XDP program (XSKMAP redirect, loaded with bpf() and attached as a bpf_link)
+  sends every frame of the queue to the socket; it is detached when the process exits
+- UMEM: FRAME_COUNT frames of packet_pool::BUFFER_SIZE, adopted by packet_pool as its
+  arena. Received frames go up the stack in place and return to the pool when the
+  last packet referencing them is destroyed; the fill ring is refilled from the pool.
+  Below FILL_LOW_WATER free frames, received frames are copied into heap buffers so
+  data queued in sockets cannot starve the fill ring
+- TX: frames from the pool, one sendto() kick per batch (only when the kernel asks for
+  a wakeup); the completion ring hands them back to the pool
+- XDP_BUSY_POLL=<usec>: SO_PREFER_BUSY_POLL / SO_BUSY_POLL on the socket and the event
+  loop never sleeps, so each poll() busy-polls the queue. Pair it with
+  napi_defer_hard_irqs / gro_flush_timeout on the interface
+- Leave the interface without an IP address; the kernel no longer sees the queue's frames
+- Requires root (CAP_NET_ADMIN, CAP_NET_RAW, CAP_BPF), Linux 5.11+
+)";
+}
+
+template <int mtu>
+class af_xdp {
+public:
+        constexpr static int MTU = mtu;
+        constexpr static int TAG = TUNTAP_DEV;  // The stack's one device
+
+        constexpr static uint32_t FRAME_SIZE     = packet_pool::BUFFER_SIZE;
+        constexpr static uint32_t FRAME_COUNT    = 4096;
+        constexpr static uint32_t RING_SIZE      = 2048;  // Fill, completion, RX and TX rings
+        constexpr static uint32_t FILL_LOW_WATER = FRAME_COUNT / 8;
+        constexpr static uint32_t TX_RESERVE     = 256;  // Frames the fill ring leaves for TX
+        constexpr static uint32_t BUSY_BUDGET    = 64;
+        static_assert(MTU + 14 + XDP_PACKET_HEADROOM <= FRAME_SIZE, "a UMEM frame holds one Ethernet frame");
+
+        struct stats_t {
+                uint64_t rx_frames  = 0;
+                uint64_t rx_copied  = 0;  // Copied out of the UMEM (low on free frames)
+                uint64_t tx_frames  = 0;
+                uint64_t tx_kicks   = 0;
+                uint64_t fill_empty = 0;  // Refills that found no free frame
+        };
+
+private:
+        // Single producer / single consumer ring shared with the kernel
+        struct ring_t {
+                std::atomic<uint32_t>* producer = nullptr;
+                std::atomic<uint32_t>* consumer = nullptr;
+                uint32_t*              flags    = nullptr;
+                void*                  descs    = nullptr;
+                void*                  map      = nullptr;
+                size_t                 map_len  = 0;
+                uint32_t               cached   = 0;  // Our side's index, published by release()
+
+                // Producer side
+                uint32_t free() const { return RING_SIZE - (cached - consumer->load(std::memory_order_acquire)); }
+                // Consumer side
+                uint32_t available() const { return producer->load(std::memory_order_acquire) - cached; }
+
+                template <typename T>
+                T& at(uint32_t index) {
+                        return static_cast<T*>(descs)[index & (RING_SIZE - 1)];
+                }
+                void publish_produced() { producer->store(cached, std::memory_order_release); }
+                void publish_consumed() { consumer->store(cached, std::memory_order_release); }
+                bool needs_wakeup() const { return *flags & XDP_RING_NEED_WAKEUP; }
+        };
+
+        file_desc                  _fd;
+        file_desc                  _map_fd;
+        file_desc                  _prog_fd;
+        file_desc                  _link_fd;
+        std::optional<mac_addr_t>  _mac_addr;
+        std::optional<ipv4_addr_t> _ipv4_addr;
+        std::string                _dev_name;
+        int                        _ifindex = 0;
+        uint32_t                   _queue   = 0;
+
+        bool     _available = false;
+        uint8_t* _umem      = nullptr;
+        ring_t   _fill;
+        ring_t   _completion;
+        ring_t   _rx;
+        ring_t   _tx;
+        stats_t  _stats;
+
+        using packet_provider_type = std::function<std::optional<raw_packet>(void)>;
+        using packet_receiver_type = std::function<void(raw_packet)>;
+
+        std::optional<packet_provider_type> _provider_func;
+        std::optional<packet_receiver_type> _receiver_func;
+
+private:
+        ~af_xdp() {
+                for (ring_t* ring : {&_fill, &_completion, &_rx, &_tx}) {
+                        if (ring->map) munmap(ring->map, ring->map_len);
+                }
+                // The pool may still hold frames of the UMEM: leave the mapping to process exit
+        }
+
+        af_xdp() { init(); }
+
+public:
+        af_xdp(const af_xdp&) = delete;
+        af_xdp(af_xdp&&)      = delete;
+        af_xdp& operator=(const af_xdp&) = delete;
+        af_xdp& operator=(af_xdp&& x) = delete;
+
+        static af_xdp& instance() {
+                static af_xdp instance;
+                return instance;
+        }
+
+        operator bool() { return _available; }
+
+        // Interface the device binds to, nullptr: another device is used
+        static const char* configured_iface() { return std::getenv("XDP_IFACE"); }
+
+private:
+        static int bpf(int cmd, bpf_attr& attr) { return syscall(__NR_bpf, cmd, &attr, sizeof(attr)); }
+
+        void set_mac_addr() {
+                // AF_XDP sockets take no interface ioctls
+                auto probe = file_desc::from_fd(::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0));
+                if (!probe) {
+                        LOG(FATAL) << "[PROBE SOCKET] " << strerror(errno);
+                }
+                struct ifreq ifr = {};
+                strncpy(ifr.ifr_name, _dev_name.c_str(), IFNAMSIZ - 1);
+                if (probe->ioctl(SIOCGIFINDEX, ifr) < 0) {
+                        LOG(FATAL) << "[NO IFACE] " << _dev_name;
+                }
+                _ifindex = ifr.ifr_ifindex;
+
+                if (probe->ioctl(SIOCGIFHWADDR, ifr) < 0) {
+                        LOG(FATAL) << "[HW FAIL]";
+                }
+                std::array<uint8_t, 6> hw_addr;
+                for (int i = 0; i < 6; ++i) {
+                        hw_addr[i] = ifr.ifr_addr.sa_data[i];
+                }
+                _mac_addr = mac_addr_t(hw_addr);
+        }
+
+        void map_ring(ring_t& ring, const xdp_ring_offset& offsets, size_t desc_size, off_t pgoff) {
+                ring.map_len = offsets.desc + RING_SIZE * desc_size;
+                ring.map     = mmap(nullptr, ring.map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    _fd.get_fd(), pgoff);
+                if (ring.map == MAP_FAILED) {
+                        ring.map = nullptr;
+                        LOG(FATAL) << "[XDP RING MMAP] " << strerror(errno);
+                }
+                auto* base    = static_cast<uint8_t*>(ring.map);
+                ring.producer = reinterpret_cast<std::atomic<uint32_t>*>(base + offsets.producer);
+                ring.consumer = reinterpret_cast<std::atomic<uint32_t>*>(base + offsets.consumer);
+                ring.flags    = reinterpret_cast<uint32_t*>(base + offsets.flags);
+                ring.descs    = base + offsets.desc;
+        }
+
+        void setup_umem() {
+                size_t len = size_t(FRAME_COUNT) * FRAME_SIZE;
+                void*  mem = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+                if (mem == MAP_FAILED) {
+                        LOG(FATAL) << "[UMEM MMAP] " << strerror(errno);
+                }
+                _umem = static_cast<uint8_t*>(mem);
+
+                xdp_umem_reg reg = {};
+                reg.addr         = reinterpret_cast<uint64_t>(_umem);
+                reg.len          = len;
+                reg.chunk_size   = FRAME_SIZE;
+                reg.headroom     = 0;
+                if (setsockopt(_fd.get_fd(), SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+                        LOG(FATAL) << "[UMEM REG] " << strerror(errno);
+                }
+                packet_pool::instance().adopt_arena(_umem, FRAME_COUNT, FRAME_SIZE);
+        }
+
+        void setup_rings() {
+                // Ring sizes must be set before the offsets can be read
+                int size = RING_SIZE;
+                for (int opt : {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING}) {
+                        if (setsockopt(_fd.get_fd(), SOL_XDP, opt, &size, sizeof(size)) < 0) {
+                                LOG(FATAL) << "[XDP RING] " << strerror(errno);
+                        }
+                }
+                xdp_mmap_offsets offsets = {};
+                socklen_t        len     = sizeof(offsets);
+                if (getsockopt(_fd.get_fd(), SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &len) < 0) {
+                        LOG(FATAL) << "[XDP OFFSETS] " << strerror(errno);
+                }
+                map_ring(_fill, offsets.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING);
+                map_ring(_completion, offsets.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING);
+                map_ring(_rx, offsets.rx, sizeof(xdp_desc), XDP_PGOFF_RX_RING);
+                map_ring(_tx, offsets.tx, sizeof(xdp_desc), XDP_PGOFF_TX_RING);
+        }
+
+        // Native mode tries zero-copy first, generic mode always copies
+        void bind_socket(bool native) {
+                sockaddr_xdp addr   = {};
+                addr.sxdp_family    = AF_XDP;
+                addr.sxdp_ifindex   = _ifindex;
+                addr.sxdp_queue_id  = _queue;
+                addr.sxdp_flags     = XDP_USE_NEED_WAKEUP | (native ? XDP_ZEROCOPY : XDP_COPY);
+                int err = ::bind(_fd.get_fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+                if (err < 0 && native) {
+                        addr.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+                        err             = ::bind(_fd.get_fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+                }
+                if (err < 0) {
+                        LOG(FATAL) << "[XDP BIND] " << _dev_name << " queue " << _queue << " " << strerror(errno);
+                }
+        }
+
+        // return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+        void attach_program(bool native) {
+                bpf_attr attr    = {};
+                attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+                attr.key_size    = sizeof(uint32_t);
+                attr.value_size  = sizeof(uint32_t);
+                attr.max_entries = _queue + 1;
+                auto map_fd      = file_desc::from_fd(bpf(BPF_MAP_CREATE, attr));
+                if (!map_fd) {
+                        LOG(FATAL) << "[XSKMAP] " << strerror(errno);
+                }
+                _map_fd = std::move(map_fd.value());
+
+                uint32_t key   = _queue;
+                uint32_t value = _fd.get_fd();
+                attr           = {};
+                attr.map_fd    = _map_fd.get_fd();
+                attr.key       = reinterpret_cast<uint64_t>(&key);
+                attr.value     = reinterpret_cast<uint64_t>(&value);
+                if (bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+                        LOG(FATAL) << "[XSKMAP UPDATE] " << strerror(errno);
+                }
+
+                bpf_insn program[] = {
+                        // r2 = ctx->rx_queue_index
+                        {.code = BPF_LDX | BPF_W | BPF_MEM, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_1,
+                         .off = offsetof(xdp_md, rx_queue_index), .imm = 0},
+                        // r1 = &xsks (two instructions)
+                        {.code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_1, .src_reg = BPF_PSEUDO_MAP_FD,
+                         .off = 0, .imm = _map_fd.get_fd()},
+                        {.code = 0, .dst_reg = 0, .src_reg = 0, .off = 0, .imm = 0},
+                        // r3 = XDP_PASS, the action when the queue has no socket
+                        {.code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_3, .src_reg = 0, .off = 0,
+                         .imm = XDP_PASS},
+                        {.code = BPF_JMP | BPF_CALL, .dst_reg = 0, .src_reg = 0, .off = 0,
+                         .imm = BPF_FUNC_redirect_map},
+                        {.code = BPF_JMP | BPF_EXIT, .dst_reg = 0, .src_reg = 0, .off = 0, .imm = 0},
+                };
+                static const char license[] = "Dual MIT/GPL";
+                attr           = {};
+                attr.prog_type = BPF_PROG_TYPE_XDP;
+                attr.insns     = reinterpret_cast<uint64_t>(program);
+                attr.insn_cnt  = sizeof(program) / sizeof(program[0]);
+                attr.license   = reinterpret_cast<uint64_t>(license);
+                auto prog_fd   = file_desc::from_fd(bpf(BPF_PROG_LOAD, attr));
+                if (!prog_fd) {
+                        LOG(FATAL) << "[XDP PROG LOAD] " << strerror(errno);
+                }
+                _prog_fd = std::move(prog_fd.value());
+
+                attr                            = {};
+                attr.link_create.prog_fd        = _prog_fd.get_fd();
+                attr.link_create.target_ifindex = _ifindex;
+                attr.link_create.attach_type    = BPF_XDP;
+                attr.link_create.flags          = native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+                auto link_fd                    = file_desc::from_fd(bpf(BPF_LINK_CREATE, attr));
+                if (!link_fd) {
+                        LOG(FATAL) << "[XDP ATTACH] " << _dev_name << " " << strerror(errno);
+                }
+                _link_fd = std::move(link_fd.value());
+        }
+
+        void setup_busy_poll() {
+                const char* env_usec = std::getenv("XDP_BUSY_POLL");
+                int         usec     = env_usec ? std::atoi(env_usec) : 0;
+                if (usec <= 0) return;
+
+                int one = 1, budget = BUSY_BUDGET;
+                if (setsockopt(_fd.get_fd(), SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)) < 0 ||
+                    setsockopt(_fd.get_fd(), SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0 ||
+                    setsockopt(_fd.get_fd(), SOL_SOCKET, SO_BUSY_POLL_BUDGET, &budget, sizeof(budget)) < 0) {
+                        LOG(ERROR) << "[XDP BUSY POLL] " << strerror(errno);
+                        return;
+                }
+                // Every poll() busy-polls the queue, so never sleep in it
+                event_loop::instance().register_idle_check([]() { return true; });
+        }
+
+        void init() {
+                const char* iface = configured_iface();
+                _dev_name         = iface ? iface : "veth0";
+                const char* queue = std::getenv("XDP_QUEUE");
+                _queue            = queue ? std::atoi(queue) : 0;
+                const char* mode  = std::getenv("XDP_MODE");
+                bool native       = mode && std::string(mode) == "native";
+
+                auto fd = file_desc::from_fd(::socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0));
+                if (!fd) {
+                        LOG(FATAL) << "[INIT FAIL] " << strerror(errno);
+                        return;
+                }
+                _fd = std::move(fd.value());
+
+                DLOG(INFO) << "[DEV FD] " << _fd.get_fd();
+
+                set_mac_addr();
+                if (utils::set_interface_up(_dev_name) != 0) {
+                        LOG(FATAL) << "[SET UP] ";
+                        return;
+                }
+                setup_umem();
+                setup_rings();
+                bind_socket(native);
+                attach_program(native);
+                setup_busy_poll();
+                refill();
+
+                DLOG(INFO) << "[INIT MAC] " << _mac_addr.value();
+                _available = true;
+        }
+
+        // Free pool frames to the fill ring, keeping TX_RESERVE for transmit
+        void refill() {
+                packet_pool& pool  = packet_pool::instance();
+                uint32_t     count = 0;
+                uint32_t     room  = _fill.free();
+                while (count < room && pool.free_frames() > TX_RESERVE) {
+                        _fill.at<uint64_t>(_fill.cached++) = pool.take_frame() - _umem;
+                        count++;
+                }
+                if (count) {
+                        _fill.publish_produced();
+                } else if (room == RING_SIZE) {
+                        _stats.fill_empty++;
+                }
+        }
+
+        void reclaim_completions() {
+                packet_pool& pool  = packet_pool::instance();
+                uint32_t     count = _completion.available();
+                for (uint32_t i = 0; i < count; i++) {
+                        pool.give_frame(_umem + _completion.at<uint64_t>(_completion.cached++));
+                }
+                if (count) _completion.publish_consumed();
+        }
+
+        void receive_batch() {
+                packet_pool& pool  = packet_pool::instance();
+                uint32_t     count = _rx.available();
+                for (uint32_t i = 0; i < count; i++) {
+                        const xdp_desc& desc = _rx.at<xdp_desc>(_rx.cached++);
+                        uint8_t*        data = _umem + desc.addr;
+                        int             len  = desc.len;
+
+                        std::unique_ptr<base_packet> buffer;
+                        if (pool.free_frames() < FILL_LOW_WATER) {
+                                buffer = std::make_unique<base_packet>(len, pool);
+                                memcpy(buffer->get_pointer(), data, len);
+                                pool.give_frame(data);
+                                _stats.rx_copied++;
+                        } else {
+                                buffer = std::make_unique<base_packet>(pool.wrap_frame(data), len, pool);
+                        }
+                        DLOG(INFO) << "[XDP RECEIVE] " << len;
+                        _stats.rx_frames++;
+                        raw_packet r_packet = {.buffer = std::move(buffer)};
+                        _receiver_func.value()(std::move(r_packet));
+                }
+                if (count) _rx.publish_consumed();
+                refill();
+        }
+
+        // True when the TX ring or the UMEM ran out before the stack did (see register_tuntap)
+        bool transmit_batch() {
+                reclaim_completions();
+
+                packet_pool& pool   = packet_pool::instance();
+                uint32_t     queued = 0;
+                uint32_t     room   = _tx.free();
+                bool         more   = true;
+                while (queued < room) {
+                        uint8_t* frame = pool.take_frame();
+                        if (!frame) break;
+                        std::optional<raw_packet> r_packet = _provider_func.value()();
+                        if (!r_packet) {
+                                pool.give_frame(frame);
+                                more = false;
+                                break;
+                        }
+
+                        int len = FRAME_SIZE;
+                        if (r_packet->buffer->is_contiguous()) {
+                                base_packet& buffer = *r_packet->buffer;
+                                len                 = std::min(len, buffer.get_remaining_len());
+                                memcpy(frame, buffer.get_pointer(), len);
+                        } else {
+                                r_packet->buffer->export_data(frame, len);
+                        }
+                        DLOG(INFO) << "[XDP WRITE] " << len;
+
+                        xdp_desc& desc = _tx.at<xdp_desc>(_tx.cached++);
+                        desc.addr      = frame - _umem;
+                        desc.len       = len;
+                        desc.options   = 0;
+                        queued++;
+                }
+                if (queued == 0) return more;
+
+                _tx.publish_produced();
+                _stats.tx_frames += queued;
+                if (_tx.needs_wakeup()) {
+                        _stats.tx_kicks++;
+                        if (sendto(_fd.get_fd(), nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 && errno != EAGAIN &&
+                            errno != EBUSY && errno != ENOBUFS) {
+                                DLOG(ERROR) << "[XDP KICK] " << strerror(errno);
+                        }
+                }
+                return more;
+        }
+
+public:
+        std::optional<mac_addr_t> get_mac_addr() { return _mac_addr; }
+
+        std::optional<ipv4_addr_t> get_ipv4_addr() { return _ipv4_addr; }
+
+        void set_ipv4_addr(ipv4_addr_t ipv4_addr) { _ipv4_addr = ipv4_addr; }
+
+        const stats_t& get_stats() const { return _stats; }
+
+        template <typename Protocol>
+        void register_upper_protocol(Protocol& protocol) {
+                _provider_func = [&protocol]() { return protocol.gather_packet(); };
+                _receiver_func = [&protocol](raw_packet r_packet) {
+                        protocol.receive(std::move(r_packet));
+                };
+        }
+
+        void run() {
+                if (!_fd || !_umem) {
+                        LOG(FATAL) << "[FILE DESC FAIL]";
+                        return;
+                }
+                if (!_provider_func || !_receiver_func) {
+                        LOG(FATAL) << "[NO UPPER PROTOCOL]";
+                        return;
+                }
+
+                auto& evloop = event_loop::instance();
+
+                // POLLIN: RX descriptors, POLLOUT: room in the TX ring
+                evloop.register_tuntap(
+                        _fd.get_fd(), [this]() { receive_batch(); }, [this]() { return transmit_batch(); });
+
+                // Transfer control to event loop
+                evloop.run();
+        }
+};
+};  // namespace uStack
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <cstdlib>
+#include <functional>
+#include <optional>
+
+#include "file_desc.hpp"
+#include "ipv4.hpp"
+#include "ipv4_addr.hpp"
+#include "mac_addr.hpp"
+#include "packets.hpp"
+#include "utils.hpp"
+#include "event_loop.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* packet_ring_doc = R"(
+FILE: packet_ring.hpp
+PURPOSE: AF_PACKET device on an existing interface (PACKET_IFACE, e.g. one end of a veth pair)
+with TPACKET_V3 mmap rings. Same contract as tuntap: register_upper_protocol(), run(),
+get_mac_addr(), get_ipv4_addr().
+- RX: block ring; poll() wakes once per retired block (full, or after RX_BLOCK_TIMEOUT_MS),
+  every frame in the block is handed up before the block goes back to the kernel
+- TX: frame ring; the write handler fills every free frame the stack has packets for,
+  then one sendto() kick sends the batch
+- Frames are copied out of the RX block into pooled buffers (TCP may keep them queued
+  for the application, which would pin the whole block)
+- Uses the interface MAC; leave the interface without an IP address so the kernel
+  does not answer for the stack (the kernel still sees every frame)
+- Disable GRO on the interface (ethtool -K <iface> gro off): merged frames larger
+  than a pool buffer are dropped
+- Requires root or CAP_NET_RAW
+)";
+}
+
+template <int mtu>
+class packet_ring {
+public:
+        constexpr static int MTU = mtu;
+        constexpr static int TAG = TUNTAP_DEV;  // The stack's one device
+        static_assert(MTU <= packet_pool::BUFFER_SIZE, "received frames are copied into pooled buffers");
+
+        constexpr static uint32_t RX_BLOCK_SIZE       = 1 << 18;
+        constexpr static uint32_t RX_BLOCK_COUNT      = 64;
+        constexpr static uint32_t RX_BLOCK_TIMEOUT_MS = 1;
+        constexpr static uint32_t TX_BLOCK_SIZE       = 1 << 18;
+        constexpr static uint32_t TX_BLOCK_COUNT      = 8;
+        constexpr static uint32_t FRAME_SIZE          = 2048;
+        constexpr static uint32_t TX_DATA_OFFSET      = TPACKET_ALIGN(sizeof(tpacket3_hdr));
+        static_assert(TX_DATA_OFFSET + ETH_HLEN + MTU <= FRAME_SIZE, "a TX frame holds one Ethernet frame");
+
+        struct stats_t {
+                uint64_t rx_blocks  = 0;
+                uint64_t rx_frames  = 0;
+                uint64_t rx_dropped = 0;  // Oversized frames
+                uint64_t tx_frames  = 0;
+                uint64_t tx_kicks   = 0;
+        };
+
+private:
+        file_desc                  _fd;
+        std::optional<mac_addr_t>  _mac_addr;
+        std::optional<ipv4_addr_t> _ipv4_addr;
+        std::string                _dev_name;
+        int                        _ifindex = 0;
+
+        bool     _available = false;
+        uint8_t* _map       = nullptr;
+        size_t   _map_len   = 0;
+        uint8_t* _rx_ring   = nullptr;
+        uint8_t* _tx_ring   = nullptr;
+        uint32_t _rx_block  = 0;  // Next block to look at
+        uint32_t _tx_frame  = 0;  // Next frame to fill
+        uint32_t _tx_frames = 0;
+        stats_t  _stats;
+
+        using packet_provider_type = std::function<std::optional<raw_packet>(void)>;
+        using packet_receiver_type = std::function<void(raw_packet)>;
+
+        std::optional<packet_provider_type> _provider_func;
+        std::optional<packet_receiver_type> _receiver_func;
+
+private:
+        ~packet_ring() {
+                if (_map) munmap(_map, _map_len);
+        }
+
+        packet_ring() { init(); }
+
+public:
+        packet_ring(const packet_ring&) = delete;
+        packet_ring(packet_ring&&)      = delete;
+        packet_ring& operator=(const packet_ring&) = delete;
+        packet_ring& operator=(packet_ring&& x) = delete;
+
+        static packet_ring& instance() {
+                static packet_ring instance;
+                return instance;
+        }
+
+        operator bool() { return _available; }
+
+        // Interface the device binds to, nullptr: the TAP device is used instead
+        static const char* configured_iface() { return std::getenv("PACKET_IFACE"); }
+
+private:
+        void set_mac_addr() {
+                struct ifreq ifr = {};
+                strncpy(ifr.ifr_name, _dev_name.c_str(), IFNAMSIZ - 1);
+
+                if (_fd.ioctl(SIOCGIFINDEX, ifr) < 0) {
+                        LOG(FATAL) << "[NO IFACE] " << _dev_name;
+                }
+                _ifindex = ifr.ifr_ifindex;
+
+                if (_fd.ioctl(SIOCGIFHWADDR, ifr) < 0) {
+                        LOG(FATAL) << "[HW FAIL]";
+                }
+                std::array<uint8_t, 6> hw_addr;
+                for (int i = 0; i < 6; ++i) {
+                        hw_addr[i] = ifr.ifr_addr.sa_data[i];
+                }
+                _mac_addr = mac_addr_t(hw_addr);
+        }
+
+        void setup_rings() {
+                int fd      = _fd.get_fd();
+                int version = TPACKET_V3;
+                if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+                        LOG(FATAL) << "[TPACKET_V3] " << strerror(errno);
+                }
+
+                tpacket_req3 rx = {};
+                rx.tp_block_size     = RX_BLOCK_SIZE;
+                rx.tp_block_nr       = RX_BLOCK_COUNT;
+                rx.tp_frame_size     = FRAME_SIZE;
+                rx.tp_frame_nr       = RX_BLOCK_SIZE / FRAME_SIZE * RX_BLOCK_COUNT;
+                rx.tp_retire_blk_tov = RX_BLOCK_TIMEOUT_MS;
+                if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &rx, sizeof(rx)) < 0) {
+                        LOG(FATAL) << "[RX RING] " << strerror(errno);
+                }
+
+                tpacket_req3 tx = {};
+                tx.tp_block_size = TX_BLOCK_SIZE;
+                tx.tp_block_nr   = TX_BLOCK_COUNT;
+                tx.tp_frame_size = FRAME_SIZE;
+                tx.tp_frame_nr   = TX_BLOCK_SIZE / FRAME_SIZE * TX_BLOCK_COUNT;
+                if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &tx, sizeof(tx)) < 0) {
+                        LOG(FATAL) << "[TX RING] " << strerror(errno);
+                }
+                _tx_frames = tx.tp_frame_nr;
+
+                // The RX ring comes first in the mapping, the TX ring right after it
+                _map_len = size_t(RX_BLOCK_SIZE) * RX_BLOCK_COUNT + size_t(TX_BLOCK_SIZE) * TX_BLOCK_COUNT;
+                void* map = mmap(nullptr, _map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+                if (map == MAP_FAILED) {
+                        map = mmap(nullptr, _map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                }
+                if (map == MAP_FAILED) {
+                        LOG(FATAL) << "[RING MMAP] " << strerror(errno);
+                }
+                _map     = static_cast<uint8_t*>(map);
+                _rx_ring = _map;
+                _tx_ring = _map + size_t(RX_BLOCK_SIZE) * RX_BLOCK_COUNT;
+
+                // Frames skip the qdisc layer; best effort (older kernels lack it)
+                int one = 1;
+                setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+        }
+
+        void init() {
+                const char* iface = configured_iface();
+                _dev_name         = iface ? iface : "veth0";
+
+                auto fd = file_desc::from_fd(::socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK, htons(ETH_P_ALL)));
+                if (!fd) {
+                        LOG(FATAL) << "[INIT FAIL] " << strerror(errno);
+                        return;
+                }
+                _fd = std::move(fd.value());
+
+                DLOG(INFO) << "[DEV FD] " << _fd.get_fd();
+
+                set_mac_addr();
+                setup_rings();
+
+                sockaddr_ll addr = {};
+                addr.sll_family   = AF_PACKET;
+                addr.sll_protocol = htons(ETH_P_ALL);
+                addr.sll_ifindex  = _ifindex;
+                if (bind(_fd.get_fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                        LOG(FATAL) << "[BIND FAIL] " << _dev_name << " " << strerror(errno);
+                        return;
+                }
+
+                if (utils::set_interface_up(_dev_name) != 0) {
+                        LOG(FATAL) << "[SET UP] ";
+                        return;
+                }
+
+                DLOG(INFO) << "[INIT MAC] " << _mac_addr.value();
+                _available = true;
+        }
+
+        tpacket_block_desc* rx_block(uint32_t index) {
+                return reinterpret_cast<tpacket_block_desc*>(_rx_ring + size_t(index) * RX_BLOCK_SIZE);
+        }
+
+        tpacket3_hdr* tx_frame(uint32_t index) {
+                // Frames never straddle blocks: FRAME_SIZE divides TX_BLOCK_SIZE
+                return reinterpret_cast<tpacket3_hdr*>(_tx_ring + size_t(index) * FRAME_SIZE);
+        }
+
+        static bool tx_frame_free(tpacket3_hdr* hdr) {
+                uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+                return status == TP_STATUS_AVAILABLE || status == TP_STATUS_WRONG_FORMAT;
+        }
+
+        // Every block the kernel has retired, in ring order
+        void receive_blocks() {
+                for (;;) {
+                        tpacket_block_desc* block = rx_block(_rx_block);
+                        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                                return;
+                        }
+
+                        uint32_t frames = block->hdr.bh1.num_pkts;
+                        auto*    hdr    = reinterpret_cast<tpacket3_hdr*>(
+                                reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+                        for (uint32_t i = 0; i < frames; i++) {
+                                receive_frame(hdr);
+                                hdr = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(hdr) + hdr->tp_next_offset);
+                        }
+                        _stats.rx_blocks++;
+
+                        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+                        _rx_block = (_rx_block + 1) % RX_BLOCK_COUNT;
+                }
+        }
+
+        void receive_frame(tpacket3_hdr* hdr) {
+                // Frames the stack sent itself show up on the socket too
+                auto* ll = reinterpret_cast<sockaddr_ll*>(reinterpret_cast<uint8_t*>(hdr) + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+                if (ll->sll_pkttype == PACKET_OUTGOING) return;
+
+                int len = hdr->tp_snaplen;
+                if (len > packet_pool::BUFFER_SIZE) {
+                        _stats.rx_dropped++;
+                        return;
+                }
+                auto buffer = std::make_unique<base_packet>(len, packet_pool::instance());
+                memcpy(buffer->get_pointer(), reinterpret_cast<uint8_t*>(hdr) + hdr->tp_mac, len);
+                DLOG(INFO) << "[PACKET RING RECEIVE] " << len;
+                _stats.rx_frames++;
+                raw_packet r_packet = {.buffer = std::move(buffer)};
+                _receiver_func.value()(std::move(r_packet));
+        }
+
+        // Fill free TX frames while the stack has packets, then kick once; true when the
+        // frames ran out first (see register_tuntap)
+        bool transmit_batch() {
+                uint32_t queued = 0;
+                bool     more   = true;
+                while (queued < _tx_frames) {
+                        tpacket3_hdr* hdr = tx_frame(_tx_frame);
+                        if (!tx_frame_free(hdr)) break;
+
+                        std::optional<raw_packet> r_packet = _provider_func.value()();
+                        if (!r_packet) {
+                                more = false;
+                                break;
+                        }
+
+                        uint8_t* data = reinterpret_cast<uint8_t*>(hdr) + TX_DATA_OFFSET;
+                        int      len  = FRAME_SIZE - TX_DATA_OFFSET;
+                        if (r_packet->buffer->is_contiguous()) {
+                                base_packet& buffer = *r_packet->buffer;
+                                len                 = std::min(len, buffer.get_remaining_len());
+                                memcpy(data, buffer.get_pointer(), len);
+                        } else {
+                                r_packet->buffer->export_data(data, len);
+                        }
+                        DLOG(INFO) << "[PACKET RING WRITE] " << len;
+
+                        hdr->tp_len         = len;
+                        hdr->tp_snaplen     = len;
+                        hdr->tp_next_offset = 0;
+                        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+                        _tx_frame = (_tx_frame + 1) % _tx_frames;
+                        queued++;
+                }
+                if (queued == 0) return more;
+
+                _stats.tx_frames += queued;
+                _stats.tx_kicks++;
+                if (sendto(_fd.get_fd(), nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 && errno != EAGAIN &&
+                    errno != ENOBUFS) {
+                        DLOG(ERROR) << "[PACKET RING KICK] " << strerror(errno);
+                }
+                return more;
+        }
+
+public:
+        std::optional<mac_addr_t> get_mac_addr() { return _mac_addr; }
+
+        std::optional<ipv4_addr_t> get_ipv4_addr() { return _ipv4_addr; }
+
+        void set_ipv4_addr(ipv4_addr_t ipv4_addr) { _ipv4_addr = ipv4_addr; }
+
+        const stats_t& get_stats() const { return _stats; }
+
+        template <typename Protocol>
+        void register_upper_protocol(Protocol& protocol) {
+                _provider_func = [&protocol]() { return protocol.gather_packet(); };
+                _receiver_func = [&protocol](raw_packet r_packet) {
+                        protocol.receive(std::move(r_packet));
+                };
+        }
+
+        void run() {
+                if (!_fd || !_map) {
+                        LOG(FATAL) << "[FILE DESC FAIL]";
+                        return;
+                }
+                if (!_provider_func || !_receiver_func) {
+                        LOG(FATAL) << "[NO UPPER PROTOCOL]";
+                        return;
+                }
+
+                auto& evloop = event_loop::instance();
+
+                // POLLIN: a retired RX block, POLLOUT: a free TX frame
+                evloop.register_tuntap(
+                        _fd.get_fd(), [this]() { receive_blocks(); }, [this]() { return transmit_batch(); });
+
+                // Transfer control to event loop
+                evloop.run();
+        }
+};
+};  // namespace uStack
@@ -7,6 +7,9 @@
 
 #include <functional>
 #include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "file_desc.hpp"
 #include "ipv4.hpp"
@@ -14,6 +17,7 @@
 #include "mac_addr.hpp"
 #include "packets.hpp"
 #include "utils.hpp"
+#include "uring.hpp"
 #include "event_loop.hpp"
 
 namespace uStack {
@@ -25,6 +29,10 @@ PURPOSE: TAP device interface. Methods: init(), run(), get_mac_addr(), get_ipv4_
 - run() blocks in event loop
 - poll() handles kernel-level multiplexing
 - Single-threaded protocol processing
+- TAP_IO_URING=1: one io_uring carries the device I/O and the event loop's wait.
+  RX_DEPTH reads into pooled buffers stay posted, TX frames are staged in registered
+  (fixed) buffers and written in batches, wakeup fds are POLL_ADDs and the loop's
+  poll timeout a TIMEOUT on the same ring; one io_uring_enter() per iteration
 
 CURRENT IMPLEMENTATION NOTES:
 - Fixed device name (tap0)
@@ -40,7 +48,7 @@ CURRENT IMPLEMENTATION NOTES:
 
 PERFORMANCE CHARACTERISTICS:
 - poll() latency: ~1ms kernel call overhead
-- Copy latency: ~microseconds for MTU-sized packets
+- Copy latency: ~microseconds for MTU-sized packets (transmit; frames are read into pooled buffers)
 - Throughput: Limited by kernel tun/tap implementation
 - CPU: Single-core CPU loop (could parallelize with epoll)
 
@@ -57,6 +65,7 @@ class tuntap {
 public:
         constexpr static int MTU = mtu;
         constexpr static int TAG = TUNTAP_DEV;
+        static_assert(MTU <= packet_pool::BUFFER_SIZE, "received frames are read into pooled buffers");
 
 private:
         file_desc                  _fd;
@@ -67,6 +76,30 @@ private:
         bool    _available = false;
         uint8_t _buf[MTU];
 
+        constexpr static int TX_BATCH = 64;  // Frames written per write handler call
+
+        // io_uring mode (TAP_IO_URING=1)
+        constexpr static int      RX_DEPTH   = 256;  // Reads kept posted
+        constexpr static int      TX_DEPTH   = 256;  // Registered TX staging buffers
+        constexpr static uint64_t URING_RX   = 1ULL << 56;
+        constexpr static uint64_t URING_TX   = 2ULL << 56;
+        constexpr static uint64_t URING_POLL = 3ULL << 56;
+        constexpr static uint64_t URING_TIMER = 4ULL << 56;
+        constexpr static uint64_t URING_KIND = 0xFFULL << 56;
+
+        struct uring_state_t {
+                uring                                     ring;
+                std::vector<std::unique_ptr<base_packet>> rx_slots;  // Buffers of posted reads
+                std::vector<raw_packet>                   rx_ready;  // Completed, not handed up yet
+                std::unique_ptr<uint8_t[]>                tx_arena;  // TX_DEPTH registered buffers
+                std::vector<int>                          tx_free;
+                std::unordered_set<int>                   polled;    // Wakeup fds with a POLL_ADD in flight
+                std::unordered_map<int, short>            revents;   // Poll results for the next return
+                bool                                      timer_armed = false;
+                __kernel_timespec                         timer_ts    = {};
+        };
+        std::unique_ptr<uring_state_t> _uring;
+
         using packet_provider_type = std::function<std::optional<raw_packet>(void)>;
         using packet_receiver_type = std::function<void(raw_packet)>;
 
@@ -172,7 +205,16 @@ public:
                 };
         }
 
+        static bool io_uring_requested() {
+                const char* env_mode = std::getenv("TAP_IO_URING");
+                return env_mode && std::atoi(env_mode) != 0;
+        }
+
         void run() {
+                if (io_uring_requested()) {
+                        run_uring();
+                        return;
+                }
                 if (!_fd) {
                         LOG(FATAL) << "[FILE DESC FAIL]";
                         return;
@@ -193,23 +235,41 @@ public:
                         // Read handler (POLLIN)
                         [this, base_fd]() {
                                 if (_receiver_func) {
-                                        int len = MTU;
-                                        int n = read(base_fd, reinterpret_cast<char*>(_buf), len);
+                                        // Read straight into a pooled buffer; TCP queues
+                                        // this same buffer for the application
+                                        auto buffer = std::make_unique<base_packet>(
+                                                MTU, packet_pool::instance());
+                                        int n = read(base_fd, reinterpret_cast<char*>(buffer->get_pointer()), MTU);
                                         DLOG(INFO) << "[TUNTAP RECEIVE] " << n;
-                                        raw_packet r_packet = encode_raw_packet(
-                                                reinterpret_cast<uint8_t*>(_buf), n);
+                                        if (n <= 0) {
+                                                return;
+                                        }
+                                        buffer->set_len(n);
+                                        raw_packet r_packet = {.buffer = std::move(buffer)};
                                         _receiver_func.value()(std::move(r_packet));
                                 } else {
                                         LOG(FATAL) << "[NO RECEIVER FUNC]";
                                 }
                         },
-                        // Write handler (POLLOUT)
+                        // Write handler: before every poll and on POLLOUT, up to TX_BATCH frames
                         [this, base_fd]() {
-                                if (_provider_func) {
+                                if (!_provider_func) {
+                                        LOG(FATAL) << "[NO PROVIDER FUNC]";
+                                        return false;
+                                }
+                                for (int sent = 0; sent < TX_BATCH; sent++) {
                                         std::optional<raw_packet> r_packet =
                                                 _provider_func.value()();
-
-                                        if (r_packet) {
+                                        if (!r_packet) return false;
+
+                                        if (r_packet->buffer->is_contiguous()) {
+                                                // Frame is a single buffer (e.g. a bounced ICMP
+                                                // echo): write it without staging it in _buf
+                                                base_packet& buffer = *r_packet->buffer;
+                                                DLOG(INFO) << "[TUNTAP WRITE] " << buffer.get_remaining_len();
+                                                write(base_fd, buffer.get_pointer(),
+                                                      buffer.get_remaining_len());
+                                        } else {
                                                 int len = MTU;
                                                 decode_raw_packet(r_packet.value(),
                                                                   reinterpret_cast<uint8_t*>(_buf),
@@ -217,14 +277,188 @@ public:
                                                 DLOG(INFO) << "[TUNTAP WRITE] " << len;
                                                 write(base_fd, _buf, len);
                                         }
-                                } else {
-                                        LOG(FATAL) << "[NO PROVIDER FUNC]";
                                 }
+                                return true;  // Batch used up, the stack may have more
                         }
                 );
 
                 // Transfer control to event loop
                 evloop.run();
         }
+
+private:
+        void post_read(int slot) {
+                io_uring_sqe* sqe = uring_sqe();
+                auto&         rx  = _uring->rx_slots[slot];
+                rx                = std::make_unique<base_packet>(MTU, packet_pool::instance());
+                sqe->opcode       = IORING_OP_READ;
+                sqe->fd           = _fd.get_fd();
+                sqe->addr         = reinterpret_cast<uint64_t>(rx->get_pointer());
+                sqe->len          = MTU;
+                sqe->user_data    = URING_RX | slot;
+        }
+
+        // An SQE, flushing the SQ to the kernel first when it is full
+        io_uring_sqe* uring_sqe() {
+                io_uring_sqe* sqe = _uring->ring.get_sqe();
+                while (!sqe) {
+                        _uring->ring.submit(false);
+                        sqe = _uring->ring.get_sqe();
+                }
+                return sqe;
+        }
+
+        // Stage every packet the stack has into free TX buffers
+        void transmit_uring() {
+                while (!_uring->tx_free.empty()) {
+                        std::optional<raw_packet> r_packet = _provider_func.value()();
+                        if (!r_packet) return;
+
+                        int      slot = _uring->tx_free.back();
+                        uint8_t* buf  = _uring->tx_arena.get() + size_t(slot) * packet_pool::BUFFER_SIZE;
+                        int      len  = packet_pool::BUFFER_SIZE;
+                        if (r_packet->buffer->is_contiguous()) {
+                                base_packet& buffer = *r_packet->buffer;
+                                len                 = std::min(len, buffer.get_remaining_len());
+                                memcpy(buf, buffer.get_pointer(), len);
+                        } else {
+                                decode_raw_packet(r_packet.value(), buf, len);
+                        }
+                        _uring->tx_free.pop_back();
+                        DLOG(INFO) << "[TUNTAP WRITE] " << len;
+
+                        io_uring_sqe* sqe = uring_sqe();
+                        sqe->opcode       = IORING_OP_WRITE_FIXED;
+                        sqe->fd           = _fd.get_fd();
+                        sqe->addr         = reinterpret_cast<uint64_t>(buf);
+                        sqe->len          = len;
+                        sqe->buf_index    = 0;
+                        sqe->user_data    = URING_TX | slot;
+                }
+        }
+
+        void complete_uring(const io_uring_cqe& cqe) {
+                uint64_t kind = cqe.user_data & URING_KIND;
+                int      id   = static_cast<int>(cqe.user_data & ~URING_KIND);
+                if (kind == URING_RX) {
+                        if (cqe.res > 0) {
+                                auto buffer = std::move(_uring->rx_slots[id]);
+                                buffer->set_len(cqe.res);
+                                DLOG(INFO) << "[TUNTAP RECEIVE] " << cqe.res;
+                                _uring->rx_ready.push_back({.buffer = std::move(buffer)});
+                        } else if (cqe.res != -EAGAIN && cqe.res != -EINTR) {
+                                LOG(ERROR) << "[TUNTAP READ] " << strerror(-cqe.res);
+                                return;  // Slot retired
+                        }
+                        post_read(id);
+                } else if (kind == URING_TX) {
+                        if (cqe.res < 0) DLOG(ERROR) << "[TUNTAP WRITE FAIL] " << strerror(-cqe.res);
+                        _uring->tx_free.push_back(id);
+                } else if (kind == URING_POLL) {
+                        _uring->polled.erase(id);
+                        if (cqe.res > 0) _uring->revents[id] |= cqe.res;
+                } else if (kind == URING_TIMER) {
+                        _uring->timer_armed = false;
+                }
+        }
+
+        // event_loop poll_func: flush TX, arm polls and the timeout, then one io_uring_enter()
+        int poll_uring(pollfd* fds, nfds_t nfds, int timeout) {
+                transmit_uring();
+
+                std::unordered_set<int> wanted;
+                for (nfds_t i = 1; i < nfds; i++) {
+                        int fd = fds[i].fd;
+                        wanted.insert(fd);
+                        if (!_uring->polled.insert(fd).second) continue;
+                        io_uring_sqe* sqe  = uring_sqe();
+                        sqe->opcode        = IORING_OP_POLL_ADD;
+                        sqe->fd            = fd;
+                        sqe->poll32_events = fds[i].events;
+                        sqe->user_data     = URING_POLL | fd;
+                }
+                // Unregistered wakeup fds: their POLL_ADD completes with -ECANCELED
+                for (int fd : _uring->polled) {
+                        if (wanted.count(fd)) continue;
+                        io_uring_sqe* sqe = uring_sqe();
+                        sqe->opcode       = IORING_OP_POLL_REMOVE;
+                        sqe->fd           = -1;
+                        sqe->addr         = URING_POLL | fd;
+                }
+
+                bool wait = timeout != 0 && _uring->rx_ready.empty() && _uring->revents.empty();
+                if (wait && !_uring->timer_armed) {
+                        _uring->timer_ts  = {.tv_sec = timeout / 1000, .tv_nsec = (timeout % 1000) * 1000000LL};
+                        io_uring_sqe* sqe = uring_sqe();
+                        sqe->opcode       = IORING_OP_TIMEOUT;
+                        sqe->addr         = reinterpret_cast<uint64_t>(&_uring->timer_ts);
+                        sqe->len          = 1;
+                        sqe->user_data    = URING_TIMER;
+                        _uring->timer_armed = true;
+                }
+                if (_uring->ring.submit(wait) < 0) {
+                        LOG(ERROR) << "[IO_URING ENTER] " << strerror(errno);
+                        return -1;
+                }
+                _uring->ring.for_each_cqe([this](const io_uring_cqe& cqe) { complete_uring(cqe); });
+                for (auto it = _uring->polled.begin(); it != _uring->polled.end();) {
+                        it = wanted.count(*it) ? std::next(it) : _uring->polled.erase(it);
+                }
+
+                int ready      = 0;
+                fds[0].revents = _uring->rx_ready.empty() ? 0 : POLLIN;
+                ready += fds[0].revents != 0;
+                for (nfds_t i = 1; i < nfds; i++) {
+                        auto it         = _uring->revents.find(fds[i].fd);
+                        fds[i].revents  = it == _uring->revents.end() ? 0 : it->second;
+                        ready          += fds[i].revents != 0;
+                }
+                _uring->revents.clear();
+                return ready;
+        }
+
+        void run_uring() {
+                if (!_fd || !_provider_func || !_receiver_func) {
+                        LOG(FATAL) << "[FILE DESC FAIL]";
+                        return;
+                }
+
+                _uring = std::make_unique<uring_state_t>();
+                if (_uring->ring.init(RX_DEPTH + TX_DEPTH + 64) < 0) {
+                        LOG(FATAL) << "[IO_URING SETUP] " << strerror(errno);
+                        return;
+                }
+                _uring->tx_arena = std::make_unique<uint8_t[]>(size_t(TX_DEPTH) * packet_pool::BUFFER_SIZE);
+                iovec arena      = {.iov_base = _uring->tx_arena.get(),
+                                    .iov_len  = size_t(TX_DEPTH) * packet_pool::BUFFER_SIZE};
+                if (_uring->ring.register_buffers(&arena, 1) < 0) {
+                        LOG(FATAL) << "[IO_URING BUFFERS] " << strerror(errno);
+                        return;
+                }
+                // Reads on an O_NONBLOCK fd would complete with -EAGAIN instead of waiting
+                int flags = fcntl(_fd.get_fd(), F_GETFL);
+                fcntl(_fd.get_fd(), F_SETFL, flags & ~O_NONBLOCK);
+
+                for (int i = TX_DEPTH - 1; i >= 0; i--) _uring->tx_free.push_back(i);
+                _uring->rx_slots.resize(RX_DEPTH);
+                for (int i = 0; i < RX_DEPTH; i++) post_read(i);
+
+                auto& evloop = event_loop::instance();
+
+                // Not pollable: completions arrive through poll_uring(); TX is flushed there too
+                evloop.register_tuntap(
+                        -1,
+                        [this]() {
+                                std::vector<raw_packet> ready;
+                                ready.swap(_uring->rx_ready);
+                                for (auto& r_packet : ready) _receiver_func.value()(std::move(r_packet));
+                        },
+                        nullptr);
+                evloop.register_poll_func(
+                        [this](pollfd* fds, nfds_t nfds, int timeout) { return poll_uring(fds, nfds, timeout); });
+
+                // Transfer control to event loop
+                evloop.run();
+        }
 };
 };  // namespace uStack
\ No newline at end of file
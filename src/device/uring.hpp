@@ -0,0 +1,160 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace uStack {
+
+namespace docs {
+static const char* uring_doc = R"(
+FILE: uring.hpp
+PURPOSE: Minimal io_uring wrapper (raw syscalls, no liburing). Methods: init(), get_sqe(), pending(), submit(), for_each_cqe(), register_buffers().
+- get_sqe() hands out zeroed SQEs, nullptr when the SQ is full (submit() first)
+- submit(wait) publishes the SQ tail and enters the kernel once: submits everything
+  queued and, with wait, sleeps until at least one completion
+- for_each_cqe() drains the CQ in order; handlers may queue new SQEs
+- Used by tuntap's io_uring mode (TAP_IO_URING=1)
+)";
+}
+
+class uring {
+private:
+        int _fd = -1;
+
+        // SQ ring
+        void*                  _sq_map     = nullptr;
+        size_t                 _sq_map_len = 0;
+        std::atomic<uint32_t>* _sq_head    = nullptr;
+        std::atomic<uint32_t>* _sq_tail    = nullptr;
+        uint32_t*              _sq_array   = nullptr;
+        uint32_t               _sq_mask    = 0;
+        uint32_t               _sq_entries = 0;
+        uint32_t               _sq_local   = 0;  // Tail including SQEs not yet published
+        io_uring_sqe*          _sqes       = nullptr;
+        size_t                 _sqes_len   = 0;
+
+        // CQ ring
+        void*                  _cq_map     = nullptr;
+        size_t                 _cq_map_len = 0;
+        std::atomic<uint32_t>* _cq_head    = nullptr;
+        std::atomic<uint32_t>* _cq_tail    = nullptr;
+        uint32_t               _cq_mask    = 0;
+        io_uring_cqe*          _cqes       = nullptr;
+
+public:
+        uring() = default;
+        ~uring() {
+                if (_sqes) munmap(_sqes, _sqes_len);
+                if (_cq_map && _cq_map != _sq_map) munmap(_cq_map, _cq_map_len);
+                if (_sq_map) munmap(_sq_map, _sq_map_len);
+                if (_fd >= 0) close(_fd);
+        }
+        uring(const uring&)            = delete;
+        uring(uring&&)                 = delete;
+        uring& operator=(const uring&) = delete;
+        uring& operator=(uring&&)      = delete;
+
+        // 0, or -1 with errno set
+        int init(uint32_t entries) {
+                io_uring_params params = {};
+                params.flags           = IORING_SETUP_CQSIZE;
+                params.cq_entries      = entries * 2;
+                _fd                    = syscall(__NR_io_uring_setup, entries, &params);
+                if (_fd < 0) return -1;
+
+                _sq_map_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+                _cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                        _sq_map_len = _cq_map_len = std::max(_sq_map_len, _cq_map_len);
+                }
+                _sq_map = mmap(nullptr, _sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                               IORING_OFF_SQ_RING);
+                if (_sq_map == MAP_FAILED) {
+                        _sq_map = nullptr;
+                        return -1;
+                }
+                if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                        _cq_map = _sq_map;
+                } else {
+                        _cq_map = mmap(nullptr, _cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                       _fd, IORING_OFF_CQ_RING);
+                        if (_cq_map == MAP_FAILED) {
+                                _cq_map = nullptr;
+                                return -1;
+                        }
+                }
+                _sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+                void* sqes = mmap(nullptr, _sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                                  IORING_OFF_SQES);
+                if (sqes == MAP_FAILED) return -1;
+                _sqes = static_cast<io_uring_sqe*>(sqes);
+
+                auto* sq    = static_cast<uint8_t*>(_sq_map);
+                _sq_head    = reinterpret_cast<std::atomic<uint32_t>*>(sq + params.sq_off.head);
+                _sq_tail    = reinterpret_cast<std::atomic<uint32_t>*>(sq + params.sq_off.tail);
+                _sq_array   = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+                _sq_mask    = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+                _sq_entries = params.sq_entries;
+                _sq_local   = _sq_tail->load(std::memory_order_relaxed);
+                for (uint32_t i = 0; i < _sq_entries; i++) _sq_array[i] = i;  // SQE i sits in slot i
+
+                auto* cq = static_cast<uint8_t*>(_cq_map);
+                _cq_head = reinterpret_cast<std::atomic<uint32_t>*>(cq + params.cq_off.head);
+                _cq_tail = reinterpret_cast<std::atomic<uint32_t>*>(cq + params.cq_off.tail);
+                _cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+                _cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                return 0;
+        }
+
+        // Buffers for IORING_OP_READ_FIXED / WRITE_FIXED (buf_index = position in iov)
+        int register_buffers(const iovec* iov, unsigned count) {
+                return syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, iov, count);
+        }
+
+        io_uring_sqe* get_sqe() {
+                if (_sq_local - _sq_head->load(std::memory_order_acquire) >= _sq_entries) return nullptr;
+                io_uring_sqe* sqe = &_sqes[_sq_local & _sq_mask];
+                std::memset(sqe, 0, sizeof(*sqe));
+                _sq_local++;
+                return sqe;
+        }
+
+        // SQEs handed out and not yet consumed by the kernel
+        uint32_t pending() const { return _sq_local - _sq_head->load(std::memory_order_acquire); }
+
+        // One io_uring_enter(): submit what is queued, with wait block for one completion.
+        // Returns the SQEs consumed, or -1 with errno set (EINTR / ETIME are not errors)
+        int submit(bool wait) {
+                uint32_t to_submit = pending();
+                _sq_tail->store(_sq_local, std::memory_order_release);
+                if (to_submit == 0 && !wait) return 0;
+                int ret = syscall(__NR_io_uring_enter, _fd, to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0,
+                                  nullptr, 0);
+                if (ret < 0 && (errno == EINTR || errno == ETIME)) return 0;
+                return ret;
+        }
+
+        // handler(const io_uring_cqe&) for every completion, oldest first
+        template <typename Handler>
+        uint32_t for_each_cqe(Handler handler) {
+                uint32_t head  = _cq_head->load(std::memory_order_relaxed);
+                uint32_t tail  = _cq_tail->load(std::memory_order_acquire);
+                uint32_t count = tail - head;
+                for (; head != tail; head++) {
+                        io_uring_cqe cqe = _cqes[head & _cq_mask];
+                        _cq_head->store(head + 1, std::memory_order_release);
+                        handler(cqe);
+                }
+                return count;
+        }
+};
+
+}  // namespace uStack
@@ -9,8 +9,6 @@ FILE: icmp-header.hpp
 PURPOSE: ICMP header (8 bytes). Methods: consume(), produce(), size().
 )";
 }
-)";
-}
 
 struct icmp_header_t {
         uint8_t  proto_type = 0;
@@ -1,13 +1,34 @@
+#pragma once
+#include <functional>
+#include <vector>
+
 #include "base_protocol.hpp"
-#include "icmp_header.hpp"
+#include "ethernet.hpp"
+#include "icmp-header.hpp"
+#include "icmp_rate_limiter.hpp"
+#include "ipv4_header.hpp"
 #include "packets.hpp"
+#include "pmtu_cache.hpp"
 
 namespace uStack {
 
 namespace docs {
 static const char* icmp_doc = R"(
 FILE: icmp.hpp
-PURPOSE: ICMP protocol (ping). Methods: id(), make_packet(), make_icmp_reply().
+PURPOSE: ICMP protocol (ping). Methods: id(), make_packet(), make_icmp_reply(), register_frag_needed_handler(), send_error().
+
+- Echo Request (type 8) is answered with Echo Reply. The fast path
+  (bounce_echo_request) rewrites the received frame in place, patches the
+  checksums incrementally (RFC 1624) and hands the same buffer to the
+  Ethernet send queue; make_icmp_reply() is the copying fallback
+- Destination Unreachable / Fragmentation Needed (type 3 code 4) lowers the
+  PMTU cache and is handed to the registered handlers (TCP lowers the MSS)
+- send_error() builds Destination Unreachable for the IPv4
+  layer (TCP answers closed ports with a RST), quoting the offending IP header
+  + 8 bytes (RFC 792, RFC 1122 3.2.2)
+- Echo Replies and errors each go through a global + per-destination token
+  bucket (icmp_rate_limiter.hpp) and a bounded send queue, so a ping flood
+  cannot crowd TCP segments out of the IPv4 send path
 )";
 }
 
@@ -15,9 +36,231 @@ class icmp : public base_protocol<ipv4_packet, nop_packet, icmp> {
 public:
         static constexpr uint16_t PROTO = 0x01;
 
+        static constexpr uint8_t TYPE_ECHO_REPLY     = 0x00;
+        static constexpr uint8_t TYPE_DEST_UNREACH   = 0x03;
+        static constexpr uint8_t TYPE_SOURCE_QUENCH  = 0x04;
+        static constexpr uint8_t TYPE_REDIRECT       = 0x05;
+        static constexpr uint8_t TYPE_ECHO_REQUEST   = 0x08;
+        static constexpr uint8_t TYPE_TIME_EXCEEDED  = 0x0B;
+        static constexpr uint8_t TYPE_PARAM_PROBLEM  = 0x0C;
+
+        static constexpr uint8_t CODE_PROTO_UNREACH  = 0x02;
+        static constexpr uint8_t CODE_PORT_UNREACH   = 0x03;
+        static constexpr uint8_t CODE_FRAG_NEEDED    = 0x04;
+
+        // Replies waiting for the IPv4 layer beyond this are dropped
+        static constexpr int MAX_QUEUED_PACKETS = 64;
+
+        // (quoted connection, quoted sequence number, new path MTU)
+        using frag_needed_handler_type = std::function<void(two_ends_t, uint32_t, uint16_t)>;
+
+private:
+        std::vector<frag_needed_handler_type> _frag_needed_handlers;
+
+        icmp_rate_limiter echo_limiter{
+                icmp_limits::get_limit("ICMP_ECHO_RATE", icmp_limits::DEFAULT_ECHO_RATE),
+                icmp_limits::get_limit("ICMP_ECHO_RATE_PER_DEST",
+                                       icmp_limits::DEFAULT_ECHO_RATE_PER_DEST),
+                icmp_limits::get_limit("ICMP_MAX_DESTINATIONS",
+                                       icmp_limits::DEFAULT_MAX_DESTINATIONS)};
+        icmp_rate_limiter error_limiter{
+                icmp_limits::get_limit("ICMP_ERROR_RATE", icmp_limits::DEFAULT_ERROR_RATE),
+                icmp_limits::get_limit("ICMP_ERROR_RATE_PER_DEST",
+                                       icmp_limits::DEFAULT_ERROR_RATE_PER_DEST),
+                icmp_limits::get_limit("ICMP_MAX_DESTINATIONS",
+                                       icmp_limits::DEFAULT_MAX_DESTINATIONS)};
+
+        static bool is_error_type(uint8_t type) {
+                return type == TYPE_DEST_UNREACH || type == TYPE_SOURCE_QUENCH ||
+                       type == TYPE_REDIRECT || type == TYPE_TIME_EXCEEDED ||
+                       type == TYPE_PARAM_PROBLEM;
+        }
+
+        static bool is_unicast(ipv4_addr_t addr) {
+                uint32_t raw = addr.get_raw_ipv4();
+                return raw != 0 && raw != 0xFFFFFFFF && (raw >> 28) != 0xE;
+        }
+
+        bool can_enqueue(ipv4_addr_t dst, icmp_rate_limiter& limiter) {
+                if (this->queued_packets() >= MAX_QUEUED_PACKETS) {
+                        DLOG(WARNING) << "[ICMP QUEUE FULL] Dropping message to " << dst;
+                        return false;
+                }
+                if (!limiter.allow(dst)) {
+                        DLOG(INFO) << "[ICMP RATE LIMITED] " << dst;
+                        return false;
+                }
+                return true;
+        }
+
+public:
         virtual int id() { return PROTO; }
 
+        void register_frag_needed_handler(frag_needed_handler_type handler) {
+                _frag_needed_handlers.push_back(std::move(handler));
+        }
+
+        /**
+         *  RFC 1191: the Destination Unreachable message carries the Next-Hop MTU
+         *  in the low-order 16 bits of the second header word, followed by the IP
+         *  header and first 8 bytes of the datagram that could not be forwarded.
+         */
+        void handle_frag_needed(ipv4_packet& in_packet, icmp_header_t& in_icmp_header) {
+                int quoted_len = in_packet.buffer->get_remaining_len() - icmp_header_t::size();
+                if (quoted_len < static_cast<int>(ipv4_header_t::size()) + 8) {
+                        DLOG(WARNING) << "[FRAG NEEDED] Truncated quote " << quoted_len;
+                        return;
+                }
+
+                uint8_t*      quoted      = in_packet.buffer->get_pointer() + icmp_header_t::size();
+                ipv4_header_t quoted_ipv4 = ipv4_header_t::consume(quoted);
+                int           quoted_ihl  = quoted_ipv4.header_length * 4;
+                if (quoted_ipv4.proto_type != 0x06 || quoted_len < quoted_ihl + 8) {
+                        return;
+                }
+
+                uint16_t mtu = in_icmp_header.seq;
+                if (mtu == 0) {
+                        mtu = pmtu_cache::plateau_below(quoted_ipv4.total_length);
+                }
+                if (mtu >= quoted_ipv4.total_length) {
+                        // A "smaller" MTU that would have carried the datagram is bogus
+                        DLOG(WARNING) << "[FRAG NEEDED] Ignoring mtu=" << mtu
+                                      << " for datagram of " << quoted_ipv4.total_length;
+                        return;
+                }
+
+                // The quoted segment was sent by us: source is local, destination remote
+                uint8_t*    quoted_tcp = quoted + quoted_ihl;
+                uint16_t    src_port   = utils::consume<uint16_t>(quoted_tcp);
+                uint16_t    dst_port   = utils::consume<uint16_t>(quoted_tcp);
+                uint32_t    seq_no     = utils::consume<uint32_t>(quoted_tcp);
+                ipv4_port_t local_info = {.ipv4_addr = quoted_ipv4.src_ip_addr, .port_addr = src_port};
+                ipv4_port_t remote_info = {.ipv4_addr = quoted_ipv4.dst_ip_addr,
+                                           .port_addr = dst_port};
+                two_ends_t two_end = {.remote_info = remote_info, .local_info = local_info};
+
+                LOG_ICMP("[FRAG NEEDED] " << two_end << " mtu=" << mtu);
+                for (auto& handler : _frag_needed_handlers) {
+                        handler(two_end, seq_no, mtu);
+                }
+        }
+
+        /**
+         *  Report a problem with a datagram we received. The buffer of
+         *  in_packet must point at the transport header, with the IPv4
+         *  header right in front of it (as left by ipv4::make_packet()).
+         *
+         *  RFC 1122 3.2.2: never send an error about an ICMP error, a
+         *  non-initial fragment, or a datagram that was not unicast.
+         */
+        void send_error(uint8_t type, uint8_t code, ipv4_packet& in_packet, uint16_t next_hop_mtu = 0) {
+                if (!in_packet.src_ipv4_addr || !in_packet.dst_ipv4_addr) return;
+                ipv4_addr_t dst = in_packet.src_ipv4_addr.value();
+                ipv4_addr_t src = in_packet.dst_ipv4_addr.value();
+                if (!is_unicast(dst) || !is_unicast(src)) return;
+
+                base_packet& offending = *in_packet.buffer;
+                uint8_t*     quoted    = offending.get_pointer() - ipv4_header_t::size();
+                ipv4_header_t in_ipv4  = ipv4_header_t::consume(quoted);
+                if (in_ipv4.frag_offset != 0) return;
+
+                int l4_len = offending.get_remaining_len();
+                if (in_packet.proto == PROTO && l4_len > 0) {
+                        uint8_t* l4_pointer = offending.get_pointer();
+                        if (is_error_type(utils::consume<uint8_t>(l4_pointer))) return;
+                }
+
+                if (!can_enqueue(dst, error_limiter)) return;
+
+                int quoted_len = ipv4_header_t::size() + std::min(l4_len, 8);
+                auto out_buffer = std::make_unique<base_packet>(icmp_header_t::size() + quoted_len);
+
+                icmp_header_t out_icmp_header;
+                out_icmp_header.proto_type = type;
+                out_icmp_header.code       = code;
+                out_icmp_header.seq        = next_hop_mtu;
+                uint8_t* payload_pointer = out_icmp_header.produce(out_buffer->get_pointer());
+                std::copy(quoted, quoted + quoted_len, payload_pointer);
+
+                uint8_t* pointer = out_buffer->get_pointer();
+                out_icmp_header.checksum = utils::checksum(pointer, out_buffer->get_remaining_len(), 0);
+                out_icmp_header.produce(pointer);
+
+                LOG_ICMP("[SEND ERROR] type=" << int(type) << " code=" << int(code) << " to " << dst);
+                ipv4_packet out_packet = {.src_ipv4_addr = src,
+                                          .dst_ipv4_addr = dst,
+                                          .proto         = PROTO,
+                                          .buffer        = std::move(out_buffer)};
+                this->enter_send_queue(std::move(out_packet));
+        }
+
+        void send_protocol_unreachable(ipv4_packet& in_packet) {
+                send_error(TYPE_DEST_UNREACH, CODE_PROTO_UNREACH, in_packet);
+        }
+
+        static uint16_t load_word(uint8_t* ptr) { return utils::consume<uint16_t>(ptr); }
+        static void     store_word(uint8_t* ptr, uint16_t value) { utils::produce<uint16_t>(ptr, value); }
+
+        /**
+         *  Echo fast path: the request frame becomes the reply. Only the ICMP
+         *  type, the IPv4 addresses and TTL, and the MAC addresses change, so
+         *  nothing is allocated or copied and both checksums are patched
+         *  incrementally. Returns false if the buffer does not hold the whole
+         *  received frame with a plain 20-byte IPv4 header.
+         */
+        bool bounce_echo_request(ipv4_packet& in_packet) {
+                constexpr int headers_len = ethernetv2_header_t::size() + ipv4_header_t::size();
+                base_packet&  buffer      = *in_packet.buffer;
+                if (!buffer.is_contiguous() || buffer.get_offset() != headers_len) {
+                        return false;
+                }
+                uint8_t* icmp_pointer     = buffer.get_pointer();
+                uint8_t* ipv4_pointer     = icmp_pointer - ipv4_header_t::size();
+                uint8_t* ethernet_pointer = ipv4_pointer - ethernetv2_header_t::size();
+                if ((ipv4_pointer[0] & 0x0F) != ipv4_header_t::size() / 4) {
+                        return false;
+                }
+
+                auto& ethernet_instance = ethernetv2::instance();
+                if (ethernet_instance.queued_packets() >= MAX_QUEUED_PACKETS) {
+                        DLOG(WARNING) << "[ICMP QUEUE FULL] Dropping echo reply";
+                        return true;
+                }
+                if (!echo_limiter.allow(in_packet.src_ipv4_addr.value())) {
+                        DLOG(INFO) << "[ICMP RATE LIMITED] " << in_packet.src_ipv4_addr.value();
+                        return true;
+                }
+
+                // ICMP: Echo Request -> Echo Reply, code/type share the first word
+                uint16_t old_word = load_word(icmp_pointer);
+                icmp_pointer[0]   = TYPE_ECHO_REPLY;
+                store_word(icmp_pointer + 2, utils::checksum_adjust(load_word(icmp_pointer + 2),
+                                                                    old_word, load_word(icmp_pointer)));
+
+                // IPv4: swapping the addresses keeps the sum, resetting the TTL does not
+                std::swap_ranges(ipv4_pointer + 12, ipv4_pointer + 16, ipv4_pointer + 16);
+                old_word        = load_word(ipv4_pointer + 8);
+                ipv4_pointer[8] = 0x40;
+                store_word(ipv4_pointer + 10, utils::checksum_adjust(load_word(ipv4_pointer + 10),
+                                                                     old_word, load_word(ipv4_pointer + 8)));
+
+                // Ethernet: back to the sender
+                std::swap_ranges(ethernet_pointer, ethernet_pointer + mac_addr_t::size(),
+                                 ethernet_pointer + mac_addr_t::size());
+
+                buffer.add_offset(-headers_len);
+                raw_packet out_packet = {.buffer = std::move(in_packet.buffer)};
+                ethernet_instance.enter_send_queue(std::move(out_packet));
+                DLOG(INFO) << "[SEND ICMP REPLY] in place";
+                return true;
+        }
+
         void make_icmp_reply(ipv4_packet& in_packet) {
+                if (!can_enqueue(in_packet.src_ipv4_addr.value(), echo_limiter)) {
+                        return;
+                }
+
                 icmp_header_t in_icmp_header = icmp_header_t::consume(in_packet.buffer->get_pointer());
 
                 icmp_header_t out_icmp_header;
@@ -48,8 +291,13 @@ public:
                 icmp_header_t in_icmp_header =
                         icmp_header_t::consume(in_packet.buffer->get_pointer());
                 DLOG(INFO) << "[RECEIVED ICMP] " << in_icmp_header;
-                if (in_icmp_header.proto_type == 0x08) {
-                        make_icmp_reply(in_packet);
+                if (in_icmp_header.proto_type == TYPE_ECHO_REQUEST) {
+                        if (!bounce_echo_request(in_packet)) {
+                                make_icmp_reply(in_packet);
+                        }
+                } else if (in_icmp_header.proto_type == TYPE_DEST_UNREACH &&
+                           in_icmp_header.code == CODE_FRAG_NEEDED) {
+                        handle_frag_needed(in_packet, in_icmp_header);
                 }
                 return std::nullopt;
         }
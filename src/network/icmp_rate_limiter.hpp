@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+
+#include "ipv4_addr.hpp"
+#include "logger.hpp"
+#include "token_bucket.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* icmp_rate_limiter_doc = R"(
+FILE: icmp_rate_limiter.hpp
+PURPOSE: Global + per-destination token buckets for outgoing ICMP. Methods: allow(), tracked_destinations().
+
+- A message is sent only if both the global and the destination bucket have a token
+- The per-destination table is bounded; idle (full) buckets are evicted when it fills up
+- Separate instances limit Echo Replies and error messages (see icmp.hpp)
+)";
+}
+
+// ICMP rate limits (environment overridable, like connection_limits)
+namespace icmp_limits {
+        static const uint32_t DEFAULT_ECHO_RATE           = 1000;  // Echo Replies/s, all peers
+        static const uint32_t DEFAULT_ECHO_RATE_PER_DEST  = 100;   // Echo Replies/s, one peer
+        static const uint32_t DEFAULT_ERROR_RATE          = 100;   // Errors/s, all peers
+        static const uint32_t DEFAULT_ERROR_RATE_PER_DEST = 10;    // Errors/s, one peer
+        static const uint32_t DEFAULT_MAX_DESTINATIONS    = 4096;  // Tracked per-destination buckets
+
+        // Format: ICMP_ECHO_RATE=500, ICMP_ERROR_RATE_PER_DEST=1, ...
+        inline uint32_t get_limit(const char* env_var_name, uint32_t default_limit) {
+                const char* env_limit = std::getenv(env_var_name);
+                if (env_limit) {
+                        try {
+                                uint32_t limit = std::stoul(env_limit);
+                                if (limit > 0) return limit;
+                        } catch (...) {
+                                // Invalid env var, fall through to default
+                        }
+                }
+                return default_limit;
+        }
+}  // namespace icmp_limits
+
+class icmp_rate_limiter {
+private:
+        token_bucket_t                                  global_bucket;
+        std::unordered_map<ipv4_addr_t, token_bucket_t> dest_buckets;
+        uint32_t                                        per_dest_rate;
+        uint32_t                                        max_destinations;
+        uint64_t                                        total_limited = 0;
+
+        void evict_idle_buckets(token_bucket_t::clock::time_point now) {
+                for (auto it = dest_buckets.begin(); it != dest_buckets.end();) {
+                        if (it->second.is_full(now)) {
+                                it = dest_buckets.erase(it);
+                        } else {
+                                ++it;
+                        }
+                }
+        }
+
+public:
+        // Bursts are one second worth of tokens
+        icmp_rate_limiter(uint32_t global_rate, uint32_t per_dest_rate, uint32_t max_destinations)
+            : global_bucket(global_rate, global_rate),
+              per_dest_rate(per_dest_rate),
+              max_destinations(max_destinations) {}
+
+        bool allow(ipv4_addr_t dst) {
+                auto now = token_bucket_t::clock::now();
+
+                auto it = dest_buckets.find(dst);
+                if (it == dest_buckets.end()) {
+                        if (dest_buckets.size() >= max_destinations) {
+                                evict_idle_buckets(now);
+                        }
+                        if (dest_buckets.size() >= max_destinations) {
+                                // Table full of active senders (spoofed flood): refuse new ones
+                                total_limited++;
+                                return false;
+                        }
+                        it = dest_buckets.emplace(dst, token_bucket_t(per_dest_rate, per_dest_rate, now))
+                                     .first;
+                }
+
+                // Check the destination first so one noisy peer cannot drain the global budget
+                if (!it->second.try_consume(now) || !global_bucket.try_consume(now)) {
+                        total_limited++;
+                        return false;
+                }
+                return true;
+        }
+
+        size_t   tracked_destinations() const { return dest_buckets.size(); }
+        uint64_t get_total_limited() const { return total_limited; }
+};
+}  // namespace uStack
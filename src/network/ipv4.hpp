@@ -1,6 +1,7 @@
 #pragma once
 #include "arp.hpp"
 #include "base_protocol.hpp"
+#include "icmp.hpp"
 #include "ipv4_header.hpp"
 #include "packets.hpp"
 
@@ -10,6 +11,10 @@ namespace docs {
 static const char* ipv4_doc = R"(
 FILE: ipv4.hpp
 PURPOSE: IPv4 layer. Methods: id(), make_packet() (bidirectional).
+
+RECEIVE (host only, RFC 1122 3.2.1.7: TTL and DF are a router's concern):
+- Fragment (no reassembly)       -> dropped silently
+- No handler for the protocol    -> Destination Unreachable / Protocol Unreachable (rate limited by icmp)
 )";
 }
 
@@ -69,6 +74,16 @@ public:
                                           .dst_ipv4_addr = ipv4_header.dst_ip_addr,
                                           .proto         = ipv4_header.proto_type,
                                           .buffer        = std::move(in_packet.buffer)};
+
+                if (ipv4_header.MF || ipv4_header.frag_offset != 0) {
+                        // No reassembly: the datagram can never be completed
+                        DLOG(WARNING) << "[DROP FRAGMENT] " << ipv4_header;
+                        return std::nullopt;
+                }
+                if (!this->has_upper_protocol(ipv4_header.proto_type)) {
+                        icmp::instance().send_protocol_unreachable(out_packet);
+                        return std::nullopt;
+                }
                 return std::move(out_packet);
         };
 };
@@ -0,0 +1,122 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+
+#include "ipv4_addr.hpp"
+#include "logger.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* pmtu_cache_doc = R"(
+FILE: pmtu_cache.hpp
+PURPOSE: Per-destination Path MTU cache (RFC 1191). Methods: query_mtu(), query_mss(), lower_mtu(), confirm_mtu(), generation().
+
+- lower_mtu() is fed by ICMP Destination Unreachable / Fragmentation Needed
+- confirm_mtu() is fed by successful PLPMTUD probes (RFC 4821)
+- Entries age out after 10 minutes so larger MTUs can be rediscovered
+- generation() changes on every update, TCBs compare it to refresh their MSS lazily
+)";
+}
+
+// PMTU configuration (environment overridable, like connection_limits)
+namespace pmtu_config {
+        static const uint16_t DEFAULT_LINK_MTU = 1500;
+        // Smallest PMTU we accept from ICMP, guards against tiny-segment attacks
+        static const uint16_t MIN_PMTU = 576;
+        // RFC 4821 recommends starting the search from a conservative base
+        static const uint16_t PLPMTUD_BASE_MTU = 1024;
+
+        // Enable packetization layer probing with PLPMTUD=1
+        inline bool plpmtud_enabled() {
+                const char* env_value = std::getenv("PLPMTUD");
+                return env_value && std::string(env_value) == "1";
+        }
+}  // namespace pmtu_config
+
+struct pmtu_entry_t {
+        uint16_t                              mtu = pmtu_config::DEFAULT_LINK_MTU;
+        std::chrono::steady_clock::time_point updated;
+};
+
+class pmtu_cache {
+private:
+        pmtu_cache()  = default;
+        ~pmtu_cache() = default;
+
+        std::unordered_map<ipv4_addr_t, pmtu_entry_t> entries;
+        uint32_t                                      _generation = 0;
+
+public:
+        static constexpr uint16_t IP_TCP_HEADER_SIZE = 40;
+        static constexpr auto     AGING_INTERVAL     = std::chrono::minutes(10);
+
+        pmtu_cache(const pmtu_cache&) = delete;
+        pmtu_cache(pmtu_cache&&)      = delete;
+        pmtu_cache& operator=(const pmtu_cache&) = delete;
+        pmtu_cache& operator=(pmtu_cache&&) = delete;
+
+        static pmtu_cache& instance() {
+                static pmtu_cache instance;
+                return instance;
+        }
+
+        uint32_t generation() const { return _generation; }
+
+        uint16_t query_mtu(ipv4_addr_t dst) {
+                auto it = entries.find(dst);
+                if (it == entries.end()) {
+                        return pmtu_config::DEFAULT_LINK_MTU;
+                }
+                if (std::chrono::steady_clock::now() - it->second.updated > AGING_INTERVAL) {
+                        DLOG(INFO) << "[PMTU EXPIRED] " << dst << " " << it->second.mtu;
+                        entries.erase(it);
+                        _generation++;
+                        return pmtu_config::DEFAULT_LINK_MTU;
+                }
+                return it->second.mtu;
+        }
+
+        uint16_t query_mss(ipv4_addr_t dst) { return query_mtu(dst) - IP_TCP_HEADER_SIZE; }
+
+        // RFC 1191: only ever lower the estimate from ICMP. Returns true if it changed.
+        bool lower_mtu(ipv4_addr_t dst, uint16_t mtu) {
+                if (mtu < pmtu_config::MIN_PMTU) mtu = pmtu_config::MIN_PMTU;
+                if (mtu >= query_mtu(dst)) {
+                        return false;
+                }
+                entries[dst] = {.mtu = mtu, .updated = std::chrono::steady_clock::now()};
+                _generation++;
+                LOG_IPv4_ROUTE("[PMTU LOWERED] " << dst << " mtu=" << mtu);
+                return true;
+        }
+
+        // PLPMTUD: a probe of this size made it through, remember it for new connections
+        void confirm_mtu(ipv4_addr_t dst, uint16_t mtu) {
+                if (mtu > pmtu_config::DEFAULT_LINK_MTU) mtu = pmtu_config::DEFAULT_LINK_MTU;
+                auto it = entries.find(dst);
+                if (it == entries.end()) {
+                        return;  // No reduced estimate for this destination, nothing to raise
+                }
+                if (mtu > it->second.mtu) {
+                        it->second.mtu = mtu;
+                        _generation++;
+                        DLOG(INFO) << "[PMTU CONFIRMED] " << dst << " mtu=" << mtu;
+                }
+                it->second.updated = std::chrono::steady_clock::now();
+        }
+
+        // RFC 1191 section 7: routers that predate the Next-Hop MTU field report 0,
+        // so guess the next plateau below the size of the datagram that was dropped
+        static uint16_t plateau_below(uint16_t total_length) {
+                static const uint16_t plateaus[] = {32000, 17914, 8166, 4352, 2002,
+                                                    1492,  1006,  508,  296,  68};
+                for (uint16_t plateau : plateaus) {
+                        if (plateau < total_length) return plateau;
+                }
+                return 68;
+        }
+};
+}  // namespace uStack
@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace uStack {
+
+namespace docs {
+static const char* port_allocator_doc = R"(
+FILE: port_allocator.hpp
+PURPOSE: Ephemeral port allocation for active opens. Methods: allocate(), reserve(), release(), in_use().
+
+- One bitmap per local address over the RFC 6335 dynamic range 49152-65535
+  (256 x 64-bit words, 2 KB per address)
+- allocate() scans from a rotating word hint and takes the lowest free bit of the
+  first non-full word with a count-trailing-zeros, so a free port is found in
+  O(words) worst case and O(1) typically
+- The hint rotates so recently released ports are not handed out immediately
+)";
+}
+
+class port_allocator {
+public:
+        static constexpr uint16_t EPHEMERAL_MIN = 49152;
+        static constexpr uint16_t EPHEMERAL_MAX = 65535;
+        static constexpr size_t   PORT_COUNT    = size_t(EPHEMERAL_MAX) - EPHEMERAL_MIN + 1;
+        static constexpr size_t   WORDS         = PORT_COUNT / 64;
+
+private:
+        struct bitmap_t {
+                std::array<uint64_t, WORDS> words{};
+                size_t                      hint = 0;
+                size_t                      used = 0;
+        };
+        std::unordered_map<uint32_t, bitmap_t> bitmaps;  // Keyed by raw local IPv4
+
+        static bool in_range(uint16_t port) { return port >= EPHEMERAL_MIN; }
+
+public:
+        // Returns a free ephemeral port on local_ipv4 and marks it used
+        std::optional<uint16_t> allocate(uint32_t local_ipv4) {
+                bitmap_t& bitmap = bitmaps[local_ipv4];
+                if (bitmap.used == PORT_COUNT) return std::nullopt;
+
+                for (size_t i = 0; i < WORDS; i++) {
+                        size_t   index = (bitmap.hint + i) % WORDS;
+                        uint64_t free  = ~bitmap.words[index];
+                        if (free == 0) continue;
+
+                        int bit = __builtin_ctzll(free);
+                        bitmap.words[index] |= uint64_t(1) << bit;
+                        bitmap.used++;
+                        bitmap.hint = (index + 1) % WORDS;
+                        return static_cast<uint16_t>(EPHEMERAL_MIN + index * 64 + bit);
+                }
+                return std::nullopt;
+        }
+
+        // Mark a specific port used (explicit bind). False if already taken.
+        bool reserve(uint32_t local_ipv4, uint16_t port) {
+                if (!in_range(port)) return true;  // Not managed here
+                bitmap_t& bitmap = bitmaps[local_ipv4];
+                size_t    offset = port - EPHEMERAL_MIN;
+                uint64_t  mask   = uint64_t(1) << (offset % 64);
+                if (bitmap.words[offset / 64] & mask) return false;
+                bitmap.words[offset / 64] |= mask;
+                bitmap.used++;
+                return true;
+        }
+
+        void release(uint32_t local_ipv4, uint16_t port) {
+                if (!in_range(port)) return;
+                auto it = bitmaps.find(local_ipv4);
+                if (it == bitmaps.end()) return;
+                size_t   offset = port - EPHEMERAL_MIN;
+                uint64_t mask   = uint64_t(1) << (offset % 64);
+                if (it->second.words[offset / 64] & mask) {
+                        it->second.words[offset / 64] &= ~mask;
+                        it->second.used--;
+                }
+        }
+
+        size_t in_use(uint32_t local_ipv4) const {
+                auto it = bitmaps.find(local_ipv4);
+                return it == bitmaps.end() ? 0 : it->second.used;
+        }
+};
+}  // namespace uStack
@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "siphash.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* syn_cookie_doc = R"(
+FILE: syn_cookie.hpp
+PURPOSE: Stateless SYN cookies (RFC 4987 section 3.6). Methods: make(), check(), mss_index().
+
+COOKIE LAYOUT (the ISS of our SYN-ACK):
+[ t mod 32 (5 bits) ][ MSS index (3 bits) ][ SipHash(secret, tuple, t, client ISN) (24 bits) ]
+
+- t is a 64-second counter; a cookie is accepted for the current and previous period
+- Only the peer MSS survives (from an 8 entry table); window scaling and SACK are
+  not negotiated by this stack anyway
+)";
+}
+
+struct syn_cookie_tuple_t {
+        uint32_t local_ipv4;
+        uint32_t remote_ipv4;
+        uint16_t local_port;
+        uint16_t remote_port;
+};
+
+class syn_cookie_t {
+public:
+        static constexpr int      PERIOD_SECONDS = 64;
+        static constexpr uint16_t MSS_TABLE[8]   = {536, 1024, 1220, 1300, 1380, 1440, 1452, 1460};
+
+private:
+        utils::siphash_key_t _key;
+
+        uint32_t hash24(const syn_cookie_tuple_t& tuple, uint32_t period, uint32_t client_isn) const {
+                uint8_t  data[20];
+                uint8_t* p = data;
+                std::memcpy(p, &tuple.local_ipv4, 4);
+                std::memcpy(p + 4, &tuple.remote_ipv4, 4);
+                std::memcpy(p + 8, &tuple.local_port, 2);
+                std::memcpy(p + 10, &tuple.remote_port, 2);
+                std::memcpy(p + 12, &period, 4);
+                std::memcpy(p + 16, &client_isn, 4);
+                return utils::siphash24(_key, data, sizeof(data)) & 0x00FFFFFF;
+        }
+
+public:
+        syn_cookie_t() : _key(utils::random_key()) {}
+        explicit syn_cookie_t(utils::siphash_key_t key) : _key(key) {}
+
+        static uint32_t current_period() {
+                auto now = std::chrono::steady_clock::now().time_since_epoch();
+                return std::chrono::duration_cast<std::chrono::seconds>(now).count() / PERIOD_SECONDS;
+        }
+
+        // Largest table entry not above the peer's MSS
+        static uint8_t mss_index(uint16_t mss) {
+                uint8_t index = 0;
+                for (uint8_t i = 0; i < 8; i++) {
+                        if (MSS_TABLE[i] <= mss) index = i;
+                }
+                return index;
+        }
+
+        uint32_t make(const syn_cookie_tuple_t& tuple, uint32_t client_isn, uint16_t mss,
+                      uint32_t period = current_period()) const {
+                return (period & 0x1F) << 27 | uint32_t(mss_index(mss)) << 24 |
+                       hash24(tuple, period, client_isn);
+        }
+
+        // Returns the encoded MSS if cookie is one we issued recently for this tuple
+        std::optional<uint16_t> check(const syn_cookie_tuple_t& tuple, uint32_t cookie,
+                                      uint32_t client_isn, uint32_t period = current_period()) const {
+                for (uint32_t age = 0; age < 2; age++) {
+                        uint32_t candidate = period - age;
+                        if ((candidate & 0x1F) != cookie >> 27) continue;
+                        if (hash24(tuple, candidate, client_isn) == (cookie & 0x00FFFFFF)) {
+                                return MSS_TABLE[(cookie >> 24) & 0x7];
+                        }
+                }
+                return std::nullopt;
+        }
+};
+}  // namespace uStack
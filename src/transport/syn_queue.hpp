@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+
+#include "tuple_key.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* syn_queue_doc = R"(
+FILE: syn_queue.hpp
+PURPOSE: Compact SYN-RECEIVED table for passive opens. Methods: insert(), find(), take(), expire(), size(), count_for_port().
+
+- A SYN on a listening port creates a half_open_t (20 bytes + 12 byte tuple_key_t), not a tcb_t
+- The full TCB is created by tcb_manager only when the final ACK arrives
+- Entries expire after HALF_OPEN_TIMEOUT, oldest first (insertion order == expiry order)
+- Half-open entries do not count against MAX_CONNECTIONS
+)";
+}
+
+// Everything needed to finish the handshake without a TCB
+struct half_open_t {
+        uint32_t irs         = 0;  // Peer's initial sequence number
+        uint32_t iss         = 0;  // Our initial sequence number
+        uint32_t created_ms  = 0;  // Creation time, milliseconds (steady clock)
+        uint16_t peer_mss    = 0;  // MSS option from the SYN
+        uint16_t peer_window = 0;
+        uint8_t  retries     = 0;  // SYN-ACK retransmissions
+};
+
+class syn_queue_t {
+public:
+        static constexpr uint32_t HALF_OPEN_TIMEOUT_MS = 30000;
+
+private:
+        std::unordered_map<tuple_key_t, half_open_t, tuple_key_hash> entries;
+        std::deque<std::pair<tuple_key_t, uint32_t>>                 order;  // (key, created_ms)
+        std::unordered_map<uint16_t, uint32_t>                       port_counts;
+
+        void erase_entry(std::unordered_map<tuple_key_t, half_open_t, tuple_key_hash>::iterator it) {
+                auto count = port_counts.find(it->first.local_port);
+                if (count != port_counts.end() && --count->second == 0) {
+                        port_counts.erase(count);
+                }
+                entries.erase(it);
+        }
+
+public:
+        static uint32_t now_ms() {
+                auto now = std::chrono::steady_clock::now().time_since_epoch();
+                return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+        }
+
+        size_t size() const { return entries.size(); }
+
+        uint32_t count_for_port(uint16_t port) const {
+                auto it = port_counts.find(port);
+                return it == port_counts.end() ? 0 : it->second;
+        }
+
+        void insert(const tuple_key_t& key, const half_open_t& entry) {
+                auto result = entries.emplace(key, entry);
+                if (!result.second) {
+                        return;  // Already half-open, keep the original ISS
+                }
+                port_counts[key.local_port]++;
+                order.emplace_back(key, entry.created_ms);
+        }
+
+        half_open_t* find(const tuple_key_t& key) {
+                auto it = entries.find(key);
+                return it == entries.end() ? nullptr : &it->second;
+        }
+
+        // Remove and return the entry (final ACK or RST)
+        std::optional<half_open_t> take(const tuple_key_t& key) {
+                auto it = entries.find(key);
+                if (it == entries.end()) {
+                        return std::nullopt;
+                }
+                half_open_t entry = it->second;
+                erase_entry(it);
+                return entry;
+        }
+
+        // Drop entries older than HALF_OPEN_TIMEOUT_MS. O(expired) amortized:
+        // stale order records (already taken) are skipped as they reach the front.
+        uint32_t expire(uint32_t now = now_ms()) {
+                uint32_t expired = 0;
+                while (!order.empty() && now - order.front().second >= HALF_OPEN_TIMEOUT_MS) {
+                        auto it = entries.find(order.front().first);
+                        if (it != entries.end() && it->second.created_ms == order.front().second) {
+                                erase_entry(it);
+                                expired++;
+                        }
+                        order.pop_front();
+                }
+                return expired;
+        }
+};
+}  // namespace uStack
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <deque>
@@ -11,7 +12,9 @@
 #include "defination.hpp"
 #include "ipv4_addr.hpp"
 #include "packets.hpp"
+#include "pmtu_cache.hpp"
 #include "tcp_header.hpp"
+#include "timer_wheel.hpp"
 
 namespace uStack {
 
@@ -27,7 +30,9 @@ using port_addr_t = uint16_t;
 struct send_state_t {
         uint32_t                  unacknowledged = 0;
         uint32_t                  next           = 0;
-        uint32_t                  window         = 0;
+        uint32_t                  window         = 0;  // SND.WND, an offset from SND.UNA
+        uint32_t                  wl1            = 0;  // SND.WL1: SEG.SEQ of the last window update
+        uint32_t                  wl2            = 0;  // SND.WL2: SEG.ACK of the last window update
         int8_t                    window_sale    = 0;
         uint16_t                  mss            = 1460;  // Default MSS (1500 - 40 for IP/TCP headers)
         uint32_t                  cwnd           = 0;
@@ -46,6 +51,33 @@ struct send_state_t {
         uint32_t last_ack_no = 0;
 };
 
+// Packetization Layer Path MTU Discovery (RFC 4821) search state, in MSS units
+struct plpmtud_state_t {
+        static constexpr uint16_t PROBE_GRANULARITY = 32;  // Stop searching below this gap
+        static constexpr uint8_t  MAX_PROBES        = 3;   // Losses before a size is given up
+
+        bool     enabled        = false;
+        uint16_t search_low     = 0;  // Largest MSS known to get through
+        uint16_t search_high    = 0;  // Largest MSS that might get through
+        uint16_t probe_mss      = 0;  // Size of the outstanding probe, 0 if none
+        uint32_t probe_seq      = 0;  // First sequence number of the outstanding probe
+        uint8_t  probe_failures = 0;
+
+        void init(uint16_t path_mss) {
+                uint16_t base_mss = pmtu_config::PLPMTUD_BASE_MTU - pmtu_cache::IP_TCP_HEADER_SIZE;
+                enabled           = true;
+                search_high       = path_mss;
+                search_low        = std::min(base_mss, path_mss);
+        }
+
+        // Binary search between the two bounds; 0 means do not probe now
+        uint16_t next_probe_mss() const {
+                if (!enabled || probe_mss != 0) return 0;
+                if (search_high < search_low + PROBE_GRANULARITY) return 0;
+                return search_low + (search_high - search_low + 1) / 2;
+        }
+};
+
 struct receive_state_t {
         uint32_t next         = 0;
         uint32_t window       = 0;
@@ -53,23 +85,50 @@ struct receive_state_t {
         uint16_t mss          = 0;
 };
 
+// Dead peer detection, set per socket (see tcb_manager::on_liveness_timeout)
+struct liveness_config_t {
+        bool     keepalive          = false;    // SO_KEEPALIVE (RFC 1122 section 4.2.3.6)
+        uint32_t keepalive_idle_ms  = 7200000;  // TCP_KEEPIDLE
+        uint32_t keepalive_intvl_ms = 75000;    // TCP_KEEPINTVL
+        uint8_t  keepalive_count    = 9;        // TCP_KEEPCNT
+        uint32_t user_timeout_ms    = 0;        // TCP_USER_TIMEOUT (RFC 5482), 0 = off
+
+        bool enabled() const { return keepalive || user_timeout_ms != 0; }
+};
+
+// Segment payload that stays valid until it is acknowledged (a sendfile() mapping)
+struct pinned_payload_t {
+        std::shared_ptr<const void> pin;
+        const uint8_t*              data = nullptr;
+};
+
 // Retransmission queue entry - tracks sent but unacknowledged segments
 struct retransmit_entry_t {
         uint32_t seq_no;                                      // Starting sequence number
         uint32_t data_len;                                    // Data length in bytes
         std::vector<uint8_t> data_copy;                       // Deep copy of segment data
+        pinned_payload_t pinned;                              // Or a reference to it, no copy
         std::chrono::steady_clock::time_point sent_time;      // Timestamp (for future RTO)
         uint16_t retransmit_count = 0;                        // Number of retransmissions
 
-        retransmit_entry_t(uint32_t seq, uint32_t len, const uint8_t* data)
-            : seq_no(seq), data_len(len), sent_time(std::chrono::steady_clock::now()) {
-                data_copy.resize(len);
-                std::memcpy(data_copy.data(), data, len);
+        retransmit_entry_t(uint32_t seq, uint32_t len, const uint8_t* data, pinned_payload_t source = {})
+            : seq_no(seq), data_len(len), pinned(std::move(source)), sent_time(std::chrono::steady_clock::now()) {
+                if (!pinned.pin) {
+                        data_copy.resize(len);
+                        std::memcpy(data_copy.data(), data, len);
+                }
         }
+
+        const uint8_t* data() const { return pinned.pin ? pinned.data : data_copy.data(); }
 };
 
 struct tcb_t : public std::enable_shared_from_this<tcb_t> {
+        static constexpr uint32_t PERSIST_MIN_MS    = 1000;  // Zero window probe interval, doubling
+        static constexpr uint32_t PERSIST_MAX_MS    = 60000;
+        static constexpr uint32_t RECEIVE_COPYBREAK = packet_pool::BUFFER_SIZE / 2;  // Smaller payloads are copied
+
         std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>                _active_tcbs;
+        std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>                _reap_tcbs;
         std::optional<std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>> _listener;
         int                                                                   state;
         int                                                                   next_state;
@@ -81,22 +140,326 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
         std::deque<retransmit_entry_t>                                        retransmit_queue;
         send_state_t                                                          send;
         receive_state_t                                                       receive;
+        uint32_t                                                              send_queued_bytes = 0;
+        plpmtud_state_t                                                       plpmtud;
+        uint32_t                                                              pmtu_generation = 0;
+        int                                                                   socket_fd       = -1;  // Owning socket, -1 until accepted
+        int                                                                   error           = 0;   // errno reported to the socket (ECONNREFUSED, ...)
+        bool                                                                  ephemeral_port  = false;
+        timer_wheel::timer_id                                                 syn_timer       = 0;
+        uint8_t                                                               syn_retries     = 0;
+        bool                                                                  fin_pending     = false;  // close()/SHUT_WR: FIN once send_queue drains
+        bool                                                                  fin_sent        = false;  // Our FIN occupies sequence number send.next - 1
+        bool                                                                  fin_received    = false;  // End of the peer's data stream
+        bool                                                                  read_shutdown   = false;  // SHUT_RD: new data is acknowledged and dropped
+        timer_wheel::timer_id                                                 close_timer     = 0;
+        uint8_t                                                               close_retries   = 0;
+        liveness_config_t                                                     liveness;
+        timer_wheel::timer_id                                                 liveness_timer    = 0;
+        uint8_t                                                               keepalive_probes  = 0;
+        timer_wheel::timer_id                                                 persist_timer     = 0;
+        uint8_t                                                               persist_backoff   = 0;
+        uint64_t                                                              last_heard_tick   = 0;  // timer_wheel tick of the last segment received
+        uint64_t                                                              ack_progress_tick = 0;  // Last SND.UNA advance, or first byte outstanding
+        uint32_t                                                              send_buffer_limit  = 0;  // SO_SNDBUF: unsent + unacknowledged bytes, 0 = unlimited
+        uint32_t                                                              send_low_watermark = 0;  // Writable again at or below this many buffered bytes
+        bool                                                                  write_blocked      = false;  // write() was cut short, wake the writer
+        uint32_t                                                              receive_buffer_limit = 0xFAF0;  // SO_RCVBUF: queued plus lent-out payload, bounds RCV.WND
+        uint32_t                                                              receive_buffered     = 0;       // Buffer memory (truesize) held for the application
 
         tcb_t(std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>                active_tcbs,
+              std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>                reap_tcbs,
               std::optional<std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>> listener,
               ipv4_port_t                                                           remote_info,
               ipv4_port_t                                                           local_info)
             : _active_tcbs(active_tcbs),
+              _reap_tcbs(reap_tcbs),
               _listener(listener),
               remote_info(remote_info),
               local_info(local_info),
               state(TCP_CLOSED) {}
 
+        // All state changes go through here so CLOSED TCBs land on the reap list exactly once
+        void enter_state(int new_state) {
+                bool closing = new_state == TCP_CLOSED && state != TCP_CLOSED;
+                state        = new_state;
+                next_state   = new_state;
+                if (closing && _reap_tcbs) {
+                        _reap_tcbs->push_back(shared_from_this());
+                }
+        }
+
+        // RFC 9293: on reset or close all segment queues are flushed
+        void release_buffers() {
+                send_queue.clear();
+                receive_queue.clear();
+                ctl_packets.clear();
+                retransmit_queue.clear();
+                send_queued_bytes    = 0;
+                send.bytes_in_flight = 0;
+                receive_buffered     = 0;
+        }
+
+        // close(): queued and unacknowledged data still pinned (borrowed from a write_zerocopy()
+        // buffer, or a sendfile() mapping) is copied into owned buffers and the pins dropped,
+        // so the application may reuse its buffers as soon as close() returns
+        void own_pinned_payloads() {
+                for (int n = send_queue.size(); n > 0; n--) {
+                        raw_packet packet = std::move(*send_queue.pop_front());
+                        if (packet.buffer->pin()) {
+                                packet.buffer = std::make_unique<base_packet>(packet.buffer->get_pointer(),
+                                                                              packet.buffer->get_remaining_len());
+                        }
+                        send_queue.push_back(std::move(packet));
+                }
+                for (auto& entry : retransmit_queue) {
+                        if (!entry.pinned.pin) continue;
+                        entry.data_copy.assign(entry.pinned.data, entry.pinned.data + entry.data_len);
+                        entry.pinned = {};
+                }
+        }
+
+        // close()/shutdown(SHUT_WR): the FIN follows the last queued byte (make_packet)
+        void shutdown_send() {
+                if (fin_pending) return;
+                fin_pending = true;
+                active_self();
+        }
+
+        // Our FIN is the last sequence number we send, so it is acked when everything is
+        bool fin_acked(uint32_t ack_no) const { return fin_sent && ack_no == send.next; }
+
+        // The FIN carries no data, so it is not in retransmit_queue; rebuild it
+        void retransmit_fin() {
+                if (!fin_sent) return;
+                auto         out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
+                tcp_header_t out_tcp;
+                out_tcp.src_port      = local_info->port_addr.value();
+                out_tcp.dst_port      = remote_info->port_addr.value();
+                out_tcp.seq_no        = send.next - 1;
+                out_tcp.ack_no        = receive.next;
+                out_tcp.window_size   = receive.window;
+                out_tcp.header_length = tcp_header_t::size() / 4;
+                out_tcp.ACK           = 1;
+                out_tcp.FIN           = 1;
+                out_tcp.produce(out_buffer->get_pointer());
+
+                tcp_packet_t out_packet = {.proto       = 0x06,
+                                           .remote_info = this->remote_info,
+                                           .local_info  = this->local_info,
+                                           .buffer      = std::move(out_buffer)};
+                ctl_packets.push_back(std::move(out_packet));
+                active_self();
+                DLOG(INFO) << "[RETRANSMIT FIN] " << *this;
+        }
+
+        bool has_unacked_data() const { return send.unacknowledged != send.next; }
+
+        // CLOSED from LAST-ACK: both FINs exchanged and ours acknowledged, not a reset or abort
+        bool closed_gracefully() const {
+                return state == TCP_CLOSED && error == 0 && fin_received && fin_sent && !has_unacked_data();
+        }
+
+        // Bytes charged to the send buffer: queued plus sent but not yet acknowledged
+        uint32_t send_buffered() const { return send_queued_bytes + (send.next - send.unacknowledged); }
+
+        uint32_t send_space() const {
+                if (send_buffer_limit == 0) return UINT32_MAX;
+                uint32_t buffered = send_buffered();
+                return buffered >= send_buffer_limit ? 0 : send_buffer_limit - buffered;
+        }
+
+        bool send_writable() const { return send_buffer_limit == 0 || send_buffered() <= send_low_watermark; }
+
+        // RCV.WND (no window scaling, so <= 0xFFFF). Queued segments are charged their buffer
+        // memory, at most twice their payload (see receive_enqueue), against a budget of twice
+        // the buffer limit, and half of what is free is offered: a charged segment never pulls
+        // the right edge of the window back
+        uint32_t receive_space() const {
+                uint32_t limit = std::min<uint32_t>(receive_buffer_limit, 0xFFFF);
+                uint32_t half  = receive_buffered / 2;
+                return half >= limit ? 0 : limit - half;
+        }
+
+        void update_receive_window() { receive.window = receive_space(); }
+
+        // Buffer memory queued for the application: RCV.NXT and the charge advance together,
+        // so the right edge of the window stays where it was
+        void receive_charge(uint32_t truesize) {
+                receive_buffered += truesize;
+                update_receive_window();
+        }
+
+        // Queue len bytes of segment text at buffer's offset for the application. Payloads
+        // below RECEIVE_COPYBREAK are copied out so a small segment does not hold a whole
+        // frame; larger ones keep the frame, which read_zerocopy() can lend out
+        void receive_enqueue(std::unique_ptr<base_packet> buffer, uint32_t len) {
+                if (len < RECEIVE_COPYBREAK) {
+                        buffer = std::make_unique<base_packet>(buffer->get_pointer(), len);
+                }
+                receive_charge(buffer->truesize());
+                raw_packet r_packet = {.buffer = std::move(buffer)};
+                receive_queue.push_back(std::move(r_packet));
+        }
+
+        // read() or the application gave back buffers holding len bytes (truesize). RFC 1122
+        // section 4.2.3.3 (receiver SWS avoidance): reopen in steps of min(buffer / 2, MSS), and send a
+        // window update when the peer may be stalled on a small window
+        void receive_release(uint32_t len) {
+                receive_buffered -= std::min(len, receive_buffered);
+                uint32_t space = receive_space();
+                uint32_t step  = std::min<uint32_t>(receive_buffer_limit / 2, send.mss ? send.mss : 536);
+                if (space < receive.window + step && receive_buffered != 0) return;
+                bool stalled   = receive.window < step;
+                receive.window = space;
+                if (stalled && (state == TCP_ESTABLISHED || state == TCP_FIN_WAIT_1 || state == TCP_FIN_WAIT_2)) {
+                        active_self();
+                }
+        }
+
+        // <SEQ=seq><ACK=RCV.NXT><CTL=ACK> with an already acknowledged seq: the peer must ACK it
+        void queue_probe(uint32_t seq) {
+                auto         out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
+                tcp_header_t out_tcp;
+                out_tcp.src_port      = local_info->port_addr.value();
+                out_tcp.dst_port      = remote_info->port_addr.value();
+                out_tcp.seq_no        = seq;
+                out_tcp.ack_no        = receive.next;
+                out_tcp.window_size   = receive.window;
+                out_tcp.header_length = tcp_header_t::size() / 4;
+                out_tcp.ACK           = 1;
+                out_tcp.produce(out_buffer->get_pointer());
+
+                tcp_packet_t out_packet = {.proto       = 0x06,
+                                           .remote_info = this->remote_info,
+                                           .local_info  = this->local_info,
+                                           .buffer      = std::move(out_buffer)};
+                ctl_packets.push_back(std::move(out_packet));
+                active_self();
+        }
+
+        // RFC 1122 section 4.2.3.6: <SEQ=SND.NXT-1><ACK=RCV.NXT><CTL=ACK>
+        void send_keepalive_probe() {
+                queue_probe(send.next - 1);
+                DLOG(INFO) << "[KEEPALIVE PROBE] " << *this << " probe=" << int(keepalive_probes);
+        }
+
+        // Usable window: SND.UNA + SND.WND - SND.NXT
+        uint32_t send_window_room() const {
+                uint32_t in_flight = send.next - send.unacknowledged;
+                return in_flight >= send.window ? 0 : send.window - in_flight;
+        }
+
+        // Handshake: the first window is taken as is
+        void init_send_window(uint32_t seq, uint32_t ack, uint16_t wnd) {
+                send.window = wnd;
+                send.wl1    = seq;
+                send.wl2    = ack;
+        }
+
+        // RFC 9293 section 3.10.7.4: an acceptable ACK (SND.UNA =< SEG.ACK =< SND.NXT) updates
+        // SND.WND unless it is older than the segment the window was last taken from
+        void update_send_window(uint32_t seq, uint32_t ack, uint16_t wnd) {
+                if (int32_t(seq - send.wl1) < 0 || (seq == send.wl1 && int32_t(ack - send.wl2) < 0)) {
+                        return;
+                }
+                bool was_closed = send_window_room() == 0;
+                init_send_window(seq, ack, wnd);
+                if (was_closed && send_window_room() != 0) {
+                        timer_wheel::instance().cancel(persist_timer);
+                        persist_timer   = 0;
+                        persist_backoff = 0;
+                        if (send_queued_bytes != 0) active_self();
+                }
+        }
+
+        // RFC 9293 section 3.8.6.1: queued data waits on a closed window; probe with
+        // <SEQ=SND.UNA-1> until an ACK reopens it (a lost window update would deadlock)
+        void arm_persist_timer() {
+                if (persist_timer != 0) return;
+                uint32_t             delay = std::min<uint32_t>(PERSIST_MIN_MS << persist_backoff, PERSIST_MAX_MS);
+                std::weak_ptr<tcb_t> weak  = weak_from_this();
+                persist_timer = timer_wheel::instance().schedule(std::chrono::milliseconds(delay), [weak]() {
+                        std::shared_ptr<tcb_t> tcb = weak.lock();
+                        if (!tcb) return;
+                        tcb->persist_timer = 0;
+                        if (tcb->send_queued_bytes == 0 || tcb->send_window_room() != 0) return;
+                        if (tcb->state != TCP_ESTABLISHED && tcb->state != TCP_CLOSE_WAIT) return;
+                        tcb->queue_probe(tcb->send.unacknowledged - 1);
+                        DLOG(INFO) << "[ZERO WINDOW PROBE] " << *tcb << " backoff=" << int(tcb->persist_backoff);
+                        if (PERSIST_MIN_MS << tcb->persist_backoff < PERSIST_MAX_MS) tcb->persist_backoff++;
+                        tcb->arm_persist_timer();
+                });
+        }
+
         void enqueue_send(raw_packet packet) {
+                send_queued_bytes += packet.buffer->get_remaining_len();
                 send_queue.push_back(std::move(packet));
                 active_self();
         }
 
+        // Seed the send MSS from the PMTU cache when the TCB is created
+        void init_mss(uint16_t path_mss) {
+                pmtu_generation = pmtu_cache::instance().generation();
+                send.mss        = path_mss;
+                if (pmtu_config::plpmtud_enabled()) {
+                        plpmtud.init(path_mss);
+                        send.mss = plpmtud.search_low;
+                }
+        }
+
+        // The peer's SYN MSS option caps what we may send (RFC 9293 section 3.7.1)
+        void clamp_peer_mss(uint16_t peer_mss) {
+                send.mss = std::min(send.mss, peer_mss);
+                if (plpmtud.enabled) {
+                        plpmtud.search_high = std::min(plpmtud.search_high, peer_mss);
+                        plpmtud.search_low  = std::min(plpmtud.search_low, peer_mss);
+                }
+        }
+
+        // Pick up PMTU changes made for this destination by other connections
+        void refresh_mss() {
+                uint32_t generation = pmtu_cache::instance().generation();
+                if (generation == pmtu_generation) return;
+                pmtu_generation = generation;
+
+                uint16_t path_mss = pmtu_cache::instance().query_mss(remote_info->ipv4_addr.value());
+                if (plpmtud.enabled) {
+                        plpmtud.search_high = std::min(plpmtud.search_high, path_mss);
+                        plpmtud.search_low  = std::min(plpmtud.search_low, path_mss);
+                        send.mss            = std::min(send.mss, path_mss);
+                } else {
+                        send.mss = path_mss;
+                }
+                DLOG(INFO) << "[MSS REFRESH] " << *this << " mss=" << send.mss;
+        }
+
+        // PLPMTUD: the probe was fully acknowledged, its size is usable
+        void on_probe_acked(uint32_t ack_no) {
+                if (plpmtud.probe_mss == 0) return;
+                if (static_cast<int32_t>(ack_no - (plpmtud.probe_seq + plpmtud.probe_mss)) < 0) return;
+
+                plpmtud.search_low     = plpmtud.probe_mss;
+                plpmtud.probe_failures = 0;
+                send.mss               = plpmtud.probe_mss;
+                plpmtud.probe_mss      = 0;
+                pmtu_cache::instance().confirm_mtu(remote_info->ipv4_addr.value(),
+                                                   send.mss + pmtu_cache::IP_TCP_HEADER_SIZE);
+                DLOG(INFO) << "[PLPMTUD PROBE ACKED] mss=" << send.mss;
+        }
+
+        // PLPMTUD: the probe was lost; its data is resent at the current MSS
+        void on_probe_lost() {
+                if (plpmtud.probe_mss == 0) return;
+                if (++plpmtud.probe_failures >= plpmtud_state_t::MAX_PROBES) {
+                        plpmtud.search_high    = plpmtud.probe_mss - 1;
+                        plpmtud.probe_failures = 0;
+                }
+                DLOG(INFO) << "[PLPMTUD PROBE LOST] size=" << plpmtud.probe_mss
+                           << " search_high=" << plpmtud.search_high;
+                plpmtud.probe_mss = 0;
+        }
+
         void listen_finish() {
                 if (this->_listener) {
                         _listener.value()->push_back(shared_from_this());
@@ -122,28 +485,27 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
         }
 
         // Track sent segment for retransmission
-        void track_sent_segment(const tcp_packet_t& packet) {
+        // Called by make_packet() for fresh data only, retransmissions are already tracked
+        // A pinned payload is referenced instead of copied
+        void track_sent_segment(const tcp_packet_t& packet, pinned_payload_t pinned = {}) {
                 // Only track data segments (not pure ACKs)
                 // Data segments have payload beyond TCP header
-                size_t tcp_header_size = tcp_header_t::size();
-                size_t total_size = packet.buffer->get_remaining_len();
+                uint8_t*     pointer    = packet.buffer->get_pointer();
+                tcp_header_t header     = tcp_header_t::consume(pointer);
+                int          header_len = header.header_length * 4;
+                int          total_size = packet.buffer->get_remaining_len();
 
-                if (total_size <= tcp_header_size) {
+                if (total_size <= header_len) {
                         return;  // No data payload, just control packet
                 }
 
-                uint32_t data_len = total_size - tcp_header_size;
+                uint32_t data_len = total_size - header_len;
 
-                // Extract data payload (skip TCP header)
-                std::vector<uint8_t> full_packet(total_size);
-                int extracted_len = total_size;
-                const_cast<base_packet*>(packet.buffer.get())->export_data(full_packet.data(), extracted_len);
-
-                // Data starts after TCP header
-                const uint8_t* data_start = full_packet.data() + tcp_header_size;
+                // Data starts after TCP header (and options)
+                const uint8_t* data_start = pointer + header_len;
 
                 // Create retransmit entry
-                retransmit_entry_t entry(send.next, data_len, data_start);
+                retransmit_entry_t entry(header.seq_no, data_len, data_start, std::move(pinned));
                 retransmit_queue.push_back(std::move(entry));
 
                 // Update bytes in flight (FIX: actually call this!)
@@ -179,39 +541,47 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
                 // Find segment in retransmit queue
                 for (auto& entry : retransmit_queue) {
                         if (entry.seq_no == seq_no) {
-                                // Found the segment - create new TCP packet for retransmission
-
-                                // Create buffer for TCP header + data
-                                size_t total_size = tcp_header_t::size() + entry.data_len;
-                                auto out_buffer = std::make_unique<base_packet>(total_size);
-
-                                // Build TCP header
-                                tcp_header_t out_tcp;
-                                out_tcp.src_port = local_info->port_addr.value();
-                                out_tcp.dst_port = remote_info->port_addr.value();
-                                out_tcp.seq_no = entry.seq_no;  // Original sequence number
-                                out_tcp.ack_no = receive.next;
-                                out_tcp.window_size = 0xFAF0;
-                                out_tcp.header_length = tcp_header_t::size() / 4;
-                                out_tcp.ACK = 1;
-
-                                // Write TCP header
-                                out_tcp.produce(out_buffer->get_pointer());
-
-                                // Copy data payload after TCP header
-                                uint8_t* data_dest = out_buffer->get_pointer() + tcp_header_t::size();
-                                std::memcpy(data_dest, entry.data_copy.data(), entry.data_len);
-
-                                // Create TCP packet
-                                tcp_packet_t out_packet = {
-                                    .proto = 0x06,
-                                    .remote_info = this->remote_info,
-                                    .local_info = this->local_info,
-                                    .buffer = std::move(out_buffer)
-                                };
-
-                                // Add to control packet queue (priority send)
-                                ctl_packets.push_back(std::move(out_packet));
+                                // Found the segment - create new TCP packets for retransmission.
+                                // Resend at the current MSS: it may have shrunk since the
+                                // original transmission (ICMP Fragmentation Needed, lost probe)
+                                refresh_mss();
+                                uint32_t offset = 0;
+                                while (offset < entry.data_len) {
+                                        uint32_t chunk_len = std::min<uint32_t>(send.mss, entry.data_len - offset);
+
+                                        // Create buffer for TCP header + data
+                                        size_t total_size = tcp_header_t::size() + chunk_len;
+                                        auto out_buffer = std::make_unique<base_packet>(total_size);
+
+                                        // Build TCP header
+                                        tcp_header_t out_tcp;
+                                        out_tcp.src_port = local_info->port_addr.value();
+                                        out_tcp.dst_port = remote_info->port_addr.value();
+                                        out_tcp.seq_no = entry.seq_no + offset;  // Original sequence number
+                                        out_tcp.ack_no = receive.next;
+                                        out_tcp.window_size = receive.window;
+                                        out_tcp.header_length = tcp_header_t::size() / 4;
+                                        out_tcp.ACK = 1;
+
+                                        // Write TCP header
+                                        out_tcp.produce(out_buffer->get_pointer());
+
+                                        // Copy data payload after TCP header
+                                        uint8_t* data_dest = out_buffer->get_pointer() + tcp_header_t::size();
+                                        std::memcpy(data_dest, entry.data() + offset, chunk_len);
+
+                                        // Create TCP packet
+                                        tcp_packet_t out_packet = {
+                                            .proto = 0x06,
+                                            .remote_info = this->remote_info,
+                                            .local_info = this->local_info,
+                                            .buffer = std::move(out_buffer)
+                                        };
+
+                                        // Add to control packet queue (priority send)
+                                        ctl_packets.push_back(std::move(out_packet));
+                                        offset += chunk_len;
+                                }
 
                                 // Update retransmit statistics
                                 entry.retransmit_count++;
@@ -279,28 +649,85 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
         // Returns true if we can send more data (limited by cwnd)
         bool can_send() {
                 // If cwnd not initialized yet, allow initial segment (slow start)
-                if (cwnd == 0) {
+                if (send.cwnd == 0) {
                         return true;  // First segment always allowed
                 }
                 // Congestion control: limit sending to cwnd
-                return bytes_in_flight < cwnd;
+                return send.bytes_in_flight < send.cwnd;
         }
 
-        std::optional<std::unique_ptr<base_packet>> prepare_data_optional(int& option_len) {
-                return std::nullopt;
+        // Cut the next data segment from send_queue: at most one MSS, limited by cwnd and
+        // the peer's window (closed window: the persist timer probes it).
+        // The returned buffer leaves room for the TCP header (+ options) in front.
+        // pinned is set when the whole segment is a slice of one pinned (sendfile) entry.
+        std::optional<std::unique_ptr<base_packet>> prepare_data_optional(int& option_len, pinned_payload_t& pinned) {
+                if (send_queued_bytes == 0) {
+                        return std::nullopt;
+                }
+                if (state != TCP_ESTABLISHED && state != TCP_CLOSE_WAIT) {
+                        return std::nullopt;
+                }
+
+                uint32_t window_room = send_window_room();
+                if (window_room == 0) {
+                        arm_persist_timer();
+                        return std::nullopt;
+                }
+
+                refresh_mss();
+                uint32_t room = send.cwnd == 0 ? send.mss : send.cwnd - send.bytes_in_flight;
+                room          = std::min(room, window_room);
+                uint32_t segment_len = std::min<uint32_t>({send.mss, send_queued_bytes, room});
+
+                // PLPMTUD: send a full-sized probe when there is enough queued data for it
+                uint16_t probe_mss = plpmtud.next_probe_mss();
+                if (probe_mss != 0 && send_queued_bytes >= probe_mss && room >= probe_mss) {
+                        segment_len       = probe_mss;
+                        plpmtud.probe_mss = probe_mss;
+                        plpmtud.probe_seq = send.next;
+                        DLOG(INFO) << "[PLPMTUD PROBE] seq=" << send.next << " size=" << probe_mss;
+                }
+                if (segment_len == 0) {
+                        return std::nullopt;
+                }
+
+                int header_len = tcp_header_t::size() + option_len;
+                auto out_buffer = std::make_unique<base_packet>(header_len + segment_len);
+                uint8_t* data_dest = out_buffer->get_pointer() + header_len;
+
+                uint32_t copied = 0;
+                while (copied < segment_len) {
+                        raw_packet& front = send_queue.front();
+                        uint32_t chunk_len = std::min<uint32_t>(front.buffer->get_remaining_len(),
+                                                                segment_len - copied);
+                        if (copied == 0 && chunk_len == segment_len && front.buffer->pin()) {
+                                pinned = {.pin = front.buffer->pin(), .data = front.buffer->get_pointer()};
+                        }
+                        std::memcpy(data_dest + copied, front.buffer->get_pointer(), chunk_len);
+                        front.buffer->add_offset(chunk_len);
+                        copied += chunk_len;
+                        if (front.buffer->get_remaining_len() == 0) {
+                                send_queue.pop_front();
+                        }
+                }
+                send_queued_bytes -= segment_len;
+                return std::move(out_buffer);
         }
 
         std::optional<tcp_packet_t> make_packet() {
                 tcp_header_t                 out_tcp;
                 std::unique_ptr<base_packet> out_buffer;
 
-                int option_len = 0;
+                int option_len  = 0;
+                int payload_len = 0;
 
+                pinned_payload_t                            pinned;
                 std::optional<std::unique_ptr<base_packet>> data_buffer =
-                        prepare_data_optional(option_len);
+                        prepare_data_optional(option_len, pinned);
 
                 if (data_buffer) {
-                        out_buffer = std::move(data_buffer.value());
+                        out_buffer  = std::move(data_buffer.value());
+                        payload_len = out_buffer->get_remaining_len() - tcp_header_t::size() - option_len;
                 } else {
                         out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
                 }
@@ -310,8 +737,7 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
                 out_tcp.ack_no   = receive.next;
                 out_tcp.seq_no   = send.next;
 
-                // TODO
-                out_tcp.window_size   = 0xFAF0;
+                out_tcp.window_size   = receive.window;
                 out_tcp.header_length = (tcp_header_t::size() + option_len) / 4;
 
                 out_tcp.ACK = 1;
@@ -320,13 +746,37 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
                         out_tcp.SYN = 1;
                 }
 
+                if (payload_len > 0 && send_queue.empty()) {
+                        out_tcp.PSH = 1;
+                }
+
+                // RFC 9293 section 3.10.4: FIN once all queued data has been segmented
+                bool send_fin = fin_pending && !fin_sent && send_queued_bytes == 0 &&
+                                (next_state == TCP_ESTABLISHED || next_state == TCP_CLOSE_WAIT);
+                if (send_fin) {
+                        out_tcp.FIN = 1;
+                        fin_sent    = true;
+                        next_state  = next_state == TCP_ESTABLISHED ? TCP_FIN_WAIT_1 : TCP_LAST_ACK;
+                }
+
                 out_tcp.produce(out_buffer->get_pointer());
                 tcp_packet_t out_packet = {.proto       = 0x06,
                                            .remote_info = this->remote_info,
                                            .local_info  = this->local_info,
                                            .buffer      = std::move(out_buffer)};
+                if ((payload_len > 0 || send_fin) && send.unacknowledged == send.next) {
+                        // First byte outstanding: the user timeout counts from here
+                        ack_progress_tick = timer_wheel::instance().now_tick();
+                }
+                if (payload_len > 0) {
+                        track_sent_segment(out_packet, std::move(pinned));
+                        send.next += payload_len;
+                }
+                if (send_fin) {
+                        send.next += 1;
+                }
                 if (this->next_state != this->state) {
-                        this->state = this->next_state;
+                        enter_state(this->next_state);
                 }
                 return std::move(out_packet);
         }
@@ -335,6 +785,10 @@ struct tcb_t : public std::enable_shared_from_this<tcb_t> {
                 if (!ctl_packets.empty()) {
                         return std::move(ctl_packets.pop_front());
                 }
+                // Only the SYN / SYN-ACK (ctl_packets) may leave before the handshake completes
+                if (state == TCP_SYN_SENT || state == TCP_SYN_RECEIVED) {
+                        return std::nullopt;
+                }
                 if (can_send()) {
                         return make_packet();
                 }
@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <map>
 #include <memory>
@@ -6,17 +9,33 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "circle_buffer.hpp"
 #include "defination.hpp"
+#include "icmp_rate_limiter.hpp"
 #include "packets.hpp"
+#include "port_allocator.hpp"
 #include "socket.hpp"
+#include "syn_cookie.hpp"
+#include "syn_queue.hpp"
 #include "tcb.hpp"
 #include "tcp_transmit.hpp"
-#include "socket_manager.hpp"
+#include "timer_wheel.hpp"
+#include "timewait.hpp"
 
 namespace uStack {
 
+// Socket notifications from the TCP layer. socket_manager.hpp includes this header, so the
+// bodies follow socket_manager there (included at the end of this file)
+struct socket_events {
+        static void listener_acceptable(std::shared_ptr<listener_t> listener);
+        static void socket_readable(std::shared_ptr<tcb_t> tcb);
+        static void socket_writable(std::shared_ptr<tcb_t> tcb);
+        static void connect_complete(std::shared_ptr<tcb_t> tcb);
+        static void tcb_closed(std::shared_ptr<tcb_t> tcb);
+};
+
 // Default global connection limits
 namespace connection_limits {
         // Maximum concurrent TCP connections (can be overridden by MAX_CONNECTIONS env var)
@@ -75,8 +94,99 @@ namespace connection_limits {
                 }
                 return DEFAULT_MAX_BACKLOG;
         }
+
+        // SYN flood protection (RFC 4987)
+        static const uint32_t DEFAULT_MAX_HALF_OPEN         = 1024;  // SYN-RECEIVED table size
+        static const uint32_t DEFAULT_SYN_COOKIE_THRESHOLD  = 256;   // Half-open entries before cookies
+        static const uint32_t SYN_COOKIES_OFF               = 0;
+        static const uint32_t SYN_COOKIES_ON_OVERFLOW       = 1;
+        static const uint32_t SYN_COOKIES_ALWAYS            = 2;
+
+        // Format: MAX_HALF_OPEN=4096, SYN_COOKIE_THRESHOLD=512
+        inline uint32_t get_limit(const char* env_var_name, uint32_t default_limit) {
+                const char* env_limit = std::getenv(env_var_name);
+                if (env_limit) {
+                        try {
+                                uint32_t limit = std::stoul(env_limit);
+                                if (limit > 0) return limit;
+                        } catch (...) {
+                                // Invalid env var, fall through to default
+                        }
+                }
+                return default_limit;
+        }
+
+        // TIME-WAIT (RFC 9293 section 3.4.2): 2*MSL with MSL = 30 s
+        static const uint32_t DEFAULT_TIME_WAIT_SECONDS = 60;    // TIME_WAIT_SECONDS
+        static const uint32_t DEFAULT_MAX_TIME_WAIT     = 4096;  // MAX_TIME_WAIT, oldest recycled
+
+        // Active open: SYN retransmissions before ETIMEDOUT (TCP_SYN_RETRIES), first RTO
+        // 1 s doubling each time (RFC 6298 section 2.1 / 5.5)
+        static const uint32_t DEFAULT_SYN_RETRIES = 6;
+        static const uint32_t INITIAL_RTO_MS      = 1000;
+
+        // Close: FIN retransmissions before the connection is reset (TCP_ORPHAN_RETRIES),
+        // and how long an orphaned FIN-WAIT-2 waits for the peer's FIN (TCP_FIN_TIMEOUT)
+        static const uint32_t DEFAULT_ORPHAN_RETRIES      = 8;
+        static const uint32_t DEFAULT_FIN_TIMEOUT_SECONDS = 60;
+
+        // Dead peer detection defaults for new connections: keepalive off unless TCP_KEEPALIVE=1,
+        // TCP_KEEPALIVE_TIME / TCP_KEEPALIVE_INTVL in seconds, TCP_KEEPALIVE_PROBES probes,
+        // TCP_USER_TIMEOUT in ms (0 = off)
+        static const uint32_t DEFAULT_KEEPALIVE_TIME_SECONDS  = 7200;
+        static const uint32_t DEFAULT_KEEPALIVE_INTVL_SECONDS = 75;
+        static const uint32_t DEFAULT_KEEPALIVE_PROBES        = 9;
+        static const uint32_t DEFAULT_USER_TIMEOUT_MS         = 0;
+
+        inline liveness_config_t get_liveness_defaults() {
+                liveness_config_t config;
+                config.keepalive          = get_limit("TCP_KEEPALIVE", 0) != 0;
+                config.keepalive_idle_ms  = get_limit("TCP_KEEPALIVE_TIME", DEFAULT_KEEPALIVE_TIME_SECONDS) * 1000;
+                config.keepalive_intvl_ms = get_limit("TCP_KEEPALIVE_INTVL", DEFAULT_KEEPALIVE_INTVL_SECONDS) * 1000;
+                config.keepalive_count    = std::min<uint32_t>(
+                        get_limit("TCP_KEEPALIVE_PROBES", DEFAULT_KEEPALIVE_PROBES), UINT8_MAX);
+                config.user_timeout_ms    = get_limit("TCP_USER_TIMEOUT", DEFAULT_USER_TIMEOUT_MS);
+                return config;
+        }
+
+        // Send buffer per connection (TCP_SNDBUF bytes, unsent + unacknowledged); write() is
+        // cut short when it is full and the writer is woken at TCP_SNDLOWAT (default half)
+        static const uint32_t DEFAULT_SEND_BUFFER = 256 * 1024;
+
+        // Receive buffer per connection (TCP_RCVBUF bytes, queued plus lent out by
+        // read_zerocopy()); RCV.WND is what is left of it. No window scaling: at most 65535
+        static const uint32_t DEFAULT_RECEIVE_BUFFER = 0xFAF0;
+
+        // Closed TCBs released per event loop iteration (REAP_BUDGET)
+        static const uint32_t DEFAULT_REAP_BUDGET = 64;
+
+        // Format: SYN_COOKIES=0 (never), 1 (when the queues overflow, default), 2 (always)
+        inline uint32_t get_syn_cookie_mode() {
+                const char* env_mode = std::getenv("SYN_COOKIES");
+                if (env_mode) {
+                        try {
+                                uint32_t mode = std::stoul(env_mode);
+                                if (mode <= SYN_COOKIES_ALWAYS) return mode;
+                        } catch (...) {
+                                // Invalid env var, fall through to default
+                        }
+                }
+                return SYN_COOKIES_ON_OVERFLOW;
+        }
 }  // namespace connection_limits
 
+// Passive open / SYN flood statistics
+struct syn_stats_t {
+        uint32_t half_open      = 0;  // Current SYN-RECEIVED entries
+        uint32_t half_open_peak = 0;
+        uint64_t syn_received   = 0;
+        uint64_t syn_dropped    = 0;  // Table full with cookies disabled
+        uint64_t expired        = 0;  // Half-open entries that never completed
+        uint64_t cookies_sent   = 0;
+        uint64_t cookies_valid  = 0;  // Connections established from a cookie
+        uint64_t cookies_failed = 0;  // ACKs on a listener matching neither table nor cookie
+};
+
 // Per-port connection statistics
 struct port_connection_stats_t {
         uint32_t current = 0;           // Current connections on this port
@@ -89,7 +199,7 @@ struct port_connection_stats_t {
 namespace docs {
 static const char* tcb_manager_doc = R"(
 FILE: tcb_manager.hpp
-PURPOSE: TCP Control Block manager. Methods: receive(), gather_packet(), listen(), register_listener().
+PURPOSE: TCP Control Block manager. Methods: receive(), gather_packet(), listen(), register_listener(), connect(), close(), abort().
 
 SINGLETON PATTERN:
 tcb_manager& mgr = tcb_manager::instance();
@@ -98,11 +208,50 @@ CURRENT IMPLEMENTATION NOTES:
 - No connection timeout
 - No connection limits
 - No maximum TCB count
-- No TIME_WAIT enforcement (immediate state transition)
+
+ACTIVE OPEN:
+- connect() takes an ephemeral port from port_allocator when the local port is 0,
+  skipping ports whose tuple with the peer is still in TIME-WAIT
+- SYN retransmitted from a timer_wheel timer, RTO 1 s doubling, TCP_SYN_RETRIES tries
+- Completion (ESTABLISHED, refused, timed out) is reported via socket_manager::on_connect_complete()
+
+TIME-WAIT:
+- On entering TIME-WAIT the tcb_t is released (release_tcb) and replaced by a
+  timewait_table_t entry; it no longer counts against MAX_CONNECTIONS
+- Segments for the tuple are answered from the entry (ACK, FIN restarts 2*MSL)
+- A new SYN with SEG.SEQ > RCV.NXT ends TIME-WAIT early (RFC 6191 without timestamps)
 - Linear search of active_tcbs (O(n) for n active connections)
 - No connection pooling or reuse
-- No half-open connection detection
-- No syn-flood protection
+
+PASSIVE OPEN (SYN flood resistance, RFC 4987):
+- SYN on a listening port -> 20 byte half_open_t in syn_queue, SYN-ACK from ctl_packets
+- No tcb_t exists until the final ACK; half-open entries don't count against MAX_CONNECTIONS
+- Half-open table past SYN_COOKIE_THRESHOLD, listener backlog full, or the
+  listener's half-open count past its backlog -> stateless SYN cookie instead
+- Final ACK matching an entry or a valid cookie -> TCB created directly in ESTABLISHED
+- An ACK that does not acknowledge the entry's ISS (or a RST off RCV.NXT) leaves it in place
+- No SYN-ACK retransmission timer: a retransmitted SYN re-sends it from the entry
+
+CLOSE (RFC 9293 section 3.10.4):
+- close() orphans the TCB (socket_fd = -1); the FIN follows the queued data
+- One close_timer per closing TCB, armed once the FIN is sent: after an RTO without
+  SND.UNA progress it resends the FIN (and the oldest unacknowledged segment) with
+  backoff, reset after TCP_ORPHAN_RETRIES; every SND.UNA advance restarts it at 1 s
+- Orphaned FIN-WAIT-2 is dropped after TCP_FIN_TIMEOUT; unread data or abort -> RST
+- unlisten() resets connections still waiting in the accept queue
+
+DEAD PEER DETECTION:
+- Keepalive (idle / interval / count) and RFC 5482 user timeout, per TCB (set_liveness)
+- One lazy timer_wheel timer per TCB: receiving a segment only stores a tick, no
+  timer is touched on the data path; idle connections cost one timer each
+- Dead peers are aborted (RST, ETIMEDOUT) and reaped like any closed TCB
+
+CONNECTION REAPING:
+- tcb_t::enter_state(TCP_CLOSED) pushes the TCB onto reap_tcbs
+- reap_closed_connections(budget) runs once per event loop iteration, so
+  connection churn costs O(churn), not O(total connections)
+- A gracefully closed TCB stays with its socket: read() returns the queued data,
+  then end of stream; a reset one is detached and read() fails with the error
 
 MEMORY USAGE:
 - Each TCB: ~200+ bytes (data structures, pointers)
@@ -122,11 +271,35 @@ THREADING:
 class tcb_manager {
 private:
         tcb_manager() : active_tcbs(std::make_shared<circle_buffer<std::shared_ptr<tcb_t>>>()),
+                        reap_tcbs(std::make_shared<circle_buffer<std::shared_ptr<tcb_t>>>()),
                         max_connections(connection_limits::get_max_connections()),
                         total_connections_created(0),
-                        peak_connections(0) {}
+                        peak_connections(0),
+                        max_half_open(connection_limits::get_limit(
+                                "MAX_HALF_OPEN", connection_limits::DEFAULT_MAX_HALF_OPEN)),
+                        syn_cookie_threshold(connection_limits::get_limit(
+                                "SYN_COOKIE_THRESHOLD", connection_limits::DEFAULT_SYN_COOKIE_THRESHOLD)),
+                        syn_cookie_mode(connection_limits::get_syn_cookie_mode()),
+                        timewait(std::chrono::seconds(connection_limits::get_limit(
+                                         "TIME_WAIT_SECONDS", connection_limits::DEFAULT_TIME_WAIT_SECONDS)),
+                                 connection_limits::get_limit("MAX_TIME_WAIT",
+                                                              connection_limits::DEFAULT_MAX_TIME_WAIT)),
+                        max_syn_retries(connection_limits::get_limit("TCP_SYN_RETRIES",
+                                                                     connection_limits::DEFAULT_SYN_RETRIES)),
+                        max_orphan_retries(connection_limits::get_limit("TCP_ORPHAN_RETRIES",
+                                                                        connection_limits::DEFAULT_ORPHAN_RETRIES)),
+                        fin_timeout(std::chrono::seconds(connection_limits::get_limit(
+                                "TCP_FIN_TIMEOUT", connection_limits::DEFAULT_FIN_TIMEOUT_SECONDS))),
+                        default_liveness(connection_limits::get_liveness_defaults()),
+                        send_buffer_limit(connection_limits::get_limit("TCP_SNDBUF",
+                                                                       connection_limits::DEFAULT_SEND_BUFFER)),
+                        send_low_watermark(connection_limits::get_limit("TCP_SNDLOWAT", send_buffer_limit / 2)),
+                        receive_buffer_limit(std::min<uint32_t>(
+                                connection_limits::get_limit("TCP_RCVBUF", connection_limits::DEFAULT_RECEIVE_BUFFER),
+                                0xFFFF)) {}
         ~tcb_manager() = default;
         std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>       active_tcbs;
+        std::shared_ptr<circle_buffer<std::shared_ptr<tcb_t>>>       reap_tcbs;  // Entered CLOSED, not yet released
         std::unordered_map<two_ends_t, std::shared_ptr<tcb_t>>       tcbs;
         std::unordered_set<ipv4_port_t>                              active_ports;
         std::unordered_map<ipv4_port_t, std::shared_ptr<listener_t>> listeners;
@@ -134,6 +307,409 @@ private:
         uint32_t                                                      total_connections_created;
         uint32_t                                                      peak_connections;
         std::map<uint16_t, port_connection_stats_t>                  port_stats;  // Per-port statistics
+        circle_buffer<tcp_packet_t>                                  ctl_packets;  // Segments without a TCB
+        icmp_rate_limiter                                            rst_limiter{  // RSTs for closed ports
+                icmp_limits::get_limit("TCP_RST_RATE", icmp_limits::DEFAULT_ERROR_RATE),
+                icmp_limits::get_limit("TCP_RST_RATE_PER_DEST", icmp_limits::DEFAULT_ERROR_RATE_PER_DEST),
+                icmp_limits::get_limit("ICMP_MAX_DESTINATIONS", icmp_limits::DEFAULT_MAX_DESTINATIONS)};
+        syn_queue_t                                                  syn_queue;
+        syn_cookie_t                                                 syn_cookies;
+        syn_stats_t                                                  syn_stats;
+        uint32_t                                                     max_half_open;
+        uint32_t                                                     syn_cookie_threshold;
+        uint32_t                                                     syn_cookie_mode;
+        timewait_table_t                                             timewait;
+        port_allocator                                               ephemeral_ports;
+        uint32_t                                                     max_syn_retries;
+        uint32_t                                                     max_orphan_retries;
+        std::chrono::milliseconds                                    fin_timeout;
+        liveness_config_t                                            default_liveness;
+        uint32_t                                                     send_buffer_limit;
+        uint32_t                                                     send_low_watermark;
+        uint32_t                                                     receive_buffer_limit;
+        uint64_t                                                     keepalive_timeouts = 0;
+        uint64_t                                                     user_timeouts      = 0;
+
+        static tuple_key_t make_tuple_key(two_ends_t& two_end) {
+                return {.remote_ipv4 = two_end.remote_info->ipv4_addr->get_raw_ipv4(),
+                        .local_ipv4  = two_end.local_info->ipv4_addr->get_raw_ipv4(),
+                        .remote_port = two_end.remote_info->port_addr.value(),
+                        .local_port  = two_end.local_info->port_addr.value()};
+        }
+
+        static syn_cookie_tuple_t make_cookie_tuple(two_ends_t& two_end) {
+                return {.local_ipv4  = two_end.local_info->ipv4_addr->get_raw_ipv4(),
+                        .remote_ipv4 = two_end.remote_info->ipv4_addr->get_raw_ipv4(),
+                        .local_port  = two_end.local_info->port_addr.value(),
+                        .remote_port = two_end.remote_info->port_addr.value()};
+        }
+
+        // RFC 4987 section 3.6: fall back to cookies only when state would overflow
+        bool should_use_syn_cookie(ipv4_port_t local) const {
+                if (syn_cookie_mode == connection_limits::SYN_COOKIES_OFF) return false;
+                if (syn_cookie_mode == connection_limits::SYN_COOKIES_ALWAYS) return true;
+                return syn_queue.size() >= syn_cookie_threshold || is_listener_backlog_full(local) ||
+                       syn_queue.count_for_port(local.port_addr.value()) >=
+                               listeners.at(local)->backlog_stats.max;
+        }
+
+        void handle_syn(two_ends_t& two_end, tcp_header_t& in_tcp, uint8_t* tcp_pointer) {
+                syn_stats.syn_received++;
+                syn_stats.expired += syn_queue.expire();
+
+                tuple_key_t key       = make_tuple_key(two_end);
+                uint16_t    local_mss = pmtu_cache::instance().query_mss(
+                        two_end.remote_info->ipv4_addr.value());
+
+                // Retransmitted SYN: answer with the same ISS
+                if (half_open_t* entry = syn_queue.find(key)) {
+                        if (entry->irs == in_tcp.seq_no) {
+                                entry->retries++;
+                                ctl_packets.push_back(tcp_transmit::make_syn_ack(
+                                        two_end.remote_info.value(), two_end.local_info.value(),
+                                        entry->iss, entry->irs + 1, local_mss));
+                        }
+                        return;
+                }
+
+                // RFC 9293 section 3.7.1: 536 if the peer sent no MSS option
+                uint16_t peer_mss =
+                        tcp_header_t::consume_mss_option(tcp_pointer, in_tcp.header_length).value_or(536);
+
+                if (should_use_syn_cookie(two_end.local_info.value())) {
+                        uint32_t cookie = syn_cookies.make(make_cookie_tuple(two_end), in_tcp.seq_no,
+                                                           std::min(peer_mss, local_mss));
+                        syn_stats.cookies_sent++;
+                        ctl_packets.push_back(tcp_transmit::make_syn_ack(two_end.remote_info.value(),
+                                                                         two_end.local_info.value(),
+                                                                         cookie, in_tcp.seq_no + 1,
+                                                                         local_mss));
+                        return;
+                }
+
+                if (syn_queue.size() >= max_half_open) {
+                        syn_stats.syn_dropped++;
+                        DLOG(WARNING) << "[SYN DROP] Half-open table full " << syn_queue.size();
+                        return;
+                }
+
+                half_open_t entry;
+                entry.irs         = in_tcp.seq_no;
+                entry.iss         = tcp_transmit::generate_iss(two_end.remote_info.value(),
+                                                               two_end.local_info.value());
+                entry.created_ms  = syn_queue_t::now_ms();
+                entry.peer_mss    = peer_mss;
+                entry.peer_window = in_tcp.window_size;
+                syn_queue.insert(key, entry);
+
+                syn_stats.half_open = syn_queue.size();
+                syn_stats.half_open_peak = std::max(syn_stats.half_open_peak, syn_stats.half_open);
+
+                ctl_packets.push_back(tcp_transmit::make_syn_ack(two_end.remote_info.value(),
+                                                                 two_end.local_info.value(), entry.iss,
+                                                                 entry.irs + 1, local_mss));
+        }
+
+        // Final ACK of the three-way handshake: only now is a TCB allocated
+        void complete_handshake(two_ends_t& two_end, tcp_header_t& in_tcp, tcp_packet_t& in_packet) {
+                ipv4_port_t local = two_end.local_info.value();
+                uint32_t    iss;
+                uint32_t    irs;
+                uint16_t    peer_mss;
+
+                // The entry is only removed for an ACK of our SYN: a bogus or spoofed ACK
+                // for the tuple is answered with a RST and the handshake stays pending
+                tuple_key_t  key   = make_tuple_key(two_end);
+                half_open_t* entry = syn_queue.find(key);
+                if (entry) {
+                        if (in_tcp.ack_no != entry->iss + 1) {
+                                ctl_packets.push_back(tcp_transmit::make_rst_reject(
+                                        in_tcp, two_end.remote_info.value(), local, 0));
+                                return;
+                        }
+                        iss      = entry->iss;
+                        irs      = entry->irs;
+                        peer_mss = entry->peer_mss;
+                        syn_queue.take(key);
+                        syn_stats.half_open = syn_queue.size();
+                } else {
+                        std::optional<uint16_t> cookie_mss = syn_cookies.check(
+                                make_cookie_tuple(two_end), in_tcp.ack_no - 1, in_tcp.seq_no - 1);
+                        if (!cookie_mss) {
+                                syn_stats.cookies_failed++;
+                                ctl_packets.push_back(tcp_transmit::make_rst_reject(
+                                        in_tcp, two_end.remote_info.value(), local, 0));
+                                return;
+                        }
+                        syn_stats.cookies_valid++;
+                        iss      = in_tcp.ack_no - 1;
+                        irs      = in_tcp.seq_no - 1;
+                        peer_mss = cookie_mss.value();
+                }
+
+                if (!can_queue_to_backlog(local)) {
+                        DLOG(WARNING) << "[BACKLOG FULL] Rejecting connection"
+                                      << " local=" << local.port_addr.value();
+                        ctl_packets.push_back(
+                                tcp_transmit::make_rst_reject(in_tcp, two_end.remote_info.value(), local, 0));
+                        return;
+                }
+
+                auto listener = this->listeners[local];
+                if (!register_tcb(two_end, listener->acceptors)) {
+                        DLOG(WARNING) << "[REJECT CONNECTION] Limit exceeded"
+                                      << " Remote: " << two_end.remote_info.value();
+                        ctl_packets.push_back(
+                                tcp_transmit::make_rst_reject(in_tcp, two_end.remote_info.value(), local, 0));
+                        return;
+                }
+
+                std::shared_ptr<tcb_t> tcb  = tcbs[two_end];
+                tcb->enter_state(TCP_ESTABLISHED);
+                tcb->receive.next           = irs + 1;
+                tcb->update_receive_window();
+                tcb->send.unacknowledged    = iss + 1;
+                tcb->send.next              = iss + 1;
+                tcb->init_send_window(in_tcp.seq_no, in_tcp.ack_no, in_tcp.window_size);
+                tcb->clamp_peer_mss(peer_mss);
+                tcb->init_congestion_control();
+                tcb->listen_finish();
+                track_backlog_queued(local);
+                socket_events::listener_acceptable(listener);
+
+                // Data or FIN riding on the handshake ACK
+                int header_len = in_tcp.header_length * 4;
+                if (in_tcp.FIN || in_packet.buffer->get_remaining_len() > header_len) {
+                        tcp_transmit::tcp_in(tcb, in_packet);
+                        if (!tcb->receive_queue.empty()) {
+                                socket_events::socket_readable(tcb);
+                        }
+                }
+        }
+
+        void schedule_syn_retransmit(std::shared_ptr<tcb_t> tcb, std::chrono::milliseconds rto) {
+                std::weak_ptr<tcb_t> weak = tcb;
+                tcb->syn_timer            = timer_wheel::instance().schedule(
+                        rto, [this, weak, rto]() { on_syn_timeout(weak, rto); });
+        }
+
+        void on_syn_timeout(std::weak_ptr<tcb_t> weak, std::chrono::milliseconds rto) {
+                std::shared_ptr<tcb_t> tcb = weak.lock();
+                if (!tcb || tcb->state != TCP_SYN_SENT) return;
+
+                if (++tcb->syn_retries > max_syn_retries) {
+                        DLOG(WARNING) << "[CONNECT TIMEOUT] " << *tcb;
+                        tcb->error = ETIMEDOUT;
+                        tcb->release_buffers();
+                        tcb->enter_state(TCP_CLOSED);
+                        socket_events::connect_complete(tcb);
+                        return;
+                }
+                tcp_transmit::tcp_send_syn(tcb, tcb->send.unacknowledged);
+                schedule_syn_retransmit(tcb, rto * 2);
+        }
+
+        void schedule_close_timer(std::shared_ptr<tcb_t> tcb, std::chrono::milliseconds rto) {
+                std::weak_ptr<tcb_t> weak = tcb;
+                tcb->close_timer          = timer_wheel::instance().schedule(
+                        rto, [this, weak, rto]() { on_close_timeout(weak, rto); });
+        }
+
+        // Drives FIN-WAIT-1, CLOSING and LAST-ACK to completion: RTO expired with no SND.UNA
+        // progress, resend the FIN (and the oldest unacknowledged data, which the peer needs
+        // first) with backoff, reset after TCP_ORPHAN_RETRIES
+        void on_close_timeout(std::weak_ptr<tcb_t> weak, std::chrono::milliseconds rto) {
+                std::shared_ptr<tcb_t> tcb = weak.lock();
+                if (!tcb) return;
+                tcb->close_timer = 0;
+                if (tcb->state == TCP_CLOSED || tcb->state == TCP_TIME_WAIT) return;
+
+                if (tcb->state == TCP_FIN_WAIT_2) {
+                        // Our FIN is acknowledged; a half-closed socket may wait for the peer forever
+                        if (tcb->socket_fd == -1) schedule_fin_wait_2_timeout(tcb);
+                        return;
+                }
+                if (++tcb->close_retries > max_orphan_retries) {
+                        DLOG(WARNING) << "[CLOSE TIMEOUT] " << *tcb;
+                        abort(tcb, ETIMEDOUT);
+                        return;
+                }
+                if (!tcb->retransmit_queue.empty()) {
+                        tcb->retransmit_segment(tcb->send.unacknowledged);
+                }
+                tcb->retransmit_fin();
+                tcb->active_self();
+                schedule_close_timer(tcb, rto * 2);
+        }
+
+        // SND.UNA advanced while the FIN is outstanding: the peer is keeping up, so restart
+        // the close timer from the initial RTO instead of backing off further
+        void on_close_progress(std::shared_ptr<tcb_t> tcb) {
+                timer_wheel::instance().cancel(tcb->close_timer);
+                tcb->close_timer   = 0;
+                tcb->close_retries = 0;
+                if (tcb->state == TCP_FIN_WAIT_2) {
+                        if (tcb->socket_fd == -1) schedule_fin_wait_2_timeout(tcb);
+                        return;
+                }
+                if (tcb->has_unacked_data()) {
+                        schedule_close_timer(tcb, std::chrono::milliseconds(connection_limits::INITIAL_RTO_MS));
+                }
+        }
+
+        // An orphaned FIN-WAIT-2 is dropped after TCP_FIN_TIMEOUT (RFC 9293 leaves this open)
+        void schedule_fin_wait_2_timeout(std::shared_ptr<tcb_t> tcb) {
+                std::weak_ptr<tcb_t> weak = tcb;
+                timer_wheel::instance().cancel(tcb->close_timer);
+                tcb->close_timer = timer_wheel::instance().schedule(fin_timeout, [weak]() {
+                        std::shared_ptr<tcb_t> tcb = weak.lock();
+                        if (!tcb || tcb->state != TCP_FIN_WAIT_2) return;
+                        DLOG(INFO) << "[FIN WAIT 2 TIMEOUT] " << *tcb;
+                        tcb->close_timer = 0;
+                        tcb->release_buffers();
+                        tcb->enter_state(TCP_CLOSED);
+                });
+        }
+
+        void schedule_liveness_check(std::shared_ptr<tcb_t> tcb, uint64_t delay_ms) {
+                std::weak_ptr<tcb_t> weak = tcb;
+                tcb->liveness_timer       = timer_wheel::instance().schedule(
+                        std::chrono::milliseconds(delay_ms), [this, weak]() { on_liveness_timeout(weak); });
+        }
+
+        // One lazy timer per TCB: segments only stamp last_heard_tick / ack_progress_tick,
+        // the timer recomputes its deadline from them when it fires
+        void on_liveness_timeout(std::weak_ptr<tcb_t> weak) {
+                std::shared_ptr<tcb_t> tcb = weak.lock();
+                if (!tcb) return;
+                tcb->liveness_timer = 0;
+                const liveness_config_t& config = tcb->liveness;
+                if (tcb->state == TCP_CLOSED || tcb->state == TCP_TIME_WAIT || !config.enabled()) return;
+
+                uint64_t now  = timer_wheel::instance().now_tick();
+                uint64_t next = config.keepalive ? config.keepalive_idle_ms : config.user_timeout_ms;
+
+                // RFC 5482: data unacknowledged for longer than the user timeout ends the connection
+                if (config.user_timeout_ms != 0 && tcb->has_unacked_data()) {
+                        uint64_t stalled = (now - tcb->ack_progress_tick) * timer_wheel::TICK_MS;
+                        if (stalled >= config.user_timeout_ms) {
+                                DLOG(WARNING) << "[USER TIMEOUT] " << *tcb;
+                                user_timeouts++;
+                                abort(tcb, ETIMEDOUT);
+                                return;
+                        }
+                        next = std::min<uint64_t>(next, config.user_timeout_ms - stalled);
+                }
+
+                // RFC 1122 section 4.2.3.6: probe an idle connection, give up after keepalive_count
+                bool idle_state = tcb->state == TCP_ESTABLISHED || tcb->state == TCP_CLOSE_WAIT ||
+                                  tcb->state == TCP_FIN_WAIT_2;
+                if (config.keepalive && idle_state) {
+                        uint64_t idle = (now - tcb->last_heard_tick) * timer_wheel::TICK_MS;
+                        if (idle < config.keepalive_idle_ms) {
+                                tcb->keepalive_probes = 0;
+                                next = std::min<uint64_t>(next, config.keepalive_idle_ms - idle);
+                        } else if (tcb->has_unacked_data()) {
+                                // Outstanding data already tests the peer
+                                next = std::min<uint64_t>(next, config.keepalive_intvl_ms);
+                        } else {
+                                uint64_t due = config.keepalive_idle_ms +
+                                               uint64_t(tcb->keepalive_probes) * config.keepalive_intvl_ms;
+                                if (idle >= due) {
+                                        if (tcb->keepalive_probes >= config.keepalive_count) {
+                                                DLOG(WARNING) << "[KEEPALIVE TIMEOUT] " << *tcb;
+                                                keepalive_timeouts++;
+                                                abort(tcb, ETIMEDOUT);
+                                                return;
+                                        }
+                                        tcb->keepalive_probes++;
+                                        tcb->send_keepalive_probe();
+                                        due = idle + config.keepalive_intvl_ms;
+                                }
+                                next = std::min<uint64_t>(next, due - idle);
+                        }
+                }
+                schedule_liveness_check(tcb, next);
+        }
+
+        // Returns true if the segment was consumed by a TIME-WAIT entry
+        bool receive_in_time_wait(two_ends_t& two_end, tcp_packet_t& in_packet) {
+                tuple_key_t       key   = make_tuple_key(two_end);
+                timewait_entry_t* entry = timewait.find(key);
+                if (!entry) return false;
+
+                tcp_header_t in_tcp = tcp_header_t::consume(in_packet.buffer->get_pointer());
+
+                // RFC 6191: without timestamps, a SYN may reopen the tuple if its
+                // sequence number is above everything seen from the old incarnation
+                if (in_tcp.SYN && !in_tcp.ACK &&
+                    static_cast<int32_t>(in_tcp.seq_no - entry->receive_next) > 0) {
+                        DLOG(INFO) << "[TIME WAIT REUSE] " << two_end;
+                        timewait.mark_reused(key);
+                        return false;
+                }
+
+                // RFC 1337: ignore RST in TIME-WAIT
+                if (in_tcp.RST) return true;
+
+                if (in_tcp.FIN) {
+                        timewait.restart(key);
+                }
+                ctl_packets.push_back(tcp_transmit::make_ack(two_end.remote_info.value(),
+                                                             two_end.local_info.value(),
+                                                             entry->send_next, entry->receive_next));
+                return true;
+        }
+
+        // Replace the TCB by a compact TIME-WAIT entry
+        void enter_time_wait(std::shared_ptr<tcb_t> tcb) {
+                two_ends_t two_end = {.remote_info = tcb->remote_info, .local_info = tcb->local_info};
+                if (tcbs.find(two_end) == tcbs.end()) return;
+
+                DLOG(INFO) << "[TIME WAIT] " << *tcb;
+                timewait.insert(make_tuple_key(two_end), tcb->send.next, tcb->receive.next);
+                release_tcb(two_end);
+        }
+
+        // RFC 9293 section 3.10.7.1: a segment for a connection that does not exist is
+        // answered with a RST built from it (rate limited), unless it is a RST itself
+        void reject_closed_port(two_ends_t& two_end, tcp_packet_t& in_packet) {
+                uint8_t*     tcp_pointer = in_packet.buffer->get_pointer();
+                tcp_header_t in_tcp      = tcp_header_t::consume(tcp_pointer);
+                if (in_tcp.RST) return;
+                if (!rst_limiter.allow(two_end.remote_info->ipv4_addr.value())) {
+                        DLOG(INFO) << "[RST RATE LIMITED] " << two_end.remote_info.value();
+                        return;
+                }
+                int seg_len = in_packet.buffer->get_remaining_len() - in_tcp.header_length * 4 + in_tcp.SYN + in_tcp.FIN;
+                ctl_packets.push_back(tcp_transmit::make_rst_reject(in_tcp, two_end.remote_info.value(),
+                                                                    two_end.local_info.value(), seg_len));
+        }
+
+        void receive_on_listener(two_ends_t& two_end, tcp_packet_t& in_packet) {
+                uint8_t*     tcp_pointer = in_packet.buffer->get_pointer();
+                tcp_header_t in_tcp      = tcp_header_t::consume(tcp_pointer);
+
+                // LISTEN/SYN-RECEIVED: a RST at RCV.NXT just removes the half-open entry
+                if (in_tcp.RST) {
+                        tuple_key_t  key   = make_tuple_key(two_end);
+                        half_open_t* entry = syn_queue.find(key);
+                        if (entry && in_tcp.seq_no == entry->irs + 1) {
+                                syn_queue.take(key);
+                                syn_stats.half_open = syn_queue.size();
+                        }
+                        return;
+                }
+                if (in_tcp.SYN && !in_tcp.ACK) {
+                        handle_syn(two_end, in_tcp, tcp_pointer);
+                        return;
+                }
+                if (in_tcp.ACK && !in_tcp.SYN) {
+                        complete_handshake(two_end, in_tcp, in_packet);
+                        return;
+                }
+                DLOG(INFO) << "[LISTEN DROP] " << in_tcp;
+        }
 
 public:
         tcb_manager(const tcb_manager&) = delete;
@@ -205,6 +781,8 @@ public:
                 return backlog_stats_t();
         }
 
+        syn_stats_t get_syn_stats() const { return syn_stats; }
+
         // Check if listener backlog is at capacity
         bool is_listener_backlog_full(ipv4_port_t port) const {
                 auto it = listeners.find(port);
@@ -246,47 +824,240 @@ public:
                 }
         }
 
-        // Recalculate connection count (clean up closed/cleaned TCBs if any)
-        uint32_t cleanup_closed_connections() {
+        // Drop a TCB from the table and give back its connection slot
+        void release_tcb(two_ends_t& two_end) {
+                auto it = tcbs.find(two_end);
+                if (it == tcbs.end()) return;
+                uint16_t port  = it->second->local_info->port_addr.value();
+                auto     stats = port_stats.find(port);
+                if (stats != port_stats.end() && stats->second.current > 0) {
+                        stats->second.current--;
+                }
+                if (it->second->ephemeral_port) {
+                        ephemeral_ports.release(it->second->local_info->ipv4_addr->get_raw_ipv4(), port);
+                }
+                timer_wheel::instance().cancel(it->second->syn_timer);
+                timer_wheel::instance().cancel(it->second->close_timer);
+                timer_wheel::instance().cancel(it->second->liveness_timer);
+                timer_wheel::instance().cancel(it->second->persist_timer);
+                tcbs.erase(it);
+        }
+
+        timewait_stats_t get_timewait_stats() const { return timewait.get_stats(); }
+
+        // Release up to budget TCBs that entered CLOSED (tcb_t::enter_state queues them).
+        // O(1) per connection: per-port stats, the socket's TCB reference and buffers.
+        uint32_t reap_closed_connections(uint32_t budget) {
                 uint32_t removed = 0;
-                auto it = tcbs.begin();
-                while (it != tcbs.end()) {
-                        if (it->second->state == TCP_CLOSED) {
-                                DLOG(INFO) << "[CLEANUP] Removing closed TCB " << it->first;
-                                // Update per-port stats
-                                uint16_t port = it->second->local_info->port_addr.value();
-                                if (port_stats.find(port) != port_stats.end()) {
-                                        if (port_stats[port].current > 0) {
-                                                port_stats[port].current--;
-                                        }
-                                }
-                                it = tcbs.erase(it);
-                                removed++;
-                        } else {
-                                ++it;
+                while (removed < budget && !reap_tcbs->empty()) {
+                        std::shared_ptr<tcb_t> tcb = reap_tcbs->pop_front().value();
+                        two_ends_t two_end = {.remote_info = tcb->remote_info, .local_info = tcb->local_info};
+
+                        // The tuple may already belong to a newer incarnation
+                        auto it = tcbs.find(two_end);
+                        if (it != tcbs.end() && it->second == tcb) {
+                                DLOG(INFO) << "[REAP] Removing closed TCB " << two_end;
+                                release_tcb(two_end);
                         }
+                        // Resets and aborts flushed the queues when they closed the TCB; after a
+                        // graceful close the socket keeps them until the data is read
+                        socket_events::tcb_closed(tcb);
+                        removed++;
                 }
                 if (removed > 0) {
-                        DLOG(INFO) << "[CLEANUP COMPLETE] Removed " << removed << " closed connections"
+                        DLOG(INFO) << "[REAP COMPLETE] Removed " << removed << " closed connections"
                                    << " Current: " << tcbs.size() << "/" << max_connections;
                 }
                 return removed;
         }
 
+        // Release every closed connection now (no budget)
+        uint32_t cleanup_closed_connections() {
+                return reap_closed_connections(UINT32_MAX);
+        }
+
+        // ICMP Fragmentation Needed for one of our segments (RFC 1191)
+        void on_frag_needed(two_ends_t two_end, uint32_t seq_no, uint16_t mtu) {
+                auto it = tcbs.find(two_end);
+                if (it == tcbs.end()) {
+                        DLOG(INFO) << "[FRAG NEEDED] No TCB for " << two_end;
+                        return;
+                }
+                std::shared_ptr<tcb_t> tcb = it->second;
+
+                // RFC 5927: only trust the message if it quotes data that is in flight
+                if (seq_no - tcb->send.unacknowledged > tcb->send.next - tcb->send.unacknowledged) {
+                        DLOG(WARNING) << "[FRAG NEEDED] Quoted seq out of window " << seq_no;
+                        return;
+                }
+
+                if (!pmtu_cache::instance().lower_mtu(two_end.remote_info->ipv4_addr.value(), mtu)) {
+                        return;
+                }
+                // Other connections to this destination pick the change up via refresh_mss()
+                tcb->refresh_mss();
+
+                // The segment was dropped, resend it right away at the smaller size
+                if (tcb->retransmit_segment(tcb->send.unacknowledged)) {
+                        tcb->active_self();
+                }
+        }
+
         std::optional<tcp_packet_t> gather_packet() {
+                if (!ctl_packets.empty()) {
+                        return std::move(ctl_packets.pop_front());
+                }
                 while (!active_tcbs->empty()) {
                         std::optional<std::shared_ptr<tcb_t>> tcb = active_tcbs->pop_front();
                         if (!tcb) continue;
                         std::optional<tcp_packet_t> tcp_packet = tcb.value()->gather_packet();
+                        // The FIN just went out: time its acknowledgment from here, not from close()
+                        if (tcb.value()->fin_sent && !tcb.value()->close_timer && tcb.value()->has_unacked_data() &&
+                            tcb.value()->state != TCP_CLOSED) {
+                                schedule_close_timer(tcb.value(),
+                                                     std::chrono::milliseconds(connection_limits::INITIAL_RTO_MS));
+                        }
+                        if (tcb.value()->state == TCP_TIME_WAIT) {
+                                // The ACK of the peer's FIN is out, only the tuple is needed now
+                                enter_time_wait(tcb.value());
+                        }
                         if (tcp_packet) {
-                                // NEW: Track segment for retransmission (if it contains data)
-                                tcb.value()->track_sent_segment(tcp_packet.value());
+                                // Data segments are tracked for retransmission by tcb_t::make_packet()
                                 return tcp_packet;
                         }
                 }
                 return std::nullopt;
         }
 
+        // Active open (RFC 9293 section 3.10.1): allocate an ephemeral port if the local
+        // port is 0, send SYN and arm its retransmission. Sets errno on failure.
+        std::optional<std::shared_ptr<tcb_t>> connect(ipv4_port_t local_info, ipv4_port_t remote_info,
+                                                      int socket_fd) {
+                uint32_t local_ipv4 = local_info.ipv4_addr->get_raw_ipv4();
+                bool     ephemeral  = !local_info.port_addr || local_info.port_addr.value() == 0;
+                if (ephemeral) {
+                        // Ports go back to the allocator when their connection enters TIME-WAIT:
+                        // skip those whose tuple with this peer is still taken, holding them
+                        // until a usable port is found
+                        std::optional<uint16_t> port;
+                        std::vector<uint16_t>   skipped;
+                        while ((port = ephemeral_ports.allocate(local_ipv4))) {
+                                two_ends_t candidate = {.remote_info = remote_info,
+                                                        .local_info  = ipv4_port_t{.ipv4_addr = local_info.ipv4_addr,
+                                                                                   .port_addr = port.value()}};
+                                if (tcbs.find(candidate) == tcbs.end() && !timewait.find(make_tuple_key(candidate))) {
+                                        break;
+                                }
+                                skipped.push_back(port.value());
+                        }
+                        for (uint16_t taken : skipped) {
+                                ephemeral_ports.release(local_ipv4, taken);
+                        }
+                        if (!port) {
+                                errno = EADDRNOTAVAIL;
+                                return std::nullopt;
+                        }
+                        local_info.port_addr = port.value();
+                }
+
+                two_ends_t two_end = {.remote_info = remote_info, .local_info = local_info};
+                if (tcbs.find(two_end) != tcbs.end() || timewait.find(make_tuple_key(two_end)) ||
+                    !register_tcb(two_end, std::nullopt)) {
+                        if (ephemeral) ephemeral_ports.release(local_ipv4, local_info.port_addr.value());
+                        errno = tcbs.find(two_end) != tcbs.end() ? EADDRINUSE : EAGAIN;
+                        return std::nullopt;
+                }
+
+                std::shared_ptr<tcb_t> tcb  = tcbs[two_end];
+                uint32_t               iss  = tcp_transmit::generate_iss(remote_info, local_info);
+                tcb->socket_fd              = socket_fd;
+                tcb->ephemeral_port         = ephemeral;
+                tcb->send.unacknowledged    = iss;
+                tcb->send.next              = iss + 1;
+                tcb->enter_state(TCP_SYN_SENT);
+
+                tcp_transmit::tcp_send_syn(tcb, iss);
+                schedule_syn_retransmit(tcb, std::chrono::milliseconds(connection_limits::INITIAL_RTO_MS));
+                return tcb;
+        }
+
+        liveness_config_t get_default_liveness() const { return default_liveness; }
+        uint64_t          get_keepalive_timeouts() const { return keepalive_timeouts; }
+        uint64_t          get_user_timeouts() const { return user_timeouts; }
+
+        // Apply keepalive / user timeout settings and (re)arm the liveness timer
+        void set_liveness(std::shared_ptr<tcb_t> tcb, liveness_config_t config) {
+                timer_wheel::instance().cancel(tcb->liveness_timer);
+                tcb->liveness_timer   = 0;
+                tcb->liveness         = config;
+                tcb->keepalive_probes = 0;
+                if (!config.enabled()) return;
+
+                uint64_t first_check = config.keepalive ? config.keepalive_idle_ms : config.user_timeout_ms;
+                if (config.user_timeout_ms != 0) {
+                        first_check = std::min<uint64_t>(first_check, config.user_timeout_ms);
+                }
+                schedule_liveness_check(tcb, first_check);
+        }
+
+        // RFC 9293 section 3.10.5 ABORT: <SEQ=SND.NXT><CTL=RST> in synchronized states,
+        // flush the queues and enter CLOSED (the reaper detaches the socket)
+        void abort(std::shared_ptr<tcb_t> tcb, int error) {
+                if (tcb->state == TCP_CLOSED) return;
+                if (tcb->state != TCP_SYN_SENT && tcb->state != TCP_LISTEN) {
+                        ctl_packets.push_back(tcp_transmit::make_rst(tcb->remote_info.value(),
+                                                                     tcb->local_info.value(), tcb->send.next));
+                }
+                tcb->error = error;
+                tcb->release_buffers();
+                tcb->enter_state(TCP_CLOSED);
+        }
+
+        // shutdown(SHUT_WR): FIN after the queued data, retransmitted until acknowledged
+        // (the close timer is armed by gather_packet() once the FIN is sent)
+        void shutdown_send(std::shared_ptr<tcb_t> tcb) {
+                if (tcb->fin_pending) return;
+                tcb->shutdown_send();
+        }
+
+        // RFC 9293 section 3.10.4 CLOSE. The socket lets go of the TCB at once; an orphaned
+        // TCB finishes FIN-WAIT / LAST-ACK on its own and is reaped or moved to TIME-WAIT.
+        void close(std::shared_ptr<tcb_t> tcb, bool abortive) {
+                tcb->socket_fd = -1;
+                switch (tcb->state) {
+                        case TCP_CLOSED:
+                                return;
+                        case TCP_SYN_SENT:
+                                // Delete the TCB, nothing was synchronized
+                                timer_wheel::instance().cancel(tcb->syn_timer);
+                                tcb->release_buffers();
+                                tcb->enter_state(TCP_CLOSED);
+                                return;
+                }
+                // RFC 2525 section 2.17: closing with unread data resets the connection
+                if (abortive || !tcb->receive_queue.empty()) {
+                        abort(tcb, ECONNRESET);
+                        return;
+                }
+                if (tcb->state == TCP_FIN_WAIT_2) {
+                        schedule_fin_wait_2_timeout(tcb);
+                        return;
+                }
+                shutdown_send(tcb);
+        }
+
+        // Stop listening: connections nobody accepted are reset
+        void unlisten(ipv4_port_t ipv4_port) {
+                auto it = listeners.find(ipv4_port);
+                if (it == listeners.end()) return;
+                while (std::optional<std::shared_ptr<tcb_t>> tcb = it->second->acceptors->pop_front()) {
+                        abort(tcb.value(), ECONNRESET);
+                }
+                listeners.erase(it);
+                active_ports.erase(ipv4_port);
+                DLOG(INFO) << "[UNLISTEN] " << ipv4_port;
+        }
+
         void listen_port(ipv4_port_t ipv4_port, std::shared_ptr<listener_t> listener) {
                 this->listeners[ipv4_port] = listener;
                 active_ports.insert(ipv4_port);
@@ -344,9 +1115,15 @@ public:
                            << " (Global: " << (tcbs.size() + 1) << "/" << max_connections << ")"
                            << " (Port " << port << ": " << (port_current + 1) << "/" << port_max << ")";
 
-                std::shared_ptr<tcb_t> tcb = std::make_shared<tcb_t>(this->active_tcbs, listener,
+                std::shared_ptr<tcb_t> tcb = std::make_shared<tcb_t>(this->active_tcbs, this->reap_tcbs, listener,
                                                                      two_end.remote_info.value(),
                                                                      two_end.local_info.value());
+                tcb->init_mss(pmtu_cache::instance().query_mss(two_end.remote_info->ipv4_addr.value()));
+                tcb->last_heard_tick    = timer_wheel::instance().now_tick();
+                tcb->send_buffer_limit    = send_buffer_limit;
+                tcb->send_low_watermark   = send_low_watermark;
+                tcb->receive_buffer_limit = receive_buffer_limit;
+                set_liveness(tcb, default_liveness);
                 tcbs[two_end] = tcb;
 
                 // Track global statistics
@@ -372,48 +1149,55 @@ public:
                 two_ends_t two_end = {.remote_info = in_packet.remote_info,
                                       .local_info  = in_packet.local_info};
                 if (tcbs.find(two_end) != tcbs.end()) {
-                        tcp_transmit::tcp_in(tcbs[two_end], in_packet);
-                        // Notify socket manager if data arrived
-                        if (!tcbs[two_end]->receive_queue.empty()) {
-                                socket_manager::instance().mark_socket_readable(tcbs[two_end]);
+                        std::shared_ptr<tcb_t> tcb        = tcbs[two_end];
+                        int                    prev_state = tcb->state;
+                        uint32_t               prev_una   = tcb->send.unacknowledged;
+                        tcb->last_heard_tick              = timer_wheel::instance().now_tick();
+                        tcp_transmit::tcp_in(tcb, in_packet);
+                        if (prev_state == TCP_SYN_RECEIVED && tcb->state == TCP_ESTABLISHED && tcb->_listener) {
+                                // Passive open through a SYN-RECEIVED TCB: queue it if the backlog has room
+                                ipv4_port_t local = tcb->local_info.value();
+                                if (!can_queue_to_backlog(local)) {
+                                        DLOG(WARNING) << "[BACKLOG FULL] Rejecting connection"
+                                                      << " local=" << local.port_addr.value();
+                                        abort(tcb, ECONNREFUSED);
+                                        return;
+                                }
+                                tcb->listen_finish();
+                                track_backlog_queued(local);
                         }
-                } else if (active_ports.find(in_packet.local_info.value()) != active_ports.end()) {
-                        // Try to register new TCB
-                        bool registered = register_tcb(two_end,
-                                                       this->listeners[in_packet.local_info.value()]->acceptors);
-
-                        if (!registered) {
-                                // NEW: Connection limit exceeded - send RST to reject
-                                DLOG(WARNING) << "[REJECT CONNECTION] Limit exceeded"
-                                              << " Remote: " << in_packet.remote_info.value();
-                                tcp_header_t in_tcp = tcp_header_t::consume(in_packet.buffer->get_pointer());
-                                tcp_transmit::tcp_send_rst_reject(in_tcp, in_packet.remote_info.value(),
-                                                                   in_packet.local_info.value(), 0);
-                                return;
+                        if (tcb->close_timer && tcb->send.unacknowledged != prev_una && tcb->state != TCP_CLOSED &&
+                            tcb->state != TCP_TIME_WAIT) {
+                                on_close_progress(tcb);
                         }
-
-                        if (tcbs.find(two_end) != tcbs.end()) {
-                                tcbs[two_end]->state      = TCP_LISTEN;
-                                tcbs[two_end]->next_state = TCP_LISTEN;
-                                tcp_transmit::tcp_in(tcbs[two_end], in_packet);
-
-                                // Notify socket manager if connection completed
-                                auto listener = this->listeners[in_packet.local_info.value()];
-                                if (!listener->acceptors->empty()) {
-                                        socket_manager::instance().mark_listener_acceptable(listener);
-                                }
-
-                                // Notify socket manager if data arrived
-                                if (!tcbs[two_end]->receive_queue.empty()) {
-                                        socket_manager::instance().mark_socket_readable(tcbs[two_end]);
-                                }
-                        } else {
-                                DLOG(ERROR) << "[REGISTER TCB FAIL]";
+                        // Active open finished (ESTABLISHED) or failed (CLOSED)
+                        if ((prev_state == TCP_SYN_SENT || prev_state == TCP_SYN_RECEIVED) &&
+                            tcb->state != prev_state && tcb->state != TCP_SYN_RECEIVED && !tcb->_listener) {
+                                timer_wheel::instance().cancel(tcb->syn_timer);
+                                socket_events::connect_complete(tcb);
                         }
-
+                        // Notify socket manager if data (or the end of it) arrived
+                        if (!tcb->receive_queue.empty() || tcb->fin_received) {
+                                socket_events::socket_readable(tcb);
+                        }
+                        // ACKs drained the send buffer below the low watermark
+                        if (tcb->write_blocked && tcb->send_writable()) {
+                                tcb->write_blocked = false;
+                                socket_events::socket_writable(tcb);
+                        }
+                        if (tcb->state == TCP_TIME_WAIT) {
+                                enter_time_wait(tcb);
+                        }
+                } else if (receive_in_time_wait(two_end, in_packet)) {
+                        return;
+                } else if (active_ports.find(in_packet.local_info.value()) != active_ports.end()) {
+                        receive_on_listener(two_end, in_packet);
                 } else {
                         DLOG(ERROR) << "[RECEIVE UNKNOWN TCP PACKET]";
+                        reject_closed_port(two_end, in_packet);
                 }
         }
 };
-}  // namespace uStack
\ No newline at end of file
+}  // namespace uStack
+
+#include "socket_manager.hpp"
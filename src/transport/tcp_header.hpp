@@ -1,4 +1,6 @@
 #pragma once
+#include <optional>
+
 #include "utils.hpp"
 
 namespace uStack {
@@ -6,10 +8,11 @@ namespace uStack {
 namespace docs {
 static const char* tcp_header_doc = R"(
 FILE: tcp_header.hpp
-PURPOSE: TCP header (20 bytes). Methods: consume(), produce(), size().
+PURPOSE: TCP header (20 bytes). Methods: consume(), produce(), size(), consume_mss_option(), produce_mss_option().
 FLAGS: SYN, ACK, FIN, RST, PSH, URG.
 
-LIMITATIONS: No options, ISN not random, no SACK/timestamps
+OPTIONS: Only MSS (kind 2, RFC 9293 section 3.2) is parsed/generated, on SYN segments
+LIMITATIONS: No SACK/timestamps/window scaling
 
 PSEUDO-HEADER (for checksum):
 [src_ip(4)][dst_ip(4)][0(1)][proto(1)][tcp_len(2)]
@@ -38,6 +41,11 @@ struct tcp_header_t {
 
         static constexpr size_t size() { return 2 + 2 + 4 + 4 + 2 + 2 + 2 + 2; }
 
+        static constexpr uint8_t OPTION_END     = 0;
+        static constexpr uint8_t OPTION_NOP     = 1;
+        static constexpr uint8_t OPTION_MSS     = 2;
+        static constexpr size_t  MSS_OPTION_LEN = 4;
+
         tcp_header_t() {
                 src_port       = 0;
                 dst_port       = 0;
@@ -76,6 +84,34 @@ struct tcp_header_t {
                 return tcp_header;
         }
 
+        // Walk the options between the fixed header and data offset.
+        // ptr points at the start of the TCP header.
+        static std::optional<uint16_t> consume_mss_option(uint8_t* ptr, uint8_t header_length) {
+                uint8_t* opt = ptr + size();
+                uint8_t* end = ptr + header_length * 4;
+                while (opt < end) {
+                        uint8_t kind = opt[0];
+                        if (kind == OPTION_END) break;
+                        if (kind == OPTION_NOP) {
+                                opt++;
+                                continue;
+                        }
+                        if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end) break;  // Malformed
+                        if (kind == OPTION_MSS && opt[1] == MSS_OPTION_LEN) {
+                                uint8_t* value = opt + 2;
+                                return utils::consume<uint16_t>(value);
+                        }
+                        opt += opt[1];
+                }
+                return std::nullopt;
+        }
+
+        static void produce_mss_option(uint8_t* ptr, uint16_t mss) {
+                *ptr++ = OPTION_MSS;
+                *ptr++ = MSS_OPTION_LEN;
+                utils::produce<uint16_t>(ptr, mss);
+        }
+
         void produce(uint8_t* ptr) {
                 utils::produce<port_addr_t>(ptr, src_port);
                 utils::produce<port_addr_t>(ptr, dst_port);
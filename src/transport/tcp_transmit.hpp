@@ -1,7 +1,11 @@
 #pragma once
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
 #include "packets.hpp"
+#include "siphash.hpp"
 #include "tcb.hpp"
-#include <random>
 
 namespace uStack {
 
@@ -37,7 +41,46 @@ public:
                 DLOG(INFO) << "[SEND ACK]";
         }
 
-        static void tcp_send_syn_ack() {}
+        // SYN or SYN-ACK carrying our MSS option
+        static tcp_packet_t make_syn_segment(ipv4_port_t remote_info, ipv4_port_t local_info,
+                                             uint32_t iss, std::optional<uint32_t> ack_no, uint16_t mss) {
+                size_t       header_len = tcp_header_t::size() + tcp_header_t::MSS_OPTION_LEN;
+                auto         out_buffer = std::make_unique<base_packet>(header_len);
+                tcp_header_t out_tcp;
+
+                out_tcp.src_port      = local_info.port_addr.value();
+                out_tcp.dst_port      = remote_info.port_addr.value();
+                out_tcp.seq_no        = iss;
+                out_tcp.ack_no        = ack_no.value_or(0);
+                out_tcp.window_size   = 0xFAF0;
+                out_tcp.header_length = header_len / 4;
+                out_tcp.SYN           = 1;
+                out_tcp.ACK           = ack_no ? 1 : 0;
+
+                out_tcp.produce(out_buffer->get_pointer());
+                tcp_header_t::produce_mss_option(out_buffer->get_pointer() + tcp_header_t::size(), mss);
+
+                return {.proto       = 0x06,
+                        .remote_info = remote_info,
+                        .local_info  = local_info,
+                        .buffer      = std::move(out_buffer)};
+        }
+
+        // Build a SYN-ACK for a passive open that has no TCB yet (see tcb_manager::handle_syn).
+        // <SEQ=ISS><ACK=RCV.NXT><CTL=SYN,ACK> with our MSS option.
+        static tcp_packet_t make_syn_ack(ipv4_port_t remote_info, ipv4_port_t local_info,
+                                         uint32_t iss, uint32_t ack_no, uint16_t mss) {
+                DLOG(INFO) << "[SEND SYN ACK] " << remote_info << " iss=" << iss;
+                return make_syn_segment(remote_info, local_info, iss, ack_no, mss);
+        }
+
+        // Active open: <SEQ=ISS><CTL=SYN>, queued on the TCB (also used for retransmission)
+        static void tcp_send_syn(std::shared_ptr<tcb_t> tcb, uint32_t iss) {
+                tcb->ctl_packets.push_back(make_syn_segment(tcb->remote_info.value(), tcb->local_info.value(),
+                                                            iss, std::nullopt, tcb->send.mss));
+                tcb->active_self();
+                DLOG(INFO) << "[SEND SYN] " << *tcb << " iss=" << iss;
+        }
 
         static void tcp_send_rst(std::shared_ptr<tcb_t> tcb, tcp_header_t& in_tcp, int seg_len) {
                 auto out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
@@ -70,10 +113,28 @@ public:
                 DLOG(INFO) << "[SEND RST]";
         }
 
-        // NEW: Send RST without a TCB (for rejecting connections due to limits)
-        // Used when connection limit exceeded before TCB is created
-        static void tcp_send_rst_reject(tcp_header_t& in_tcp, ipv4_port_t remote_info,
-                                        ipv4_port_t local_info, int seg_len) {
+        // Build a bare ACK without a TCB (TIME-WAIT): <SEQ=SND.NXT><ACK=RCV.NXT><CTL=ACK>
+        static tcp_packet_t make_ack(ipv4_port_t remote_info, ipv4_port_t local_info, uint32_t seq_no,
+                                     uint32_t ack_no) {
+                auto         out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
+                tcp_header_t out_tcp;
+
+                out_tcp.src_port      = local_info.port_addr.value();
+                out_tcp.dst_port      = remote_info.port_addr.value();
+                out_tcp.seq_no        = seq_no;
+                out_tcp.ack_no        = ack_no;
+                out_tcp.window_size   = 0xFAF0;
+                out_tcp.header_length = tcp_header_t::size() / 4;
+                out_tcp.ACK           = 1;
+
+                out_tcp.produce(out_buffer->get_pointer());
+                return {.proto = 0x06, .remote_info = remote_info, .local_info = local_info, .buffer = std::move(out_buffer)};
+        }
+
+        // Build a RST without a TCB (connection limits, bad handshake ACK).
+        // The caller queues it on tcb_manager's control queue.
+        static tcp_packet_t make_rst_reject(tcp_header_t& in_tcp, ipv4_port_t remote_info,
+                                            ipv4_port_t local_info, int seg_len) {
                 auto out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
                 tcp_header_t out_tcp;
 
@@ -95,31 +156,49 @@ public:
 
                 out_tcp.produce(out_buffer->get_pointer());
 
-                tcp_packet_t out_packet = {.proto = 0x06, .remote_info = remote_info, .local_info = local_info, .buffer = std::move(out_buffer)};
+                DLOG(INFO) << "[SEND RST REJECT] " << remote_info;
+                return {.proto = 0x06, .remote_info = remote_info, .local_info = local_info, .buffer = std::move(out_buffer)};
+        }
+
+        // Abortive close (RFC 9293 section 3.10.5 ABORT): <SEQ=SND.NXT><CTL=RST>
+        static tcp_packet_t make_rst(ipv4_port_t remote_info, ipv4_port_t local_info, uint32_t seq_no) {
+                auto         out_buffer = std::make_unique<base_packet>(tcp_header_t::size());
+                tcp_header_t out_tcp;
 
-                // For standalone RST, we need to send it through the network layer
-                // Since we don't have a TCB to hold it, we directly send via event loop
-                // This is a simplified approach - real implementation would queue to network layer
-                DLOG(INFO) << "[SEND RST REJECT] Connection limit exceeded for " << remote_info;
+                out_tcp.src_port      = local_info.port_addr.value();
+                out_tcp.dst_port      = remote_info.port_addr.value();
+                out_tcp.seq_no        = seq_no;
+                out_tcp.header_length = tcp_header_t::size() / 4;
+                out_tcp.RST           = 1;
+
+                out_tcp.produce(out_buffer->get_pointer());
+
+                DLOG(INFO) << "[SEND RST ABORT] " << remote_info;
+                return {.proto = 0x06, .remote_info = remote_info, .local_info = local_info, .buffer = std::move(out_buffer)};
         }
 
         static void tcp_send_ctl() {}
 
-        static int generate_iss() {
-                // RFC 793: ISN should not be easily predictable
-                // Use combination of high-resolution time and random value
-                auto now = std::chrono::high_resolution_clock::now();
-                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
-
-                // Generate random value
-                static std::random_device rd;
-                static std::mt19937 gen(rd());
-                std::uniform_int_distribution<uint32_t> dis(0, UINT32_MAX);
-                uint32_t random_val = dis(gen);
-
-                // Combine time and random for unpredictable ISN
-                uint32_t iss = static_cast<uint32_t>(ns ^ random_val);
-                return iss;
+        // RFC 6528: ISN = M + F(localip, localport, remoteip, remoteport, secretkey)
+        // M is a 4 microsecond timer, F is SipHash-2-4 under a per-boot secret. ISNs of
+        // one 4-tuple increase monotonically across incarnations; other tuples can't be guessed.
+        static uint32_t generate_iss(ipv4_port_t remote_info, ipv4_port_t local_info) {
+                static const utils::siphash_key_t secret = utils::random_key();
+
+                uint32_t local_ipv4  = local_info.ipv4_addr->get_raw_ipv4();
+                uint32_t remote_ipv4 = remote_info.ipv4_addr->get_raw_ipv4();
+                uint16_t local_port  = local_info.port_addr.value();
+                uint16_t remote_port = remote_info.port_addr.value();
+
+                uint8_t tuple[12];
+                std::memcpy(tuple, &local_ipv4, 4);
+                std::memcpy(tuple + 4, &local_port, 2);
+                std::memcpy(tuple + 6, &remote_ipv4, 4);
+                std::memcpy(tuple + 10, &remote_port, 2);
+
+                auto now = std::chrono::steady_clock::now().time_since_epoch();
+                uint32_t m = std::chrono::duration_cast<std::chrono::microseconds>(now).count() / 4;
+                return m + static_cast<uint32_t>(utils::siphash24(secret, tuple, sizeof(tuple)));
         }
 
         static bool tcp_handle_close_state(std::shared_ptr<tcb_t> in_tcb, tcp_packet_t& in_packet) {
@@ -182,7 +261,7 @@ public:
                  *  formatted as follows: <SEQ=SEG.ACK><CTL=RST>
                  */
                 if (in_tcp.ACK == 1) {
-                        tcp_send_rst();
+                        tcp_send_rst(in_tcb, in_tcp, 0);
                         return true;
                 }
 
@@ -217,9 +296,10 @@ public:
                  */
 
                 if (in_tcp.SYN == 1) {
-                        uint32_t iss                = generate_iss();
+                        uint32_t iss                = generate_iss(in_tcb->remote_info.value(),
+                                                                   in_tcb->local_info.value());
                         in_tcb->receive.next        = in_tcp.seq_no + 1;
-                        in_tcb->receive.window      = 0xFAF0;
+                        in_tcb->update_receive_window();
                         in_tcb->send.next           = iss + 1;
                         in_tcb->send.unacknowledged = iss;
                         in_tcb->next_state          = TCP_SYN_RECEIVED;
@@ -245,7 +325,11 @@ public:
                         return false;
                 }
 
-                tcp_header_t in_tcp = tcp_header_t::consume(in_packet.buffer->get_pointer());
+                uint8_t*     tcp_pointer = in_packet.buffer->get_pointer();
+                tcp_header_t in_tcp      = tcp_header_t::consume(tcp_pointer);
+                uint32_t     iss         = in_tcb->send.unacknowledged;
+                bool         ack_ok      = false;
+
                 // first check the ACK bit
                 if (in_tcp.ACK == 1) {
                         /**
@@ -255,6 +339,16 @@ public:
                          *  and discard the segment.  Return.
                          *  If SND.UNA =< SEG.ACK =< SND.NXT then the ACK is acceptable.
                          */
+                        if (static_cast<int32_t>(in_tcp.ack_no - iss) <= 0 ||
+                            static_cast<int32_t>(in_tcp.ack_no - in_tcb->send.next) > 0) {
+                                if (!in_tcp.RST) {
+                                        in_tcb->ctl_packets.push_back(make_rst_reject(
+                                                in_tcp, in_tcb->remote_info.value(), in_tcb->local_info.value(), 0));
+                                        in_tcb->active_self();
+                                }
+                                return true;
+                        }
+                        ack_ok = true;
                 }
 
                 // second check the RST bit
@@ -265,6 +359,13 @@ public:
                          *  delete TCB, and return.  Otherwise (no ACK) drop the segment
                          *  and return.
                          */
+                        if (ack_ok) {
+                                DLOG(INFO) << "[CONNECTION REFUSED] " << *in_tcb;
+                                in_tcb->error = ECONNREFUSED;
+                                in_tcb->release_buffers();
+                                in_tcb->enter_state(TCP_CLOSED);
+                        }
+                        return true;
                 }
 
                 // third check the security and precedence
@@ -332,6 +433,32 @@ public:
                  *   segment, queue them for processing after the ESTABLISHED state
                  *   has been reached, return.
                  */
+                if (in_tcp.SYN == 1) {
+                        in_tcb->receive.next   = in_tcp.seq_no + 1;
+                        in_tcb->update_receive_window();
+                        in_tcb->clamp_peer_mss(
+                                tcp_header_t::consume_mss_option(tcp_pointer, in_tcp.header_length).value_or(536));
+                        if (ack_ok) {
+                                in_tcb->send.unacknowledged = in_tcp.ack_no;
+                        }
+
+                        if (in_tcb->send.unacknowledged != iss) {
+                                in_tcb->init_send_window(in_tcp.seq_no, in_tcp.ack_no, in_tcp.window_size);
+                                in_tcb->enter_state(TCP_ESTABLISHED);
+                                in_tcb->init_congestion_control();
+                                tcp_send_ack(in_tcb);
+                                in_tcb->active_self();
+                                DLOG(INFO) << "[CONNECTED] " << *in_tcb;
+                        } else {
+                                // Simultaneous open
+                                in_tcb->enter_state(TCP_SYN_RECEIVED);
+                                in_tcb->ctl_packets.push_back(make_syn_ack(in_tcb->remote_info.value(),
+                                                                           in_tcb->local_info.value(), iss,
+                                                                           in_tcb->receive.next, in_tcb->send.mss));
+                                in_tcb->active_self();
+                        }
+                        return true;
+                }
 
                 // fifth, if neither of the SYN or RST bits is set then drop the segment
                 // and return.
@@ -471,7 +598,7 @@ public:
                         DLOG(INFO) << "[SEGMENT SEQ FAIL]";
                         if (!in_tcp.RST) {
                                 // <SEQ=SND.NXT><ACK=RCV.NXT><CTL=ACK>
-                                tcp_send_ack();
+                                tcp_send_ack(in_tcb);
                         }
                         return;
                 }
@@ -519,6 +646,9 @@ public:
                                 case TCP_FIN_WAIT_1:
                                 case TCP_FIN_WAIT_2:
                                 case TCP_CLOSE_WAIT:
+                                        DLOG(INFO) << "[CONNECTION RESET] " << *in_tcb;
+                                        in_tcb->release_buffers();
+                                        in_tcb->enter_state(TCP_CLOSED);
                                         return;
                                 /**
                                  *  CLOSING STATE
@@ -531,6 +661,8 @@ public:
                                 case TCP_CLOSING:
                                 case TCP_LAST_ACK:
                                 case TCP_TIME_WAIT:
+                                        in_tcb->release_buffers();
+                                        in_tcb->enter_state(TCP_CLOSED);
                                         return;
                         }
                 }
@@ -608,35 +740,13 @@ public:
                                 case TCP_SYN_RECEIVED:
                                         if (in_tcb->send.unacknowledged <= in_tcp.ack_no &&
                                             in_tcp.ack_no <= in_tcb->send.next) {
-                                                in_tcb->state      = TCP_ESTABLISHED;
-                                                in_tcb->next_state = TCP_ESTABLISHED;
+                                                in_tcb->enter_state(TCP_ESTABLISHED);
+                                                in_tcb->init_send_window(in_tcp.seq_no, in_tcp.ack_no,
+                                                                         in_tcp.window_size);
                                                 // Initialize congestion control (TCP Reno)
                                                 in_tcb->init_congestion_control();
-
-                                                // NEW: Check listener backlog limit before queuing
-                                                if (in_tcb->_listener) {
-                                                        // Check if this listener's backlog is full
-                                                        auto& mgr = tcb_manager::instance();
-                                                        ipv4_port_t local_port = in_tcb->local_info.value();
-
-                                                        if (!mgr.can_queue_to_backlog(local_port)) {
-                                                                // Backlog is full - reject connection
-                                                                DLOG(WARNING) << "[BACKLOG FULL] Rejecting connection"
-                                                                              << " local=" << local_port.port_addr.value()
-                                                                              << " remote=" << in_tcp.seq_no;
-                                                                tcp_send_rst(in_tcb, in_tcp, 0);
-                                                                return;
-                                                        }
-
-                                                        // Backlog has space - queue to acceptors
-                                                        in_tcb->listen_finish();
-                                                        // Track connection in backlog
-                                                        mgr.track_backlog_queued(local_port);
-                                                } else {
-                                                        // No listener - shouldn't happen for passive open
-                                                        DLOG(WARNING) << "[ESTABLISH] No listener for TCB";
-                                                }
-                                                // in_tcb->receive.next += 1;
+                                                // A passive open is queued for accept() by
+                                                // tcb_manager::receive(), which owns the backlog
                                         } else {
                                                 tcp_send_rst(in_tcb, in_tcp, 0);
                                                 return;
@@ -678,6 +788,7 @@ public:
 
                                                 // Update unacknowledged pointer
                                                 in_tcb->send.unacknowledged = in_tcp.ack_no;
+                                                in_tcb->ack_progress_tick   = timer_wheel::instance().now_tick();
                                                 in_tcb->send.last_ack_no = in_tcp.ack_no;
 
                                                 // Update bytes in flight (congestion control)
@@ -690,6 +801,9 @@ public:
                                                 // NEW: Remove acknowledged segments from retransmit queue
                                                 in_tcb->remove_acked_segments(in_tcp.ack_no);
 
+                                                // PLPMTUD: a fully acknowledged probe raises the MSS
+                                                in_tcb->on_probe_acked(in_tcp.ack_no);
+
                                                 // Fast Recovery exit: new ACK received during fast recovery
                                                 if (in_tcb->send.dupacks >= 3) {
                                                         // Exit fast recovery
@@ -727,6 +841,13 @@ public:
                                                 }
                                         }
 
+                                        // Window update, also from ACKs that acknowledge nothing new
+                                        if (in_tcb->send.unacknowledged <= in_tcp.ack_no &&
+                                            in_tcp.ack_no <= in_tcb->send.next) {
+                                                in_tcb->update_send_window(in_tcp.seq_no, in_tcp.ack_no,
+                                                                           in_tcp.window_size);
+                                        }
+
                                         if (in_tcp.ack_no <
                                             in_tcb->send.unacknowledged) {
                                                 // DUPLICATE ACK or OLD ACK
@@ -748,6 +869,13 @@ public:
                                                                 // Enter Fast Recovery
                                                                 in_tcb->enter_fast_recovery();
 
+                                                                // PLPMTUD: losing the probe is not congestion evidence
+                                                                // by itself, but the probe size is suspect
+                                                                if (in_tcb->plpmtud.probe_mss != 0 &&
+                                                                    in_tcb->plpmtud.probe_seq == in_tcb->send.unacknowledged) {
+                                                                        in_tcb->on_probe_lost();
+                                                                }
+
                                                                 // Retransmit the lost segment
                                                                 bool retransmitted = in_tcb->retransmit_segment(in_tcb->send.unacknowledged);
 
@@ -781,8 +909,8 @@ public:
                                          *      state, if our FIN is now acknowledged then enter
                                          *      FIN-WAIT-2 and continue processing in that state.
                                          */
-                                        if (in_tcb->state == TCP_FIN_WAIT_1) {
-                                                in_tcb->next_state = TCP_FIN_WAIT_2;
+                                        if (in_tcb->state == TCP_FIN_WAIT_1 && in_tcb->fin_acked(in_tcp.ack_no)) {
+                                                in_tcb->enter_state(TCP_FIN_WAIT_2);
                                         }
 
                                         /**
@@ -808,8 +936,9 @@ public:
                                          *      state, if the ACK acknowledges our FIN then enter
                                          * the TIME-WAIT state, otherwise ignore the segment.
                                          */
-                                        if (in_tcb->state == TCP_CLOSING) {
-                                                in_tcb->next_state = TCP_TIME_WAIT;
+                                        if (in_tcb->state == TCP_CLOSING && in_tcb->fin_acked(in_tcp.ack_no)) {
+                                                // Nothing left to send: tcb_manager moves it to the TIME-WAIT table
+                                                in_tcb->enter_state(TCP_TIME_WAIT);
                                         }
                                         break;
                                 /**
@@ -819,7 +948,9 @@ public:
                                  *      delete the TCB, enter the CLOSED state, and return.
                                  */
                                 case TCP_LAST_ACK:
-                                        in_tcb->next_state = TCP_CLOSED;
+                                        if (in_tcb->fin_acked(in_tcp.ack_no)) {
+                                                in_tcb->enter_state(TCP_CLOSED);
+                                        }
                                         return;
                                 /**
                                  *  TIME-WAIT STATE
@@ -911,12 +1042,17 @@ public:
                                 case TCP_FIN_WAIT_2: {
                                         DLOG(INFO) << "[RECEIVE DATA] " << segment_len;
                                         in_tcb->receive.next += segment_len;
-                                        std::unique_ptr<base_packet> out_buffer =
-                                                std::make_unique<base_packet>(segment_len);
-                                        in_packet.buffer->export_payload(out_buffer->get_pointer(),
-                                                                         header_len);
-                                        raw_packet r_packet = {.buffer = std::move(out_buffer)};
-                                        in_tcb->receive_queue.push_back(std::move(r_packet));
+                                        if (in_tcb->read_shutdown) {
+                                                // SHUT_RD: acknowledge, but nobody will read it
+                                                in_tcb->active_self();
+                                                break;
+                                        }
+                                        // Queue the received frame itself, positioned at the
+                                        // payload (small payloads are copied out, see
+                                        // receive_enqueue): read() copies from it once,
+                                        // read_zerocopy() lends it out without copying
+                                        in_packet.buffer->add_offset(header_len);
+                                        in_tcb->receive_enqueue(std::move(in_packet.buffer), segment_len);
                                         in_tcb->active_self();
                                         break;
                                 }
@@ -959,8 +1095,10 @@ public:
                                 case TCP_SYN_RECEIVED:
                                 case TCP_ESTABLISHED:
                                         in_tcb->receive.next += 1;
+                                        in_tcb->fin_received = true;
                                         in_tcb->next_state = TCP_CLOSE_WAIT;
                                         in_tcb->active_self();
+                                        break;
                                         /**
                                          *  FIN-WAIT-1 STATE
                                          *      If our FIN has been ACKed (perhaps in this segment),
@@ -969,19 +1107,28 @@ public:
                                          * state.
                                          */
                                 case TCP_FIN_WAIT_1:
+                                        in_tcb->receive.next += 1;
+                                        in_tcb->fin_received = true;
                                         if (in_tcb->next_state == TCP_FIN_WAIT_2) {
                                                 in_tcb->next_state = TCP_TIME_WAIT;
                                         } else {
                                                 in_tcb->next_state = TCP_CLOSING;
                                         }
+                                        in_tcb->active_self();
+                                        break;
                                         /**
                                          *  FIN-WAIT-2 STATE
                                          *      Enter the TIME-WAIT state.  Start the time-wait
                                          * timer, turn off the other timers.
                                          */
                                 case TCP_FIN_WAIT_2:
-                                        // * start time_wait
+                                        // The ACK of the FIN is the last segment; the time-wait
+                                        // timer starts when tcb_manager sees the state change
+                                        in_tcb->receive.next += 1;
+                                        in_tcb->fin_received = true;
                                         in_tcb->next_state = TCP_TIME_WAIT;
+                                        in_tcb->active_self();
+                                        break;
                                         /**
                                          *  CLOSE-WAIT STATE
                                          *      Remain in the CLOSE-WAIT state.
@@ -1000,7 +1147,7 @@ public:
                                         /**
                                          *  TIME-WAIT STATE
                                          *      Remain in the TIME-WAIT state.  Restart the 2 MSL
-                                         * time-wait timeout.
+                                         * time-wait timeout. (Handled by tcb_manager's timewait table)
                                          */
                                 case TCP_TIME_WAIT:
                                         return;
@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+#include "timer_wheel.hpp"
+#include "tuple_key.hpp"
+
+namespace uStack {
+
+namespace docs {
+static const char* timewait_doc = R"(
+FILE: timewait.hpp
+PURPOSE: TIME-WAIT connections without a TCB. Methods: insert(), find(), restart(), remove(), size().
+
+- The tcb_t is released when the connection enters TIME-WAIT; only the tuple,
+  SND.NXT and RCV.NXT are kept (16 byte entry + 12 byte key)
+- Each entry holds one timer_wheel timer for its 2*MSL expiry
+- At max_entries the oldest entry is recycled (RFC 1337 hazards accepted over
+  refusing new connections)
+- SYN reuse decisions are made by tcb_manager (RFC 6191 sequence number rule)
+)";
+}
+
+struct timewait_entry_t {
+        uint32_t              send_next;
+        uint32_t              receive_next;
+        timer_wheel::timer_id timer;
+};
+
+struct timewait_stats_t {
+        uint32_t current  = 0;
+        uint32_t peak     = 0;
+        uint64_t total    = 0;  // Connections that entered TIME-WAIT
+        uint64_t expired  = 0;  // Left after the full 2*MSL
+        uint64_t recycled = 0;  // Evicted early by the cap
+        uint64_t reused   = 0;  // Ended early by an acceptable new SYN
+};
+
+class timewait_table_t {
+private:
+        std::unordered_map<tuple_key_t, timewait_entry_t, tuple_key_hash> entries;
+        std::deque<std::pair<tuple_key_t, timer_wheel::timer_id>>        order;  // Expiry order
+        std::chrono::milliseconds                                        duration;
+        uint32_t                                                         max_entries;
+        timewait_stats_t                                                 stats;
+
+        bool is_live(const std::pair<tuple_key_t, timer_wheel::timer_id>& record) const {
+                auto it = entries.find(record.first);
+                return it != entries.end() && it->second.timer == record.second;
+        }
+
+        // All entries last the same 2*MSL, so order is also expiry order
+        void prune_order() {
+                while (!order.empty() && !is_live(order.front())) order.pop_front();
+        }
+
+        timer_wheel::timer_id start_timer(const tuple_key_t& key) {
+                timer_wheel::timer_id id = timer_wheel::instance().schedule(
+                        duration, [this, key]() { expire(key); });
+                order.emplace_back(key, id);
+                return id;
+        }
+
+        void expire(const tuple_key_t& key) {
+                if (entries.erase(key)) stats.expired++;
+                stats.current = entries.size();
+                prune_order();
+        }
+
+        void recycle_oldest() {
+                prune_order();
+                if (order.empty()) return;
+                remove(order.front().first);
+                stats.recycled++;
+        }
+
+public:
+        timewait_table_t(std::chrono::milliseconds duration, uint32_t max_entries)
+            : duration(duration), max_entries(max_entries) {}
+
+        void insert(const tuple_key_t& key, uint32_t send_next, uint32_t receive_next) {
+                remove(key);
+                if (entries.size() >= max_entries) {
+                        recycle_oldest();
+                }
+                entries[key] = {send_next, receive_next, start_timer(key)};
+
+                stats.total++;
+                stats.current = entries.size();
+                if (stats.current > stats.peak) stats.peak = stats.current;
+        }
+
+        timewait_entry_t* find(const tuple_key_t& key) {
+                auto it = entries.find(key);
+                return it == entries.end() ? nullptr : &it->second;
+        }
+
+        // Retransmitted FIN: restart the 2*MSL timeout
+        void restart(const tuple_key_t& key) {
+                auto it = entries.find(key);
+                if (it == entries.end()) return;
+                timer_wheel::instance().cancel(it->second.timer);
+                it->second.timer = start_timer(key);
+        }
+
+        bool remove(const tuple_key_t& key) {
+                auto it = entries.find(key);
+                if (it == entries.end()) return false;
+                timer_wheel::instance().cancel(it->second.timer);
+                entries.erase(it);
+                stats.current = entries.size();
+                return true;
+        }
+
+        void mark_reused(const tuple_key_t& key) {
+                if (remove(key)) stats.reused++;
+        }
+
+        size_t           size() const { return entries.size(); }
+        timewait_stats_t get_stats() const { return stats; }
+};
+}  // namespace uStack
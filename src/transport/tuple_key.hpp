@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace uStack {
+
+namespace docs {
+static const char* tuple_key_doc = R"(
+FILE: tuple_key.hpp
+PURPOSE: Compact 12 byte connection 4-tuple. Key for the half-open and TIME_WAIT tables.
+
+Unlike two_ends_t (optionals, ~40 bytes) it has no empty state and hashes in one multiply.
+)";
+}
+
+struct tuple_key_t {
+        uint32_t remote_ipv4;
+        uint32_t local_ipv4;
+        uint16_t remote_port;
+        uint16_t local_port;
+
+        bool operator==(const tuple_key_t& rhs) const {
+                return remote_ipv4 == rhs.remote_ipv4 && local_ipv4 == rhs.local_ipv4 &&
+                       remote_port == rhs.remote_port && local_port == rhs.local_port;
+        }
+};
+
+struct tuple_key_hash {
+        size_t operator()(const tuple_key_t& key) const {
+                uint64_t ports = uint64_t(key.remote_port) << 16 | key.local_port;
+                return std::hash<uint64_t>{}((uint64_t(key.remote_ipv4) << 32 | key.local_ipv4) ^
+                                             (ports * 0x9E3779B97F4A7C15ULL));
+        }
+};
+}  // namespace uStack
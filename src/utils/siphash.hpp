@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace uStack {
+
+namespace docs {
+static const char* siphash_doc = R"(
+FILE: siphash.hpp
+PURPOSE: SipHash-2-4 keyed hash (Aumasson & Bernstein). Functions: siphash24(), random_key().
+
+USAGE: Short-input PRF for values an off-path attacker must not predict
+(SYN cookies, initial sequence numbers). Not a general purpose hash table hash.
+)";
+}
+
+    namespace utils {
+
+    struct siphash_key_t {
+            uint64_t k0 = 0;
+            uint64_t k1 = 0;
+    };
+
+    inline uint64_t rotl64(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+    inline void sip_round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+            v0 += v1;
+            v1 = rotl64(v1, 13);
+            v1 ^= v0;
+            v0 = rotl64(v0, 32);
+            v2 += v3;
+            v3 = rotl64(v3, 16);
+            v3 ^= v2;
+            v0 += v3;
+            v3 = rotl64(v3, 21);
+            v3 ^= v0;
+            v2 += v1;
+            v1 = rotl64(v1, 17);
+            v1 ^= v2;
+            v2 = rotl64(v2, 32);
+    }
+
+    // Little-endian load, as required by the SipHash specification
+    inline uint64_t load_le64(const uint8_t* p) {
+            uint64_t value = 0;
+            for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+            return value;
+    }
+
+    inline uint64_t siphash24(const siphash_key_t& key, const uint8_t* data, size_t len) {
+            uint64_t v0 = 0x736f6d6570736575ULL ^ key.k0;
+            uint64_t v1 = 0x646f72616e646f6dULL ^ key.k1;
+            uint64_t v2 = 0x6c7967656e657261ULL ^ key.k0;
+            uint64_t v3 = 0x7465646279746573ULL ^ key.k1;
+
+            const uint8_t* end = data + (len & ~size_t(7));
+            for (const uint8_t* p = data; p != end; p += 8) {
+                    uint64_t m = load_le64(p);
+                    v3 ^= m;
+                    sip_round(v0, v1, v2, v3);
+                    sip_round(v0, v1, v2, v3);
+                    v0 ^= m;
+            }
+
+            uint64_t last = uint64_t(len) << 56;
+            for (size_t i = 0; i < (len & 7); i++) {
+                    last |= uint64_t(end[i]) << (8 * i);
+            }
+            v3 ^= last;
+            sip_round(v0, v1, v2, v3);
+            sip_round(v0, v1, v2, v3);
+            v0 ^= last;
+
+            v2 ^= 0xff;
+            for (int i = 0; i < 4; i++) sip_round(v0, v1, v2, v3);
+            return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    // Per-boot secret, drawn once from the OS entropy source
+    inline siphash_key_t random_key() {
+            std::random_device rd;
+            siphash_key_t      key;
+            key.k0 = (uint64_t(rd()) << 32) | rd();
+            key.k1 = (uint64_t(rd()) << 32) | rd();
+            return key;
+    }
+    };  // namespace utils
+};  // namespace uStack
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace uStack {
+
+namespace docs {
+static const char* token_bucket_doc = R"(
+FILE: token_bucket.hpp
+PURPOSE: Token bucket rate limiter. Methods: try_consume(), is_full().
+
+- rate: tokens added per second, burst: bucket depth
+- Refilled lazily from the elapsed time on each call, no timers needed
+- A bucket starts full so the first burst is always allowed
+)";
+}
+
+struct token_bucket_t {
+        using clock = std::chrono::steady_clock;
+
+        uint32_t          rate   = 0;
+        uint32_t          burst  = 0;
+        double            tokens = 0;
+        clock::time_point last_refill;
+
+        token_bucket_t() = default;
+        token_bucket_t(uint32_t rate, uint32_t burst, clock::time_point now = clock::now())
+            : rate(rate), burst(burst), tokens(burst), last_refill(now) {}
+
+        void refill(clock::time_point now) {
+                if (now <= last_refill) return;
+                std::chrono::duration<double> elapsed = now - last_refill;
+                tokens      = std::min<double>(burst, tokens + elapsed.count() * rate);
+                last_refill = now;
+        }
+
+        bool try_consume(clock::time_point now = clock::now()) {
+                refill(now);
+                if (tokens < 1) {
+                        return false;
+                }
+                tokens -= 1;
+                return true;
+        }
+
+        // A full bucket carries no history and can be dropped from a table
+        bool is_full(clock::time_point now = clock::now()) {
+                refill(now);
+                return tokens >= burst;
+        }
+};
+}  // namespace uStack
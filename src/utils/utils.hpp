@@ -3,13 +3,17 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "logger.hpp"
 
 namespace uStack {
 
 namespace docs {
 static const char* utils_doc = R"(
 FILE: utils.hpp
-PURPOSE: Utilities - ntoh(), consume(), produce(), checksum(), format(), run_cmd(), set_interface_*().
+PURPOSE: Utilities - ntoh(), consume(), produce(), checksum(), checksum_adjust(), format(), run_cmd(), set_interface_*().
 )";
 }
 
@@ -91,5 +95,15 @@ PURPOSE: Utilities - ntoh(), consume(), produce(), checksum(), format(), run_cmd
             uint16_t ret = ~sum;
             return ntoh(ret);
     }
+
+    // RFC 1624 incremental update when one 16-bit word changes from old_word to
+    // new_word: HC' = ~(~HC + ~m + m'). All values in the same (host) byte order.
+    inline uint16_t checksum_adjust(uint16_t checksum, uint16_t old_word, uint16_t new_word) {
+            uint32_t sum = static_cast<uint16_t>(~checksum) + static_cast<uint16_t>(~old_word) +
+                           new_word;
+            while (sum >> 16)
+                    sum = (sum & 0xffff) + (sum >> 16);
+            return static_cast<uint16_t>(~sum);
+    }
     };  // namespace utils
 };  // namespace uStack
\ No newline at end of file
@@ -0,0 +1,711 @@
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "shm_client.hpp"
+
+namespace docs {
+static const char* ustack_preload_doc = R"(
+FILE: ustack_preload.cpp
+PURPOSE: LD_PRELOAD shim: AF_INET stream sockets of unmodified programs go through a running ustackd (shm_client.hpp), everything else goes to libc.
+Build: g++ -std=c++17 -shared -fPIC -Isrc/application -Isrc/network -Isrc/utils -o libustack_preload.so ustack_preload.cpp -ldl
+Run:   LD_PRELOAD=./libustack_preload.so redis-server --port 30000
+
+- socket(AF_INET, SOCK_STREAM) returns a placeholder kernel fd (an eventfd) so fd
+  numbers never collide; the stack socket is created by bind()+listen() or connect()
+- INADDR_ANY and unbound sockets use USTACK_ADDR (default 192.168.1.1)
+- Intercepted: socket, bind, listen, accept, accept4, connect, read, write, recv,
+  recvfrom, send, sendto, readv, writev, sendfile, shutdown, close, fcntl, ioctl
+  (FIONBIO, FIONREAD), setsockopt, getsockopt, getsockname, getpeername, epoll_ctl,
+  epoll_wait, epoll_pwait, poll
+- Blocking sockets block (spin, then sleep on the client eventfd); O_NONBLOCK,
+  SOCK_NONBLOCK, FIONBIO and MSG_DONTWAIT give EAGAIN as with the kernel
+- epoll sets mix stack and kernel fds: stack interests live in the shim, kernel ones
+  in the real epoll instance. Stack fds are level-triggered (EPOLLET is treated as
+  level-triggered, which only adds wakeups); EPOLLONESHOT is honoured
+- When ustackd is not running, sockets fall back to the kernel
+
+LIMITATIONS:
+- Calls on stack sockets are serialized by one mutex; blocking calls drop it every
+  WAIT_SLICE_MS so other threads get through
+- Peer addresses are not known to the client: accept() / getpeername() report 0.0.0.0:0
+- Stack sockets do not survive fork() (the child starts with none) or dup()
+- Socket options are accepted and ignored; MSG_PEEK sees contiguous bytes only
+)";
+}
+
+namespace {
+
+constexpr int MAX_FDS       = 65536;
+constexpr int WAIT_SLICE_MS = 10;
+
+// libc entry points behind the shim
+struct libc_t {
+        decltype(&::socket)      socket      = reinterpret_cast<decltype(&::socket)>(dlsym(RTLD_NEXT, "socket"));
+        decltype(&::bind)        bind        = reinterpret_cast<decltype(&::bind)>(dlsym(RTLD_NEXT, "bind"));
+        decltype(&::listen)      listen      = reinterpret_cast<decltype(&::listen)>(dlsym(RTLD_NEXT, "listen"));
+        decltype(&::accept)      accept      = reinterpret_cast<decltype(&::accept)>(dlsym(RTLD_NEXT, "accept"));
+        decltype(&::accept4)     accept4     = reinterpret_cast<decltype(&::accept4)>(dlsym(RTLD_NEXT, "accept4"));
+        decltype(&::connect)     connect     = reinterpret_cast<decltype(&::connect)>(dlsym(RTLD_NEXT, "connect"));
+        decltype(&::read)        read        = reinterpret_cast<decltype(&::read)>(dlsym(RTLD_NEXT, "read"));
+        decltype(&::write)       write       = reinterpret_cast<decltype(&::write)>(dlsym(RTLD_NEXT, "write"));
+        decltype(&::recv)        recv        = reinterpret_cast<decltype(&::recv)>(dlsym(RTLD_NEXT, "recv"));
+        decltype(&::recvfrom)    recvfrom    = reinterpret_cast<decltype(&::recvfrom)>(dlsym(RTLD_NEXT, "recvfrom"));
+        decltype(&::send)        send        = reinterpret_cast<decltype(&::send)>(dlsym(RTLD_NEXT, "send"));
+        decltype(&::sendto)      sendto      = reinterpret_cast<decltype(&::sendto)>(dlsym(RTLD_NEXT, "sendto"));
+        decltype(&::readv)       readv       = reinterpret_cast<decltype(&::readv)>(dlsym(RTLD_NEXT, "readv"));
+        decltype(&::writev)      writev      = reinterpret_cast<decltype(&::writev)>(dlsym(RTLD_NEXT, "writev"));
+        decltype(&::sendfile)    sendfile    = reinterpret_cast<decltype(&::sendfile)>(dlsym(RTLD_NEXT, "sendfile"));
+        decltype(&::shutdown)    shutdown    = reinterpret_cast<decltype(&::shutdown)>(dlsym(RTLD_NEXT, "shutdown"));
+        decltype(&::close)       close       = reinterpret_cast<decltype(&::close)>(dlsym(RTLD_NEXT, "close"));
+        decltype(&::fcntl)       fcntl       = reinterpret_cast<decltype(&::fcntl)>(dlsym(RTLD_NEXT, "fcntl"));
+        decltype(&::ioctl)       ioctl       = reinterpret_cast<decltype(&::ioctl)>(dlsym(RTLD_NEXT, "ioctl"));
+        decltype(&::setsockopt)  setsockopt  = reinterpret_cast<decltype(&::setsockopt)>(dlsym(RTLD_NEXT, "setsockopt"));
+        decltype(&::getsockopt)  getsockopt  = reinterpret_cast<decltype(&::getsockopt)>(dlsym(RTLD_NEXT, "getsockopt"));
+        decltype(&::getsockname) getsockname = reinterpret_cast<decltype(&::getsockname)>(dlsym(RTLD_NEXT, "getsockname"));
+        decltype(&::getpeername) getpeername = reinterpret_cast<decltype(&::getpeername)>(dlsym(RTLD_NEXT, "getpeername"));
+        decltype(&::epoll_ctl)   epoll_ctl   = reinterpret_cast<decltype(&::epoll_ctl)>(dlsym(RTLD_NEXT, "epoll_ctl"));
+        decltype(&::epoll_wait)  epoll_wait  = reinterpret_cast<decltype(&::epoll_wait)>(dlsym(RTLD_NEXT, "epoll_wait"));
+        decltype(&::epoll_pwait) epoll_pwait = reinterpret_cast<decltype(&::epoll_pwait)>(dlsym(RTLD_NEXT, "epoll_pwait"));
+        decltype(&::poll)        poll        = reinterpret_cast<decltype(&::poll)>(dlsym(RTLD_NEXT, "poll"));
+};
+
+libc_t& libc() {
+        static libc_t instance;
+        return instance;
+}
+
+struct stack_fd_t {
+        int      slot       = -1;  // remote:: fd, -1 until listen() / connect() create it
+        bool     nonblock   = false;
+        bool     listening  = false;
+        uint32_t local_ip   = 0;   // Host order
+        uint16_t local_port = 0;
+        uint32_t peer_ip    = 0;
+        uint16_t peer_port  = 0;
+};
+
+struct interest_t {
+        epoll_event event;
+        bool        armed = true;  // false after an EPOLLONESHOT report
+};
+
+// Recursive: shm_client's own libc calls come back through the shim
+std::recursive_mutex                                          mutex;
+std::atomic<bool>                                             is_stack[MAX_FDS];
+std::atomic<bool>                                             has_interests[MAX_FDS];  // epfd with stack fds
+std::unordered_map<int, stack_fd_t>                           stack_fds;  // By placeholder fd
+std::unordered_map<int, std::unordered_map<int, interest_t>> interests;  // epfd -> fd -> interest
+bool                                                          attached     = false;
+bool                                                          attach_tried = false;
+
+bool tracked(int fd) { return fd >= 0 && fd < MAX_FDS && is_stack[fd].load(std::memory_order_acquire); }
+bool shim_epoll(int epfd) { return epfd >= 0 && epfd < MAX_FDS && has_interests[epfd].load(std::memory_order_acquire); }
+
+uint32_t default_ip() {
+        const char* addr = std::getenv("USTACK_ADDR");
+        return uStack::ipv4_addr_t(std::string(addr ? addr : "192.168.1.1")).get_raw_ipv4();
+}
+
+bool try_attach() {
+        if (!attach_tried) {
+                attach_tried = true;
+                attached     = uStack::remote::attach() == 0;
+                if (!attached) std::fprintf(stderr, "[ustack_preload] no ustackd (%s), using the kernel\n", strerror(errno));
+        }
+        return attached;
+}
+
+void pthread_atfork_child() {
+        // The segment belongs to the parent's session
+        uStack::remote::detach();
+        for (auto& [fd, entry] : stack_fds) is_stack[fd].store(false);
+        for (auto& [epfd, set] : interests) has_interests[epfd].store(false);
+        stack_fds.clear();
+        interests.clear();
+        attached = attach_tried = false;
+        new (&mutex) std::recursive_mutex;
+}
+
+__attribute__((constructor)) void init() {
+        pthread_atfork([]() { mutex.lock(); }, []() { mutex.unlock(); }, pthread_atfork_child);
+}
+
+int placeholder(bool cloexec) {
+        return ::eventfd(0, EFD_NONBLOCK | (cloexec ? EFD_CLOEXEC : 0));
+}
+
+int track(int fd, const stack_fd_t& entry) {
+        stack_fds[fd] = entry;
+        is_stack[fd].store(true, std::memory_order_release);
+        return fd;
+}
+
+stack_fd_t* lookup(int fd) {
+        auto it = stack_fds.find(fd);
+        return it == stack_fds.end() ? nullptr : &it->second;
+}
+
+int fail(int error) {
+        errno = error;
+        return -1;
+}
+
+short readiness(const stack_fd_t& entry) {
+        if (entry.slot < 0) return 0;
+        uStack::shm::socket_slot_t* slot = uStack::shm_client::instance().slot(entry.slot);
+        return slot ? uStack::remote::readiness(slot) : POLLNVAL;
+}
+
+// Wait up to one slice for events on a blocking socket, then let other threads in
+bool wait_ready(std::unique_lock<std::recursive_mutex>& lock, const stack_fd_t& entry, short events) {
+        bool ready = uStack::remote::poll(entry.slot, events, WAIT_SLICE_MS) > 0;
+        lock.unlock();
+        lock.lock();
+        return ready;
+}
+
+// Run op until it stops failing with EAGAIN (blocking sockets)
+template <typename Op>
+auto blocking(std::unique_lock<std::recursive_mutex>& lock, int fd, short events, bool nonblock, Op op) -> decltype(op()) {
+        for (;;) {
+                auto ret = op();
+                if (ret >= 0 || errno != EAGAIN || nonblock) return ret;
+                stack_fd_t* entry = lookup(fd);
+                if (!entry) return fail(EBADF);
+                wait_ready(lock, *entry, events);
+        }
+}
+
+void fill_addr(sockaddr* addr, socklen_t* addrlen, uint32_t ip, uint16_t port) {
+        if (!addr || !addrlen) return;
+        sockaddr_in in = {};
+        in.sin_family      = AF_INET;
+        in.sin_addr.s_addr = htonl(ip);
+        in.sin_port        = htons(port);
+        std::memcpy(addr, &in, std::min<size_t>(*addrlen, sizeof(in)));
+        *addrlen = sizeof(in);
+}
+
+ssize_t stack_read(std::unique_lock<std::recursive_mutex>& lock, int fd, void* buf, size_t count, bool nonblock) {
+        stack_fd_t* entry = lookup(fd);
+        if (!entry || entry->slot < 0) return fail(ENOTCONN);
+        return blocking(lock, fd, POLLIN, nonblock || entry->nonblock, [&]() -> ssize_t {
+                stack_fd_t* current = lookup(fd);
+                if (!current) return fail(EBADF);
+                int len = std::min<size_t>(count, INT_MAX);
+                if (uStack::remote::read(current->slot, static_cast<char*>(buf), len) < 0) return -1;
+                return len;
+        });
+}
+
+// Blocking sockets write everything, as the kernel does
+ssize_t stack_write(std::unique_lock<std::recursive_mutex>& lock, int fd, const void* buf, size_t count, bool nonblock) {
+        stack_fd_t* entry = lookup(fd);
+        if (!entry || entry->slot < 0) return fail(ENOTCONN);
+        nonblock |= entry->nonblock;
+        size_t done = 0;
+        while (done < count) {
+                stack_fd_t* current = lookup(fd);
+                if (!current) return done ? done : fail(EBADF);
+                int len = std::min<size_t>(count - done, INT_MAX);
+                if (uStack::remote::write(current->slot, const_cast<char*>(static_cast<const char*>(buf)) + done, len) < 0) {
+                        if (errno != EAGAIN || nonblock) return done ? static_cast<ssize_t>(done) : -1;
+                        wait_ready(lock, *current, POLLOUT);
+                        continue;
+                }
+                done += len;
+                if (nonblock) break;
+        }
+        return done;
+}
+
+// Ready stack interests of epfd, EPOLLONESHOT ones are disarmed
+int collect(int epfd, epoll_event* events, int max_events) {
+        auto it = interests.find(epfd);
+        if (it == interests.end()) return 0;
+        int count = 0;
+        for (auto& [fd, interest] : it->second) {
+                if (count == max_events) break;
+                stack_fd_t* entry = lookup(fd);
+                if (!entry || !interest.armed) continue;
+                uint32_t ready = readiness(*entry) & (interest.event.events | EPOLLERR | EPOLLHUP);
+                if (!ready) continue;
+                events[count++] = {.events = ready, .data = interest.event.data};
+                if (interest.event.events & EPOLLONESHOT) interest.armed = false;
+        }
+        return count;
+}
+
+bool any_ready(int epfd) {
+        auto it = interests.find(epfd);
+        if (it == interests.end()) return false;
+        for (auto& [fd, interest] : it->second) {
+                stack_fd_t* entry = lookup(fd);
+                if (entry && interest.armed && (readiness(*entry) & (interest.event.events | EPOLLERR | EPOLLHUP))) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+int remaining_ms(std::chrono::steady_clock::time_point deadline, int timeout) {
+        if (timeout < 0) return WAIT_SLICE_MS;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        return std::max<int>(0, std::min<int>(left.count(), WAIT_SLICE_MS));
+}
+
+}  // namespace
+
+extern "C" {
+
+int socket(int domain, int type, int protocol) {
+        int base = type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (domain != AF_INET || base != SOCK_STREAM || (protocol != 0 && protocol != IPPROTO_TCP)) {
+                return libc().socket(domain, type, protocol);
+        }
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (!try_attach()) return libc().socket(domain, type, protocol);
+        int fd = placeholder(type & SOCK_CLOEXEC);
+        if (fd < 0) return -1;
+        if (fd >= MAX_FDS) {
+                libc().close(fd);
+                return fail(EMFILE);
+        }
+        stack_fd_t entry;
+        entry.nonblock = type & SOCK_NONBLOCK;
+        return track(fd, entry);
+}
+
+int bind(int fd, const sockaddr* addr, socklen_t addrlen) {
+        if (!tracked(fd)) return libc().bind(fd, addr, addrlen);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (!addr || addrlen < sizeof(sockaddr_in) || addr->sa_family != AF_INET) return fail(EINVAL);
+        if (entry->slot >= 0) return fail(EINVAL);
+        auto* in          = reinterpret_cast<const sockaddr_in*>(addr);
+        entry->local_ip   = ntohl(in->sin_addr.s_addr);
+        entry->local_port = ntohs(in->sin_port);
+        return 0;
+}
+
+int listen(int fd, int backlog) {
+        if (!tracked(fd)) return libc().listen(fd, backlog);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (entry->listening) return 0;
+        if (entry->slot >= 0) return fail(EINVAL);
+        if (entry->local_ip == INADDR_ANY) entry->local_ip = default_ip();
+        // The backlog is the daemon's MAX_BACKLOG_PORT_<port>
+        int slot = uStack::remote::socket(IPPROTO_TCP, uStack::ipv4_addr_t(entry->local_ip), entry->local_port);
+        if (slot < 0) return -1;
+        entry->slot = slot;
+        if (uStack::remote::listen(slot) < 0) return -1;
+        entry->listening = true;
+        return 0;
+}
+
+int accept4(int fd, sockaddr* addr, socklen_t* addrlen, int flags) {
+        if (!tracked(fd)) return libc().accept4(fd, addr, addrlen, flags);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (!entry->listening) return fail(EINVAL);
+        int slot = blocking(lock, fd, POLLIN, entry->nonblock, [fd]() {
+                stack_fd_t* current = lookup(fd);
+                return current ? uStack::remote::accept(current->slot) : fail(EBADF);
+        });
+        if (slot < 0) return -1;
+        int cfd = placeholder(flags & SOCK_CLOEXEC);
+        if (cfd < 0 || cfd >= MAX_FDS) {
+                if (cfd >= 0) libc().close(cfd);
+                uStack::remote::close(slot, true);
+                return fail(EMFILE);
+        }
+        entry = lookup(fd);
+        stack_fd_t conn;
+        conn.slot       = slot;
+        conn.nonblock   = flags & SOCK_NONBLOCK;
+        conn.local_ip   = entry ? entry->local_ip : 0;
+        conn.local_port = entry ? entry->local_port : 0;
+        fill_addr(addr, addrlen, 0, 0);
+        return track(cfd, conn);
+}
+
+int accept(int fd, sockaddr* addr, socklen_t* addrlen) {
+        if (!tracked(fd)) return libc().accept(fd, addr, addrlen);
+        return accept4(fd, addr, addrlen, 0);
+}
+
+int connect(int fd, const sockaddr* addr, socklen_t addrlen) {
+        if (!tracked(fd)) return libc().connect(fd, addr, addrlen);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (!addr || addrlen < sizeof(sockaddr_in) || addr->sa_family != AF_INET) return fail(EAFNOSUPPORT);
+        if (entry->listening) return fail(EISCONN);
+        if (entry->slot >= 0) {
+                short ready = readiness(*entry);
+                if (ready & POLLERR) return fail(uStack::remote::socket_error(entry->slot));
+                return fail(ready & POLLOUT ? EISCONN : EALREADY);
+        }
+        auto* in         = reinterpret_cast<const sockaddr_in*>(addr);
+        entry->peer_ip   = ntohl(in->sin_addr.s_addr);
+        entry->peer_port = ntohs(in->sin_port);
+        if (entry->local_ip == INADDR_ANY) entry->local_ip = default_ip();
+        int slot = uStack::remote::socket(IPPROTO_TCP, uStack::ipv4_addr_t(entry->local_ip), entry->local_port);
+        if (slot < 0) return -1;
+        entry->slot = slot;
+        if (uStack::remote::connect(slot, uStack::ipv4_addr_t(entry->peer_ip), entry->peer_port) < 0 &&
+            errno != EINPROGRESS) {
+                return -1;
+        }
+        if (entry->nonblock) return fail(EINPROGRESS);
+        for (;;) {
+                entry = lookup(fd);
+                if (!entry) return fail(EBADF);
+                short ready = readiness(*entry);
+                if (ready & POLLERR) return fail(uStack::remote::socket_error(entry->slot));
+                if (ready & POLLOUT) return 0;
+                wait_ready(lock, *entry, POLLOUT);
+        }
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+        if (!tracked(fd)) return libc().read(fd, buf, count);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        return stack_read(lock, fd, buf, count, false);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+        if (!tracked(fd)) return libc().write(fd, buf, count);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        return stack_write(lock, fd, buf, count, false);
+}
+
+ssize_t recv(int fd, void* buf, size_t len, int flags) {
+        if (!tracked(fd)) return libc().recv(fd, buf, len, flags);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        if (flags & MSG_PEEK) {
+                stack_fd_t* entry = lookup(fd);
+                if (!entry || entry->slot < 0) return fail(ENOTCONN);
+                uStack::shm::socket_slot_t* slot = uStack::shm_client::instance().slot(entry->slot);
+                auto [data, avail]               = slot->rx.read_span();
+                if (avail == 0) {
+                        short ready = readiness(*entry);
+                        if (ready & POLLRDHUP) return 0;
+                        return fail(ready & POLLERR ? uStack::remote::socket_error(entry->slot) : EAGAIN);
+                }
+                size_t n = std::min<size_t>(avail, len);
+                std::memcpy(buf, data, n);
+                return n;
+        }
+        return stack_read(lock, fd, buf, len, flags & MSG_DONTWAIT);
+}
+
+ssize_t recvfrom(int fd, void* buf, size_t len, int flags, sockaddr* addr, socklen_t* addrlen) {
+        if (!tracked(fd)) return libc().recvfrom(fd, buf, len, flags, addr, addrlen);
+        fill_addr(addr, addrlen, 0, 0);
+        return recv(fd, buf, len, flags);
+}
+
+ssize_t send(int fd, const void* buf, size_t len, int flags) {
+        if (!tracked(fd)) return libc().send(fd, buf, len, flags);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        return stack_write(lock, fd, buf, len, flags & MSG_DONTWAIT);
+}
+
+ssize_t sendto(int fd, const void* buf, size_t len, int flags, const sockaddr* addr, socklen_t addrlen) {
+        if (!tracked(fd)) return libc().sendto(fd, buf, len, flags, addr, addrlen);
+        return send(fd, buf, len, flags);
+}
+
+// One iovec at a time: a short transfer ends the call, as it would in the kernel
+ssize_t readv(int fd, const iovec* iov, int iovcnt) {
+        if (!tracked(fd)) return libc().readv(fd, iov, iovcnt);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        ssize_t total = 0;
+        for (int i = 0; i < iovcnt; i++) {
+                ssize_t n = stack_read(lock, fd, iov[i].iov_base, iov[i].iov_len, total > 0);
+                if (n < 0) return total ? total : -1;
+                total += n;
+                if (static_cast<size_t>(n) < iov[i].iov_len) break;
+        }
+        return total;
+}
+
+ssize_t writev(int fd, const iovec* iov, int iovcnt) {
+        if (!tracked(fd)) return libc().writev(fd, iov, iovcnt);
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        ssize_t total = 0;
+        for (int i = 0; i < iovcnt; i++) {
+                ssize_t n = stack_write(lock, fd, iov[i].iov_base, iov[i].iov_len, total > 0);
+                if (n < 0) return total ? total : -1;
+                total += n;
+                if (static_cast<size_t>(n) < iov[i].iov_len) break;
+        }
+        return total;
+}
+
+// The file is read into the tx ring (the daemon's sendfile() needs the file in its process)
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+        if (!tracked(out_fd)) return libc().sendfile(out_fd, in_fd, offset, count);
+        char    buf[16384];
+        ssize_t total = 0;
+        while (static_cast<size_t>(total) < count) {
+                size_t  chunk = std::min(sizeof(buf), count - total);
+                ssize_t got   = offset ? ::pread(in_fd, buf, chunk, *offset + total) : ::read(in_fd, buf, chunk);
+                if (got <= 0) break;
+                ssize_t sent;
+                {
+                        std::unique_lock<std::recursive_mutex> lock(mutex);
+                        sent = stack_write(lock, out_fd, buf, got, total > 0);
+                }
+                if (sent < 0) {
+                        if (!offset) ::lseek(in_fd, -got, SEEK_CUR);
+                        if (total == 0) return -1;
+                        break;
+                }
+                total += sent;
+                if (sent < got) {
+                        if (!offset) ::lseek(in_fd, sent - got, SEEK_CUR);
+                        break;
+                }
+        }
+        if (offset) *offset += total;
+        return total;
+}
+
+int shutdown(int fd, int how) {
+        if (!tracked(fd)) return libc().shutdown(fd, how);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (entry->slot < 0) return fail(ENOTCONN);
+        return uStack::remote::shutdown(entry->slot, how);
+}
+
+int close(int fd) {
+        if (!tracked(fd)) {
+                if (shim_epoll(fd)) {
+                        std::lock_guard<std::recursive_mutex> lock(mutex);
+                        interests.erase(fd);
+                        has_interests[fd].store(false, std::memory_order_release);
+                }
+                return libc().close(fd);
+        }
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (entry && entry->slot >= 0) uStack::remote::close(entry->slot);
+        for (auto& [epfd, set] : interests) set.erase(fd);
+        stack_fds.erase(fd);
+        is_stack[fd].store(false, std::memory_order_release);
+        return libc().close(fd);
+}
+
+int fcntl(int fd, int cmd, ...) {
+        va_list args;
+        va_start(args, cmd);
+        void* arg = va_arg(args, void*);
+        va_end(args);
+        if (!tracked(fd) || (cmd != F_GETFL && cmd != F_SETFL)) return libc().fcntl(fd, cmd, arg);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (cmd == F_GETFL) return O_RDWR | (entry->nonblock ? O_NONBLOCK : 0);
+        entry->nonblock = reinterpret_cast<intptr_t>(arg) & O_NONBLOCK;
+        return 0;
+}
+
+int fcntl64(int fd, int cmd, ...) {
+        va_list args;
+        va_start(args, cmd);
+        void* arg = va_arg(args, void*);
+        va_end(args);
+        return fcntl(fd, cmd, arg);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+        va_list args;
+        va_start(args, request);
+        void* arg = va_arg(args, void*);
+        va_end(args);
+        if (!tracked(fd) || (request != FIONBIO && request != FIONREAD)) return libc().ioctl(fd, request, arg);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (request == FIONBIO) {
+                entry->nonblock = *static_cast<int*>(arg) != 0;
+                return 0;
+        }
+        uStack::shm::socket_slot_t* slot = entry->slot >= 0 ? uStack::shm_client::instance().slot(entry->slot) : nullptr;
+        *static_cast<int*>(arg)          = slot ? slot->rx.readable() : 0;
+        return 0;
+}
+
+int setsockopt(int fd, int level, int name, const void* value, socklen_t len) {
+        if (!tracked(fd)) return libc().setsockopt(fd, level, name, value, len);
+        return 0;
+}
+
+int getsockopt(int fd, int level, int name, void* value, socklen_t* len) {
+        if (!tracked(fd)) return libc().getsockopt(fd, level, name, value, len);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (!value || !len || *len < sizeof(int)) return fail(EINVAL);
+        int result = 0;
+        if (level == SOL_SOCKET && name == SO_ERROR && entry->slot >= 0) {
+                result = uStack::remote::socket_error(entry->slot);
+        } else if (level == SOL_SOCKET && name == SO_TYPE) {
+                result = SOCK_STREAM;
+        }
+        std::memcpy(value, &result, sizeof(result));
+        *len = sizeof(result);
+        return 0;
+}
+
+int getsockname(int fd, sockaddr* addr, socklen_t* addrlen) {
+        if (!tracked(fd)) return libc().getsockname(fd, addr, addrlen);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        fill_addr(addr, addrlen, entry->local_ip, entry->local_port);
+        return 0;
+}
+
+int getpeername(int fd, sockaddr* addr, socklen_t* addrlen) {
+        if (!tracked(fd)) return libc().getpeername(fd, addr, addrlen);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        stack_fd_t* entry = lookup(fd);
+        if (!entry) return fail(EBADF);
+        if (entry->slot < 0 || entry->listening) return fail(ENOTCONN);
+        fill_addr(addr, addrlen, entry->peer_ip, entry->peer_port);
+        return 0;
+}
+
+int epoll_ctl(int epfd, int op, int fd, epoll_event* event) {
+        if (!tracked(fd)) return libc().epoll_ctl(epfd, op, fd, event);
+        if (epfd < 0 || epfd >= MAX_FDS) return fail(EBADF);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        auto& set = interests[epfd];
+        has_interests[epfd].store(true, std::memory_order_release);
+        auto  it  = set.find(fd);
+        switch (op) {
+                case EPOLL_CTL_ADD:
+                        if (it != set.end()) return fail(EEXIST);
+                        if (!event) return fail(EFAULT);
+                        set[fd] = {.event = *event, .armed = true};
+                        return 0;
+                case EPOLL_CTL_MOD:
+                        if (it == set.end()) return fail(ENOENT);
+                        if (!event) return fail(EFAULT);
+                        it->second = {.event = *event, .armed = true};
+                        return 0;
+                case EPOLL_CTL_DEL:
+                        if (it == set.end()) return fail(ENOENT);
+                        set.erase(it);
+                        return 0;
+                default:
+                        return fail(EINVAL);
+        }
+}
+
+// The signal mask only applies to the kernel part of the wait
+int epoll_pwait(int epfd, epoll_event* events, int max_events, int timeout, const sigset_t* sigmask) {
+        if (!shim_epoll(epfd)) return libc().epoll_pwait(epfd, events, max_events, timeout, sigmask);
+        if (max_events <= 0) return fail(EINVAL);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        for (;;) {
+                int count = collect(epfd, events, max_events);
+                if (count < max_events) {
+                        int kernel = libc().epoll_pwait(epfd, events + count, max_events - count, 0, sigmask);
+                        if (kernel > 0) count += kernel;
+                }
+                int slice = remaining_ms(deadline, timeout);
+                if (count > 0 || timeout == 0 || slice == 0) return count;
+
+                // Stack wakeups, or the kernel epoll fd turning readable
+                pollfd kernel = {.fd = epfd, .events = POLLIN, .revents = 0};
+                uStack::shm_client::instance().wait_until([epfd]() { return any_ready(epfd); }, slice, &kernel, 1);
+                lock.unlock();
+                lock.lock();
+        }
+}
+
+int epoll_wait(int epfd, epoll_event* events, int max_events, int timeout) {
+        return epoll_pwait(epfd, events, max_events, timeout, nullptr);
+}
+
+int poll(pollfd* fds, nfds_t nfds, int timeout) {
+        bool any_stack = false;
+        for (nfds_t i = 0; i < nfds && !any_stack; i++) any_stack = tracked(fds[i].fd);
+        if (!any_stack) return libc().poll(fds, nfds, timeout);
+
+        std::vector<pollfd> kernel;
+        std::vector<nfds_t> kernel_index;
+        for (nfds_t i = 0; i < nfds; i++) {
+                if (!tracked(fds[i].fd)) {
+                        kernel.push_back(fds[i]);
+                        kernel_index.push_back(i);
+                }
+        }
+        auto stack_ready = [fds, nfds]() {
+                int count = 0;
+                for (nfds_t i = 0; i < nfds; i++) {
+                        if (!tracked(fds[i].fd)) continue;
+                        stack_fd_t* entry = lookup(fds[i].fd);
+                        fds[i].revents    = entry ? readiness(*entry) & (fds[i].events | POLLERR | POLLHUP) : POLLNVAL;
+                        count += fds[i].revents != 0;
+                }
+                return count;
+        };
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        for (;;) {
+                int count = stack_ready();
+                if (!kernel.empty()) {
+                        // wait_until() leaves the last pass's results behind
+                        for (pollfd& entry : kernel) entry.revents = 0;
+                        if (libc().poll(kernel.data(), kernel.size(), 0) < 0) return -1;
+                        for (size_t k = 0; k < kernel.size(); k++) {
+                                fds[kernel_index[k]].revents = kernel[k].revents;
+                                count += kernel[k].revents != 0;
+                        }
+                }
+                int slice = remaining_ms(deadline, timeout);
+                if (count > 0 || timeout == 0 || slice == 0) return count;
+                uStack::shm_client::instance().wait_until([&stack_ready]() { return stack_ready() > 0; }, slice,
+                                                          kernel.data(), kernel.size());
+                lock.unlock();
+                lock.lock();
+        }
+}
+
+}  // extern "C"
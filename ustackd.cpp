@@ -0,0 +1,29 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "api.hpp"
+#include "shm_server.hpp"
+
+namespace docs {
+static const char* ustackd_doc = R"(
+FILE: ustackd.cpp
+PURPOSE: Stack daemon: one TAP device and one TCP/IP stack shared by several processes.
+Clients link only shm_client.hpp and attach through a unix socket (USTACK_SOCKET,
+default /tmp/ustack.sock); data moves through shared memory rings.
+)";
+}
+
+int main(int argc, char* argv[]) {
+        uStack::init_stack(argc, argv);
+
+        const char* path = std::getenv("USTACK_SOCKET");
+        if (uStack::shm_server::instance().start(path ? path : uStack::shm::DEFAULT_PATH) < 0) {
+                std::cout << "Cannot listen for clients: " << strerror(errno) << std::endl;
+                return 1;
+        }
+
+        // Serve clients from the event loop (blocks here)
+        uStack::start_event_loop();
+        return 0;
+}
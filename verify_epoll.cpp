@@ -0,0 +1,93 @@
+// Verification test for the epoll interest / ready lists
+// Build: g++ -std=c++17 -Isrc/application -o verify_epoll verify_epoll.cpp
+#include <cassert>
+#include <iostream>
+
+#include "epoll.hpp"
+
+using namespace uStack;
+
+int main() {
+    std::cout << "=== epoll Verification ===" << std::endl;
+
+    int     wakeups = 0;
+    epoll_t ep([&wakeups]() { wakeups++; });
+
+    epoll_item_t a, b;
+    uint32_t     a_ready = 0, b_ready = 0;  // Simulated socket readiness
+    auto poll = [&](epoll_item_t& item) { return &item == &a ? a_ready : b_ready; };
+    epoll_event events[8];
+
+    // Test 1: Registration reports nothing until a socket is ready
+    std::cout << "\nTest 1: Interest list" << std::endl;
+    epoll_event ev = {.events = EPOLLIN, .data = {.fd = 1}};
+    assert(ep.add(a, 1, ev, 0) == 0);
+    ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET, .data = {.fd = 2}};
+    assert(ep.add(b, 2, ev, 0) == 0);
+    assert(ep.add(a, 1, ev, 0) == -1 && errno == EEXIST);
+    assert(ep.size() == 2 && ep.ready() == 0);
+    assert(ep.wait(events, 8, poll) == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 2: Level-triggered stays ready until drained
+    std::cout << "\nTest 2: Level-triggered" << std::endl;
+    a_ready = EPOLLIN;
+    ep.notify(a, EPOLLIN);
+    assert(wakeups == 1);
+    assert(ep.wait(events, 8, poll) == 1 && events[0].data.fd == 1 && events[0].events == EPOLLIN);
+    assert(ep.wait(events, 8, poll) == 1);
+    a_ready = 0;
+    assert(ep.wait(events, 8, poll) == 0 && ep.ready() == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 3: Edge-triggered reports each notification once
+    std::cout << "\nTest 3: Edge-triggered" << std::endl;
+    b_ready = EPOLLIN | EPOLLOUT;
+    ep.notify(b, EPOLLIN);
+    ep.notify(b, EPOLLOUT);
+    assert(ep.ready() == 1);
+    assert(ep.wait(events, 8, poll) == 1 && events[0].events == (EPOLLIN | EPOLLOUT));
+    assert(ep.wait(events, 8, poll) == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 4: Uninteresting events are filtered, ERR/HUP always reported
+    std::cout << "\nTest 4: Event filtering" << std::endl;
+    ep.notify(a, EPOLLOUT);
+    assert(ep.ready() == 0);
+    ep.notify(a, EPOLLHUP);
+    a_ready = EPOLLHUP;
+    assert(ep.wait(events, 8, poll) == 1 && events[0].events == EPOLLHUP);
+    a_ready = 0;
+    assert(ep.wait(events, 8, poll) == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 5: max_events leaves the rest queued, fairly
+    std::cout << "\nTest 5: max_events" << std::endl;
+    a_ready = EPOLLIN;
+    b_ready = EPOLLIN;
+    ep.notify(a, EPOLLIN);
+    ep.notify(b, EPOLLIN);
+    assert(ep.wait(events, 1, poll) == 1 && events[0].data.fd == 1);
+    assert(ep.wait(events, 1, poll) == 1 && events[0].data.fd == 2);
+    assert(ep.wait(events, 8, poll) == 1 && events[0].data.fd == 1);  // b was edge-triggered
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 6: EPOLLONESHOT disarms until modify(), remove() unlinks
+    std::cout << "\nTest 6: One-shot and removal" << std::endl;
+    ev = {.events = EPOLLIN | EPOLLONESHOT, .data = {.fd = 1}};
+    assert(ep.modify(a, ev, a_ready) == 0);
+    assert(ep.wait(events, 8, poll) == 1);
+    ep.notify(a, EPOLLIN);
+    assert(ep.wait(events, 8, poll) == 0);
+    a_ready = EPOLLHUP;
+    ep.notify(a, EPOLLHUP);  // Not even ERR/HUP while disarmed
+    assert(ep.ready() == 0 && ep.wait(events, 8, poll) == 0);
+    a_ready = EPOLLIN;
+    assert(ep.modify(a, ev, a_ready) == 0 && ep.ready() == 1);
+    assert(ep.remove(a) == 0 && ep.ready() == 0 && ep.size() == 1);
+    assert(ep.remove(a) == -1 && errno == ENOENT);
+    std::cout << "✓ PASS" << std::endl;
+
+    std::cout << "\n=== All epoll Tests Passed ===" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Verification test for pooled receive buffers
+// Build: g++ -std=c++17 -Isrc/core -Isrc/utils -o verify_packet_pool verify_packet_pool.cpp -lglog
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "base_packet.hpp"
+
+using namespace uStack;
+
+int main() {
+    std::cout << "=== Packet Pool Verification ===" << std::endl;
+    packet_pool& pool = packet_pool::instance();
+
+    // Test 1: A pooled packet hands its buffer back when destroyed
+    std::cout << "\nTest 1: Recycle on destruction" << std::endl;
+    uint8_t* storage = nullptr;
+    {
+        auto packet = std::make_unique<base_packet>(1500, pool);
+        storage     = packet->get_pointer();
+        assert(packet->get_remaining_len() == 1500);
+    }
+    assert(pool.cached() == 1);
+    assert(pool.allocations() == 1);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 2: The next frame reuses it, set_len() trims to the bytes read
+    std::cout << "\nTest 2: Reuse" << std::endl;
+    {
+        auto packet = std::make_unique<base_packet>(1500, pool);
+        assert(packet->get_pointer() == storage);
+        assert(pool.reuses() == 1 && pool.cached() == 0);
+        std::memcpy(packet->get_pointer(), "headerpayload", 13);
+        packet->set_len(13);
+        packet->add_offset(6);
+        assert(packet->get_remaining_len() == 7);
+        assert(std::memcmp(packet->get_pointer(), "payload", 7) == 0);
+    }
+    assert(pool.cached() == 1);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 3: After header stacking the pooled storage is not recycled twice
+    std::cout << "\nTest 3: reflush_packet() detaches the pool" << std::endl;
+    {
+        auto packet = std::make_unique<base_packet>(64, pool);
+        packet->reflush_packet(20);
+    }
+    assert(pool.cached() == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 4: Plain packets never enter the pool
+    std::cout << "\nTest 4: Unpooled packets" << std::endl;
+    {
+        base_packet packet(100);
+    }
+    assert(pool.cached() == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    std::cout << "\n=== All Packet Pool Tests Passed ===" << std::endl;
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Verification test for the ephemeral port allocator
+// Build: g++ -std=c++17 -Isrc/transport -o verify_port_allocator verify_port_allocator.cpp
+#include <cassert>
+#include <iostream>
+#include <set>
+
+#include "port_allocator.hpp"
+
+using namespace uStack;
+
+int main() {
+    std::cout << "=== Port Allocator Verification ===" << std::endl;
+    const uint32_t local = 0x0a000001;
+
+    // Test 1: Ports come from the dynamic range and are unique
+    std::cout << "\nTest 1: Unique ephemeral ports" << std::endl;
+    port_allocator     ports;
+    std::set<uint16_t> seen;
+    for (int i = 0; i < 1000; i++) {
+        auto port = ports.allocate(local);
+        assert(port && port.value() >= port_allocator::EPHEMERAL_MIN);
+        assert(seen.insert(port.value()).second);
+    }
+    assert(ports.in_use(local) == 1000);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 2: Exhaustion, then release makes a port available again
+    std::cout << "\nTest 2: Exhaustion and release" << std::endl;
+    while (ports.allocate(local)) {}
+    assert(ports.in_use(local) == port_allocator::PORT_COUNT);
+    assert(!ports.allocate(local));
+    ports.release(local, 50000);
+    auto port = ports.allocate(local);
+    assert(port && port.value() == 50000);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 3: Addresses are independent
+    std::cout << "\nTest 3: Per-address bitmaps" << std::endl;
+    assert(ports.allocate(0x0a000002));
+    assert(ports.in_use(0x0a000002) == 1);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 4: reserve() rejects taken ports and ignores well-known ones
+    std::cout << "\nTest 4: Explicit reservation" << std::endl;
+    port_allocator fresh;
+    assert(fresh.reserve(local, 60000));
+    assert(!fresh.reserve(local, 60000));
+    assert(fresh.reserve(local, 80));
+    assert(fresh.in_use(local) == 1);
+    fresh.release(local, 60000);
+    fresh.release(local, 60000);
+    assert(fresh.in_use(local) == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    std::cout << "\n=== All Port Allocator Tests Passed ===" << std::endl;
+    return 0;
+}
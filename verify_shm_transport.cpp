@@ -0,0 +1,95 @@
+// Verification test for the shared memory transport layout
+// Build: g++ -std=c++17 -Isrc/application -o verify_shm_transport verify_shm_transport.cpp
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "shm_transport.hpp"
+
+using namespace uStack;
+
+int main() {
+    std::cout << "=== Shared Memory Transport Verification ===" << std::endl;
+    auto ring = std::make_unique<shm::byte_ring_t>();
+    ring->reset();
+
+    // Test 1: Bytes wrap around the end of a data ring
+    std::cout << "\nTest 1: Byte ring wrap" << std::endl;
+    std::string chunk(shm::DATA_RING_SIZE - 100, 'x');
+    assert(ring->push(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size()) == chunk.size());
+    std::string out(chunk.size(), 0);
+    assert(ring->pop(reinterpret_cast<uint8_t*>(&out[0]), out.size()) == chunk.size());
+    std::string msg = "wrapped across the end of the ring, still in order";
+    for (size_t i = 0; i < 4; i++) msg += msg;
+    assert(ring->push(reinterpret_cast<const uint8_t*>(msg.data()), msg.size()) == msg.size());
+    auto [span, avail] = ring->read_span();
+    assert(avail == 100);  // Contiguous part only
+    std::string back(msg.size(), 0);
+    assert(ring->pop(reinterpret_cast<uint8_t*>(&back[0]), back.size()) == msg.size());
+    assert(back == msg && ring->readable() == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 2: A full ring takes no more bytes
+    std::cout << "\nTest 2: Byte ring full" << std::endl;
+    std::string fill(shm::DATA_RING_SIZE + 10, 'y');
+    assert(ring->push(reinterpret_cast<const uint8_t*>(fill.data()), fill.size()) == shm::DATA_RING_SIZE);
+    assert(ring->writable() == 0 && ring->write_span().second == 0);
+    ring->consume(10);
+    assert(ring->writable() == 10);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 3: Control ring capacity and order
+    std::cout << "\nTest 3: Control ring" << std::endl;
+    auto commands = std::make_unique<shm::control_ring_t<shm::command_t>>();
+    for (uint32_t i = 0; i < shm::CONTROL_ENTRIES; i++) {
+        assert(commands->push({.op = shm::CMD_ACCEPT, .slot = 1, .ipv4 = 0, .port = 0, .arg = 0, .seq = i}));
+    }
+    assert(commands->full() && !commands->push({}));
+    shm::command_t cmd;
+    assert(commands->pop(cmd) && cmd.seq == 0);
+    assert(!commands->full());
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 4: The handshake passes the segment and both eventfds
+    std::cout << "\nTest 4: Handshake" << std::endl;
+    int pair[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) == 0);
+    int memfd = memfd_create("verify-shm", MFD_CLOEXEC);
+    assert(memfd >= 0 && ftruncate(memfd, sizeof(shm::segment_t)) == 0);
+    void* mem = mmap(nullptr, sizeof(shm::segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    auto* seg = new (mem) shm::segment_t;
+    int   fds[shm::HELLO_FDS] = {memfd, eventfd(0, EFD_NONBLOCK), eventfd(0, EFD_NONBLOCK)};
+    assert(shm::send_hello(pair[0], {.magic = shm::MAGIC, .version = shm::VERSION, .size = sizeof(shm::segment_t)}, fds));
+
+    shm::hello_t hello;
+    int          received[shm::HELLO_FDS];
+    assert(shm::recv_hello(pair[1], hello, received));
+    assert(hello.size == sizeof(shm::segment_t));
+    auto* peer = static_cast<shm::segment_t*>(
+        mmap(nullptr, sizeof(shm::segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, received[0], 0));
+    seg->slots[3].rx.push(reinterpret_cast<const uint8_t*>("ping"), 4);
+    char ping[4];
+    assert(peer->slots[3].rx.pop(reinterpret_cast<uint8_t*>(ping), 4) == 4 && std::memcmp(ping, "ping", 4) == 0);
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 5: The doorbell is only written while the other side sleeps
+    std::cout << "\nTest 5: Wakeups" << std::endl;
+    uint64_t value;
+    shm::wake(peer->daemon_sleeping, received[1]);
+    assert(read(fds[1], &value, sizeof(value)) < 0 && errno == EAGAIN);
+    shm::prepare_sleep(seg->daemon_sleeping);
+    shm::wake(peer->daemon_sleeping, received[1]);
+    assert(read(fds[1], &value, sizeof(value)) == sizeof(value) && value == 1);
+    std::cout << "✓ PASS" << std::endl;
+
+    std::cout << "\n=== All Shared Memory Transport Tests Passed ===" << std::endl;
+    return 0;
+}
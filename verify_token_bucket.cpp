@@ -0,0 +1,48 @@
+// Verification test for the ICMP token bucket rate limiter
+// Build: g++ -std=c++17 -Isrc/utils -o verify_token_bucket verify_token_bucket.cpp
+#include <cassert>
+#include <chrono>
+#include <iostream>
+
+#include "token_bucket.hpp"
+
+using uStack::token_bucket_t;
+
+int main() {
+    std::cout << "=== Token Bucket Verification ===" << std::endl;
+    auto start = token_bucket_t::clock::now();
+
+    // Test 1: Bucket starts full and allows one burst
+    std::cout << "\nTest 1: Initial burst" << std::endl;
+    token_bucket_t bucket(10, 5, start);
+    for (int i = 0; i < 5; i++) {
+        assert(bucket.try_consume(start));
+    }
+    assert(!bucket.try_consume(start));
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 2: Refill follows the rate (10/s -> 1 token per 100ms)
+    std::cout << "\nTest 2: Refill rate" << std::endl;
+    auto later = start + std::chrono::milliseconds(100);
+    assert(bucket.try_consume(later));
+    assert(!bucket.try_consume(later));
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 3: Refill is capped at the burst size
+    std::cout << "\nTest 3: Burst cap" << std::endl;
+    auto much_later = start + std::chrono::seconds(60);
+    assert(bucket.is_full(much_later));
+    int allowed = 0;
+    while (bucket.try_consume(much_later)) allowed++;
+    assert(allowed == 5);
+    std::cout << "Allowed after idle: " << allowed << std::endl;
+    std::cout << "✓ PASS" << std::endl;
+
+    // Test 4: Time going backwards does not mint tokens
+    std::cout << "\nTest 4: Non-monotonic time" << std::endl;
+    assert(!bucket.try_consume(start));
+    std::cout << "✓ PASS" << std::endl;
+
+    std::cout << "\n=== All Tests Passed! ===" << std::endl;
+    return 0;
+}